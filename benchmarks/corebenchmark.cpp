@@ -0,0 +1,433 @@
+// Замеры горячих путей редакторов на синтетических данных: загрузка и сохранение
+// CSV таблицей, открытие текста и отслеживание правок, загрузка, отрисовка и
+// экспорт сцены, шаг движения SceneEditWidget. Виджеты создаются, но не
+// показываются; платформа - offscreen.
+//
+// Запуск: core-benchmark [--scale N] [--output файл] [--baseline файл] [--update-baseline] [--tolerance доля]
+// Результаты - JSON (в --output или в stdout). С --baseline каждый замер
+// сравнивается с базовым: медленнее больше чем на tolerance - регрессия и код
+// выхода 1. Если файла базового замера ещё нет, он создаётся из этого прогона.
+
+#include "../helpers/sceneexporter.h"
+#include "../helpers/sceneserializer.h"
+#include "../items/strokeitem.h"
+#include "../widgets/sceneeditwidget.h"
+#include "../widgets/tableeditwidget.h"
+#include "../widgets/texteditwidget.h"
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QGraphicsEllipseItem>
+#include <QGraphicsRectItem>
+#include <QGraphicsScene>
+#include <QGraphicsTextItem>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QPainter>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <QTextEdit>
+#include <QThread>
+#include <QtMath>
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+
+// Друг SceneEditWidget: движение запускается без диалогов, кадр считается по вызову
+struct BenchmarkAccess
+{
+	static void startMotion(SceneEditWidget& widget, qreal speed)
+	{
+		widget.stopMovingItem();
+		widget.motionThread_->setWorldBounds(SceneExporter::page(widget.scene_));
+		QRandomGenerator random(7);
+		for (QGraphicsItem* item : SceneSerializer::topLevelItems(widget.scene_))
+		{
+			const double angle = random.bounded(2 * M_PI);
+			widget.addMotionBody(item, QPointF(qCos(angle), qSin(angle)) * speed, 3600);
+		}
+		if (!widget.motionThread_->isRunning())
+			widget.motionThread_->start();
+	}
+
+	static void tick(SceneEditWidget& widget) { widget.updateItemPosition(); }
+	static void stopMotion(SceneEditWidget& widget) { widget.stopMovingItem(); }
+};
+
+namespace
+{
+	constexpr int Repeats = 5;
+	constexpr int TextEdits = 200;
+	constexpr int MotionFrames = 120;
+	constexpr int MotionFrameMs = 16;
+	const QSize RenderSize(1920, 1080);
+
+	struct Sizes
+	{
+		int textLines;
+		int csvRows;
+		int csvColumns;
+		int sceneItems;
+		int motionBodies;
+	};
+
+	// Таблица пересчитывает грязность на каждую ячейку при загрузке - CSV растёт медленнее остальных
+	Sizes sizesFor(int scale) { return {20000 * scale, 300 * scale, 10, 5000 * scale, 500 * scale}; }
+
+	struct Measurement
+	{
+		QString name;
+		QString unit;
+		double median;
+		double min;
+		int runs;
+	};
+
+	// Один и тот же seed - одинаковые входы во всех прогонах
+	namespace Synthetic
+	{
+		QString word(QRandomGenerator& random)
+		{
+			static const char* const words[] = {"lorem", "ipsum", "dolor", "sit", "amet", "consectetur",
+												 "adipiscing", "elit", "sed", "do", "eiusmod", "tempor"};
+			return QString::fromLatin1(words[random.bounded(int(std::size(words)))]);
+		}
+
+		QString text(int lines)
+		{
+			QRandomGenerator random(1);
+			QString result;
+			for (int line = 0; line < lines; ++line)
+			{
+				const int count = 4 + random.bounded(12);
+				for (int i = 0; i < count; ++i)
+					result += word(random) + (i + 1 < count ? u' ' : u'\n');
+			}
+			return result;
+		}
+
+		// Первая строка - заголовок; часть полей в кавычках, с запятыми и кавычками внутри
+		QString csv(int rows, int columns)
+		{
+			QRandomGenerator random(2);
+			QList<QStringList> table;
+			QStringList header;
+			for (int column = 0; column < columns; ++column)
+				header.append(QStringLiteral("column%1").arg(column + 1));
+			table.append(header);
+			for (int row = 0; row < rows; ++row)
+			{
+				QStringList fields;
+				for (int column = 0; column < columns; ++column)
+				{
+					switch (random.bounded(4))
+					{
+					case 0:
+						fields.append(QString::number(random.bounded(100000)));
+						break;
+					case 1:
+						fields.append(word(random) + QStringLiteral(", ") + word(random));
+						break;
+					case 2:
+						fields.append(QStringLiteral("\"%1\"").arg(word(random)));
+						break;
+					default:
+						fields.append(word(random));
+						break;
+					}
+				}
+				table.append(fields);
+			}
+
+			QString result;
+			for (const QStringList& fields : std::as_const(table))
+			{
+				QStringList quoted;
+				for (QString field : fields)
+				{
+					if (field.contains(u',') || field.contains(u'"'))
+						field = u'"' + field.replace(u'"', QStringLiteral("\"\"")) + u'"';
+					quoted.append(field);
+				}
+				result += quoted.join(u',') + u'\n';
+			}
+			return result;
+		}
+
+		void scene(QGraphicsScene& scene, int items)
+		{
+			QRandomGenerator random(3);
+			const qreal side = qSqrt(qreal(items)) * 40;
+			scene.setSceneRect(0, 0, side, side);
+			auto randomPoint = [&]() { return QPointF(random.bounded(side), random.bounded(side)); };
+			auto randomColor = [&]() { return QColor::fromHsv(random.bounded(360), 200, 220); };
+
+			for (int i = 0; i < items; ++i)
+			{
+				QGraphicsItem* item = nullptr;
+				switch (i % 4)
+				{
+				case 0:
+					item = new QGraphicsRectItem(0, 0, 10 + random.bounded(40), 10 + random.bounded(40));
+					static_cast<QGraphicsRectItem*>(item)->setBrush(randomColor());
+					break;
+				case 1:
+				{
+					const qreal diameter = 10 + random.bounded(40);
+					item = new QGraphicsEllipseItem(0, 0, diameter, diameter);
+					static_cast<QGraphicsEllipseItem*>(item)->setBrush(randomColor());
+					break;
+				}
+				case 2:
+				{
+					auto stroke = new StrokeItem(QPen(randomColor(), 3, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin), QPointF());
+					QPolygonF points;
+					QPointF point;
+					for (int j = 0; j < 30; ++j)
+					{
+						points.append(point);
+						point += QPointF(random.bounded(10.0) - 3, random.bounded(10.0) - 5);
+					}
+					stroke->setPoints(points, true);
+					item = stroke;
+					break;
+				}
+				default:
+					item = new QGraphicsTextItem(word(random));
+					break;
+				}
+				item->setPos(randomPoint());
+				item->setFlags(QGraphicsItem::ItemIsMovable | QGraphicsItem::ItemIsSelectable);
+				scene.addItem(item);
+			}
+		}
+	}
+
+	bool writeFile(const QString& path, const QByteArray& data)
+	{
+		QFile file(path);
+		return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+	}
+
+	bool writeScene(const QString& path, int items)
+	{
+		QGraphicsScene scene;
+		Synthetic::scene(scene, items);
+		QFile file(path);
+		return file.open(QIODevice::WriteOnly) && SceneSerializer::save(&scene, &file, SceneSerializer::Format::Json);
+	}
+
+	Measurement fromSamples(const QString& name, const QString& unit, QList<double> samples)
+	{
+		std::sort(samples.begin(), samples.end());
+		return {name, unit, samples[samples.size() / 2], samples.first(), int(samples.size())};
+	}
+
+	// Каждый прогон замеряется целиком; в отчёт идут медиана и минимум
+	Measurement measure(const QString& name, const std::function<void()>& body)
+	{
+		QList<double> samples;
+		for (int i = 0; i < Repeats; ++i)
+		{
+			QElapsedTimer timer;
+			timer.start();
+			body();
+			samples.append(timer.nsecsElapsed() / 1e6);
+		}
+		return fromSamples(name, QStringLiteral("ms"), samples);
+	}
+
+	QJsonObject toJson(const Measurement& measurement)
+	{
+		return {{QStringLiteral("name"), measurement.name},
+				{QStringLiteral("unit"), measurement.unit},
+				{QStringLiteral("median"), measurement.median},
+				{QStringLiteral("min"), measurement.min},
+				{QStringLiteral("runs"), measurement.runs}};
+	}
+
+	// Возвращает число регрессий
+	int compare(const QJsonObject& baseline, const QList<Measurement>& results, double tolerance)
+	{
+		QHash<QString, double> medians;
+		const QJsonArray array = baseline.value(QStringLiteral("results")).toArray();
+		for (const QJsonValue& value : array)
+			medians.insert(value[QStringLiteral("name")].toString(), value[QStringLiteral("median")].toDouble());
+
+		int regressions = 0;
+		std::fprintf(stderr, "%-16s %12s %12s %9s\n", "", "baseline", "current", "change");
+		for (const Measurement& result : results)
+		{
+			const QByteArray name = result.name.toUtf8();
+			const double base = medians.value(result.name);
+			if (base <= 0)
+			{
+				std::fprintf(stderr, "%-16s %12s %12.3f %9s  new\n", name.constData(), "-", result.median, "");
+				continue;
+			}
+			const double ratio = result.median / base;
+			const char* status = "";
+			if (ratio > 1 + tolerance)
+			{
+				status = "  REGRESSION";
+				++regressions;
+			}
+			else if (ratio < 1 / (1 + tolerance))
+			{
+				status = "  faster";
+			}
+			std::fprintf(stderr, "%-16s %12.3f %12.3f %+8.1f%%%s\n", name.constData(), base, result.median,
+						 (ratio - 1) * 100, status);
+		}
+		return regressions;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	// Окно не нужно; без этого на машине без дисплея QApplication не создаётся
+	if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+		qputenv("QT_QPA_PLATFORM", "offscreen");
+	QApplication app(argc, argv);
+
+	QCommandLineParser parser;
+	parser.addHelpOption();
+	parser.addOption({QStringLiteral("scale"), QStringLiteral("Input size multiplier."), QStringLiteral("n"), QStringLiteral("1")});
+	parser.addOption({QStringLiteral("output"), QStringLiteral("Write the JSON report here instead of stdout."), QStringLiteral("file")});
+	parser.addOption({QStringLiteral("baseline"), QStringLiteral("Compare with this report; created if missing."), QStringLiteral("file")});
+	parser.addOption({QStringLiteral("update-baseline"), QStringLiteral("Overwrite the baseline with this run.")});
+	parser.addOption({QStringLiteral("tolerance"), QStringLiteral("Allowed slowdown before a regression."), QStringLiteral("fraction"),
+					  QStringLiteral("0.2")});
+	parser.process(app);
+
+	const int scale = qMax(1, parser.value(QStringLiteral("scale")).toInt());
+	const double tolerance = qMax(0.0, parser.value(QStringLiteral("tolerance")).toDouble());
+	const Sizes sizes = sizesFor(scale);
+
+	QTemporaryDir directory;
+	const QString textPath = directory.filePath(QStringLiteral("text.txt"));
+	const QString csvPath = directory.filePath(QStringLiteral("table.csv"));
+	const QString scenePath = directory.filePath(QStringLiteral("scene.json"));
+	const QString motionScenePath = directory.filePath(QStringLiteral("motion.json"));
+	if (!directory.isValid() || !writeFile(textPath, Synthetic::text(sizes.textLines).toUtf8())
+		|| !writeFile(csvPath, Synthetic::csv(sizes.csvRows, sizes.csvColumns).toUtf8())
+		|| !writeScene(scenePath, sizes.sceneItems) || !writeScene(motionScenePath, sizes.motionBodies))
+	{
+		std::fprintf(stderr, "cannot write inputs to %s\n", qPrintable(directory.path()));
+		return 2;
+	}
+
+	QList<Measurement> results;
+
+	TableEditWidget table;
+	results.append(measure(QStringLiteral("csv.load"), [&]() { table.openFile(csvPath); }));
+	results.append(measure(QStringLiteral("csv.save"),
+						   [&]() { table.saveFile(directory.filePath(QStringLiteral("saved.csv"))); }));
+
+	TextEditWidget text;
+	results.append(measure(QStringLiteral("text.open"), [&]() { text.openFile(textPath); }));
+	{
+		// Каждая правка сравнивает весь текст с исходным
+		QList<double> samples;
+		QTextEdit* edit = text.getTextEdit();
+		for (int i = 0; i < TextEdits; ++i)
+		{
+			QTextCursor cursor = edit->textCursor();
+			cursor.movePosition(QTextCursor::End);
+			QElapsedTimer timer;
+			timer.start();
+			cursor.insertText(QStringLiteral("x"));
+			samples.append(timer.nsecsElapsed() / 1e3);
+		}
+		results.append(fromSamples(QStringLiteral("text.edit"), QStringLiteral("us"), samples));
+	}
+
+	QGraphicsScene scene;
+	results.append(measure(QStringLiteral("scene.load"), [&]() {
+		QFile file(scenePath);
+		file.open(QIODevice::ReadOnly);
+		SceneSerializer::load(&scene, &file);
+	}));
+	results.append(measure(QStringLiteral("scene.render"), [&]() {
+		QImage image(RenderSize, QImage::Format_ARGB32_Premultiplied);
+		image.fill(Qt::white);
+		QPainter painter(&image);
+		painter.setRenderHints(QPainter::Antialiasing | QPainter::SmoothPixmapTransform | QPainter::TextAntialiasing);
+		scene.render(&painter, QRectF(QPointF(0, 0), RenderSize), scene.sceneRect());
+	}));
+	results.append(measure(QStringLiteral("scene.export"), [&]() {
+		SceneExporter::exportScene(&scene, directory.filePath(QStringLiteral("scene.png")), SceneExporter::ScreenDpi);
+	}));
+
+	{
+		// Кадр - перенос опубликованных потоком положений на элементы и в индекс
+		SceneEditWidget sceneEdit;
+		sceneEdit.openFile(motionScenePath);
+		BenchmarkAccess::startMotion(sceneEdit, 300);
+		QList<double> samples;
+		for (int frame = 0; frame < MotionFrames; ++frame)
+		{
+			QThread::msleep(MotionFrameMs);
+			QElapsedTimer timer;
+			timer.start();
+			BenchmarkAccess::tick(sceneEdit);
+			samples.append(timer.nsecsElapsed() / 1e3);
+		}
+		BenchmarkAccess::stopMotion(sceneEdit);
+		results.append(fromSamples(QStringLiteral("motion.tick"), QStringLiteral("us"), samples));
+	}
+
+	QJsonArray array;
+	for (const Measurement& result : std::as_const(results))
+		array.append(toJson(result));
+	const QJsonObject report{{QStringLiteral("scale"), scale}, {QStringLiteral("results"), array}};
+	const QByteArray json = QJsonDocument(report).toJson();
+
+	if (parser.isSet(QStringLiteral("output")))
+	{
+		if (!writeFile(parser.value(QStringLiteral("output")), json))
+		{
+			std::fprintf(stderr, "cannot write %s\n", qPrintable(parser.value(QStringLiteral("output"))));
+			return 2;
+		}
+	}
+	else
+	{
+		std::fwrite(json.constData(), 1, size_t(json.size()), stdout);
+	}
+
+	if (!parser.isSet(QStringLiteral("baseline")))
+		return 0;
+
+	const QString baselinePath = parser.value(QStringLiteral("baseline"));
+	QFile baselineFile(baselinePath);
+	if (parser.isSet(QStringLiteral("update-baseline")) || !baselineFile.exists())
+	{
+		if (!writeFile(baselinePath, json))
+		{
+			std::fprintf(stderr, "cannot write %s\n", qPrintable(baselinePath));
+			return 2;
+		}
+		std::fprintf(stderr, "baseline written to %s\n", qPrintable(baselinePath));
+		return 0;
+	}
+
+	if (!baselineFile.open(QIODevice::ReadOnly))
+	{
+		std::fprintf(stderr, "cannot read %s\n", qPrintable(baselinePath));
+		return 2;
+	}
+	const QJsonObject baseline = QJsonDocument::fromJson(baselineFile.readAll()).object();
+	if (baseline.value(QStringLiteral("scale")).toInt() != scale)
+	{
+		std::fprintf(stderr, "baseline was taken with --scale %d, not comparing\n", baseline.value(QStringLiteral("scale")).toInt());
+		return 0;
+	}
+	const int regressions = compare(baseline, results, tolerance);
+	return regressions == 0 ? 0 : 1;
+}
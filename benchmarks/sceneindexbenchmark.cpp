@@ -0,0 +1,218 @@
+// Проверки попадания и выборки по прямоугольнику на большой сцене: SceneIndex
+// против встроенного BSP-индекса QGraphicsScene - на неподвижной сцене и когда
+// каждый кадр часть элементов сдвигается. Отдельно замеряются пути самого
+// QGraphicsView - отрисовка и нажатие мыши: они идут через индекс сцены, и
+// колонка NoIndex показывает, во что обходится сцена без BSP.
+//
+// Запуск: sceneindex-benchmark [число элементов] (по умолчанию 500000)
+
+#include "../helpers/sceneindex.h"
+
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QGraphicsRectItem>
+#include <QGraphicsScene>
+#include <QGraphicsView>
+#include <QImage>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QRandomGenerator>
+#include <QtMath>
+
+#include <cstdio>
+
+namespace
+{
+	constexpr int QueryCount = 10000;
+	constexpr int ChurnFrames = 10;
+	constexpr int ChurnQueriesPerFrame = 100;
+	constexpr double ChurnFraction = 0.05;
+	constexpr qreal QueryRectSide = 200;
+	constexpr int RenderCount = 20;
+	constexpr int PressCount = 1000;
+	constexpr QSize ViewSize(1024, 768);
+
+	// Как ищет элементы сцена: BSP, перебор всех элементов, BSP и SceneIndex для запросов редактора
+	enum class Mode
+	{
+		Bsp,
+		NoIndex,
+		SceneIndex
+	};
+
+	struct Result
+	{
+		double buildMs = 0;
+		double itemAtUs = 0;   // на один запрос
+		double rectUs = 0;     // на один запрос
+		double renderMs = 0;   // на один кадр вида
+		double pressUs = 0;    // на нажатие и отпускание кнопки
+		double churnFrameMs = 0;
+		double churnItemAtUs = 0;
+		double churnRectUs = 0;
+		double churnRenderMs = 0;
+		qint64 checksum = 0;   // одинаковый во всех режимах - результаты совпадают
+	};
+
+	double elapsedMs(const QElapsedTimer& timer) { return timer.nsecsElapsed() / 1e6; }
+
+	void sendMouse(QWidget* viewport, QEvent::Type type, const QPointF& pos)
+	{
+		const Qt::MouseButtons buttons = type == QEvent::MouseButtonPress ? Qt::LeftButton : Qt::NoButton;
+		QMouseEvent event(type, pos, viewport->mapToGlobal(pos), Qt::LeftButton, buttons, Qt::NoModifier);
+		QApplication::sendEvent(viewport, &event);
+	}
+
+	Result run(Mode mode, int itemCount)
+	{
+		Result result;
+		const bool useSceneIndex = mode == Mode::SceneIndex;
+		const qreal worldSide = qSqrt(qreal(itemCount)) * 40;
+		QRandomGenerator random(12345);
+		auto randomPoint = [&]() { return QPointF(random.bounded(worldSide), random.bounded(worldSide)); };
+
+		QGraphicsScene scene(0, 0, worldSide, worldSide);
+		if (mode == Mode::NoIndex)
+			scene.setItemIndexMethod(QGraphicsScene::NoIndex);
+		QList<QGraphicsItem*> items;
+		items.reserve(itemCount);
+
+		QElapsedTimer timer;
+		timer.start();
+		for (int i = 0; i < itemCount; ++i)
+		{
+			auto item = new QGraphicsRectItem(0, 0, 10 + random.bounded(30), 10 + random.bounded(30));
+			item->setPos(randomPoint());
+			item->setFlag(QGraphicsItem::ItemIsSelectable);
+			scene.addItem(item);
+			items.append(item);
+		}
+		if (useSceneIndex)
+			SceneIndex::install(&scene);
+		scene.itemAt(QPointF(), QTransform()); // BSP строится лениво, при первом запросе
+		result.buildMs = elapsedMs(timer);
+
+		QGraphicsView view(&scene);
+		view.resize(ViewSize);
+		view.show();
+		QImage frame(view.viewport()->size(), QImage::Format_ARGB32_Premultiplied);
+		auto render = [&]() {
+			view.centerOn(randomPoint());
+			QPainter painter(&frame);
+			view.render(&painter, QRectF(), view.viewport()->rect());
+		};
+
+		auto itemAt = [&](const QPointF& pos) {
+			return useSceneIndex ? SceneIndex::itemAt(&scene, pos) : scene.itemAt(pos, QTransform());
+		};
+		auto itemsIn = [&](const QRectF& rect) {
+			return useSceneIndex ? SceneIndex::items(&scene, rect, Qt::IntersectsItemBoundingRect)
+								 : scene.items(rect, Qt::IntersectsItemBoundingRect);
+		};
+
+		timer.restart();
+		for (int i = 0; i < QueryCount; ++i)
+			result.checksum += itemAt(randomPoint()) ? 1 : 0;
+		result.itemAtUs = elapsedMs(timer) * 1000 / QueryCount;
+
+		timer.restart();
+		for (int i = 0; i < QueryCount; ++i)
+			result.checksum += itemsIn(QRectF(randomPoint(), QSizeF(QueryRectSide, QueryRectSide))).size();
+		result.rectUs = elapsedMs(timer) * 1000 / QueryCount;
+
+		timer.restart();
+		for (int i = 0; i < RenderCount; ++i)
+			render();
+		result.renderMs = elapsedMs(timer) / RenderCount;
+
+		// Нажатие выделяет элемент под курсором: сцена ищет его через свой индекс
+		view.centerOn(worldSide / 2, worldSide / 2);
+		timer.restart();
+		for (int i = 0; i < PressCount; ++i)
+		{
+			const QPointF pos(random.bounded(qreal(ViewSize.width())), random.bounded(qreal(ViewSize.height())));
+			sendMouse(view.viewport(), QEvent::MouseButtonPress, pos);
+			sendMouse(view.viewport(), QEvent::MouseButtonRelease, pos);
+			result.checksum += scene.selectedItems().size();
+		}
+		result.pressUs = elapsedMs(timer) * 1000 / PressCount;
+
+		// Каждый кадр двигается часть элементов, затем идут запросы - как при анимации
+		double moveMs = 0;
+		double itemAtMs = 0;
+		double rectMs = 0;
+		double renderMs = 0;
+		const int movedPerFrame = qMax(1, int(itemCount * ChurnFraction));
+		for (int frame = 0; frame < ChurnFrames; ++frame)
+		{
+			timer.restart();
+			for (int i = 0; i < movedPerFrame; ++i)
+			{
+				QGraphicsItem* item = items[random.bounded(itemCount)];
+				item->moveBy(random.bounded(20.0) - 10, random.bounded(20.0) - 10);
+				if (useSceneIndex)
+					SceneIndex::update(&scene, item);
+			}
+			moveMs += elapsedMs(timer);
+
+			timer.restart();
+			for (int i = 0; i < ChurnQueriesPerFrame; ++i)
+				result.checksum += itemAt(randomPoint()) ? 1 : 0;
+			itemAtMs += elapsedMs(timer);
+
+			timer.restart();
+			for (int i = 0; i < ChurnQueriesPerFrame; ++i)
+				result.checksum += itemsIn(QRectF(randomPoint(), QSizeF(QueryRectSide, QueryRectSide))).size();
+			rectMs += elapsedMs(timer);
+
+			timer.restart();
+			render();
+			renderMs += elapsedMs(timer);
+		}
+		result.churnFrameMs = (moveMs + itemAtMs + rectMs + renderMs) / ChurnFrames;
+		result.churnItemAtUs = itemAtMs * 1000 / (ChurnFrames * ChurnQueriesPerFrame);
+		result.churnRectUs = rectMs * 1000 / (ChurnFrames * ChurnQueriesPerFrame);
+		result.churnRenderMs = renderMs / ChurnFrames;
+		return result;
+	}
+
+	void print(const char* name, const Result (&results)[3], double Result::*value, const char* unit)
+	{
+		std::printf("%-34s %12.3f %12.3f %12.3f %s\n", name, results[0].*value, results[1].*value,
+					results[2].*value, unit);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	// Вид рисует в QImage, окно на экране не нужно; без этого на машине без дисплея QApplication не создаётся
+	if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+		qputenv("QT_QPA_PLATFORM", "offscreen");
+	QApplication app(argc, argv);
+
+	const int itemCount = argc > 1 ? qMax(1, QString::fromLocal8Bit(argv[1]).toInt()) : 500000;
+	std::printf("%d items, %d queries, %d churn frames moving %.0f%% of items\n\n", itemCount, QueryCount,
+				ChurnFrames, ChurnFraction * 100);
+
+	const Result results[] = {run(Mode::Bsp, itemCount), run(Mode::NoIndex, itemCount),
+							  run(Mode::SceneIndex, itemCount)};
+
+	std::printf("%-34s %12s %12s %12s\n", "", "BSP", "NoIndex", "SceneIndex");
+	print("build", results, &Result::buildMs, "ms");
+	print("itemAt, static", results, &Result::itemAtUs, "us");
+	print("items(rect), static", results, &Result::rectUs, "us");
+	print("view render, static", results, &Result::renderMs, "ms");
+	print("view mouse press, static", results, &Result::pressUs, "us");
+	print("frame with churn", results, &Result::churnFrameMs, "ms");
+	print("itemAt under churn", results, &Result::churnItemAtUs, "us");
+	print("items(rect) under churn", results, &Result::churnRectUs, "us");
+	print("view render under churn", results, &Result::churnRenderMs, "ms");
+
+	for (const Result& result : results)
+		if (result.checksum != results[0].checksum)
+		{
+			std::printf("\nresults differ: %lld vs %lld\n", results[0].checksum, result.checksum);
+			return 1;
+		}
+	return 0;
+}
@@ -7,7 +7,8 @@ enum ToolType
 	BrushTool,
 	EraserTool,
 	ShapeTool,
-	TextTool
+	TextTool,
+	FillTool
 };
 
 #endif // TOOLTYPE_H
@@ -4,7 +4,7 @@ const QMap<QVector<QString>, WorkType> fileExtensionMap
 {
 	{{"txt", "html"}, WorkType::Text},
 	{{"csv"}, WorkType::Table},
-	{{"json"}, WorkType::InteractiveScene}
+	{{"json", "cbor"}, WorkType::InteractiveScene}
 };
 
 WorkType getWorktypeByExtension(const QString &fileExtension)
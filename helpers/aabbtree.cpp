@@ -0,0 +1,283 @@
+#include "aabbtree.h"
+
+#include <QtGlobal>
+
+AabbTree::Box AabbTree::toBox(const QRectF& rect)
+{
+	const QRectF normalized = rect.normalized();
+	return {normalized.left(), normalized.top(), normalized.right(), normalized.bottom()};
+}
+
+AabbTree::Box AabbTree::united(const Box& a, const Box& b)
+{
+	return {qMin(a.left, b.left), qMin(a.top, b.top), qMax(a.right, b.right), qMax(a.bottom, b.bottom)};
+}
+
+bool AabbTree::contains(const Box& outer, const Box& inner)
+{
+	return outer.left <= inner.left && outer.top <= inner.top && outer.right >= inner.right && outer.bottom >= inner.bottom;
+}
+
+QRectF AabbTree::fatBounds(int proxy) const
+{
+	const Box& box = nodes_[proxy].box;
+	return QRectF(QPointF(box.left, box.top), QPointF(box.right, box.bottom));
+}
+
+int AabbTree::allocateNode()
+{
+	if (freeList_ == NullNode)
+	{
+		nodes_.append(Node());
+		return nodes_.size() - 1;
+	}
+
+	const int index = freeList_;
+	freeList_ = nodes_[index].parent;
+	nodes_[index] = Node();
+	return index;
+}
+
+void AabbTree::freeNode(int index)
+{
+	nodes_[index].parent = freeList_;
+	nodes_[index].height = -1;
+	nodes_[index].data = nullptr;
+	freeList_ = index;
+}
+
+int AabbTree::insert(const QRectF& bounds, void* data)
+{
+	const int leaf = allocateNode();
+	Box box = toBox(bounds);
+	box.left -= margin_;
+	box.top -= margin_;
+	box.right += margin_;
+	box.bottom += margin_;
+	nodes_[leaf].box = box;
+	nodes_[leaf].data = data;
+	insertLeaf(leaf);
+	++count_;
+	return leaf;
+}
+
+void AabbTree::remove(int proxy)
+{
+	removeLeaf(proxy);
+	freeNode(proxy);
+	--count_;
+}
+
+bool AabbTree::move(int proxy, const QRectF& bounds)
+{
+	const Box box = toBox(bounds);
+	if (contains(nodes_[proxy].box, box))
+		return false;
+
+	removeLeaf(proxy);
+	nodes_[proxy].box = {box.left - margin_, box.top - margin_, box.right + margin_, box.bottom + margin_};
+	insertLeaf(proxy);
+	return true;
+}
+
+void AabbTree::clear()
+{
+	nodes_.clear();
+	root_ = NullNode;
+	freeList_ = NullNode;
+	count_ = 0;
+}
+
+void AabbTree::insertLeaf(int leaf)
+{
+	if (root_ == NullNode)
+	{
+		root_ = leaf;
+		nodes_[leaf].parent = NullNode;
+		return;
+	}
+
+	// Спуск к соседу, при котором суммарный периметр узлов растёт меньше всего
+	const Box leafBox = nodes_[leaf].box;
+	int index = root_;
+	while (!nodes_[index].isLeaf())
+	{
+		const Node& node = nodes_[index];
+		const qreal area = perimeter(node.box);
+		const qreal combinedArea = perimeter(united(node.box, leafBox));
+		const qreal cost = 2 * combinedArea;
+		const qreal inheritance = 2 * (combinedArea - area);
+
+		auto descendCost = [&](int child)
+		{
+			const Node& childNode = nodes_[child];
+			const qreal enlarged = perimeter(united(leafBox, childNode.box));
+			return childNode.isLeaf() ? enlarged + inheritance : enlarged - perimeter(childNode.box) + inheritance;
+		};
+		const qreal leftCost = descendCost(node.left);
+		const qreal rightCost = descendCost(node.right);
+
+		if (cost < leftCost && cost < rightCost)
+			break;
+		index = leftCost < rightCost ? node.left : node.right;
+	}
+
+	const int sibling = index;
+	const int oldParent = nodes_[sibling].parent;
+	const int newParent = allocateNode();
+	nodes_[newParent].parent = oldParent;
+	nodes_[newParent].box = united(leafBox, nodes_[sibling].box);
+	nodes_[newParent].height = nodes_[sibling].height + 1;
+	nodes_[newParent].left = sibling;
+	nodes_[newParent].right = leaf;
+	nodes_[sibling].parent = newParent;
+	nodes_[leaf].parent = newParent;
+
+	if (oldParent == NullNode)
+		root_ = newParent;
+	else if (nodes_[oldParent].left == sibling)
+		nodes_[oldParent].left = newParent;
+	else
+		nodes_[oldParent].right = newParent;
+
+	refit(nodes_[leaf].parent);
+}
+
+void AabbTree::removeLeaf(int leaf)
+{
+	if (leaf == root_)
+	{
+		root_ = NullNode;
+		return;
+	}
+
+	const int parent = nodes_[leaf].parent;
+	const int grandParent = nodes_[parent].parent;
+	const int sibling = nodes_[parent].left == leaf ? nodes_[parent].right : nodes_[parent].left;
+
+	if (grandParent == NullNode)
+	{
+		root_ = sibling;
+		nodes_[sibling].parent = NullNode;
+		freeNode(parent);
+		return;
+	}
+
+	if (nodes_[grandParent].left == parent)
+		nodes_[grandParent].left = sibling;
+	else
+		nodes_[grandParent].right = sibling;
+	nodes_[sibling].parent = grandParent;
+	freeNode(parent);
+	refit(grandParent);
+}
+
+void AabbTree::refit(int index)
+{
+	while (index != NullNode)
+	{
+		index = balance(index);
+		Node& node = nodes_[index];
+		const Node& left = nodes_[node.left];
+		const Node& right = nodes_[node.right];
+		node.height = 1 + qMax(left.height, right.height);
+		node.box = united(left.box, right.box);
+		index = node.parent;
+	}
+}
+
+int AabbTree::balance(int a)
+{
+	Node& nodeA = nodes_[a];
+	if (nodeA.isLeaf() || nodeA.height < 2)
+		return a;
+
+	const int b = nodeA.left;
+	const int c = nodeA.right;
+	Node& nodeB = nodes_[b];
+	Node& nodeC = nodes_[c];
+	const int difference = nodeC.height - nodeB.height;
+
+	// Поднимаем C
+	if (difference > 1)
+	{
+		const int f = nodeC.left;
+		const int g = nodeC.right;
+		Node& nodeF = nodes_[f];
+		Node& nodeG = nodes_[g];
+
+		nodeC.left = a;
+		nodeC.parent = nodeA.parent;
+		nodeA.parent = c;
+		if (nodeC.parent == NullNode)
+			root_ = c;
+		else if (nodes_[nodeC.parent].left == a)
+			nodes_[nodeC.parent].left = c;
+		else
+			nodes_[nodeC.parent].right = c;
+
+		if (nodeF.height > nodeG.height)
+		{
+			nodeC.right = f;
+			nodeA.right = g;
+			nodeG.parent = a;
+			nodeA.box = united(nodeB.box, nodeG.box);
+			nodeC.box = united(nodeA.box, nodeF.box);
+			nodeA.height = 1 + qMax(nodeB.height, nodeG.height);
+			nodeC.height = 1 + qMax(nodeA.height, nodeF.height);
+		}
+		else
+		{
+			nodeC.right = g;
+			nodeA.right = f;
+			nodeF.parent = a;
+			nodeA.box = united(nodeB.box, nodeF.box);
+			nodeC.box = united(nodeA.box, nodeG.box);
+			nodeA.height = 1 + qMax(nodeB.height, nodeF.height);
+			nodeC.height = 1 + qMax(nodeA.height, nodeG.height);
+		}
+		return c;
+	}
+
+	// Поднимаем B
+	if (difference < -1)
+	{
+		const int d = nodeB.left;
+		const int e = nodeB.right;
+		Node& nodeD = nodes_[d];
+		Node& nodeE = nodes_[e];
+
+		nodeB.left = a;
+		nodeB.parent = nodeA.parent;
+		nodeA.parent = b;
+		if (nodeB.parent == NullNode)
+			root_ = b;
+		else if (nodes_[nodeB.parent].left == a)
+			nodes_[nodeB.parent].left = b;
+		else
+			nodes_[nodeB.parent].right = b;
+
+		if (nodeD.height > nodeE.height)
+		{
+			nodeB.right = d;
+			nodeA.left = e;
+			nodeE.parent = a;
+			nodeA.box = united(nodeC.box, nodeE.box);
+			nodeB.box = united(nodeA.box, nodeD.box);
+			nodeA.height = 1 + qMax(nodeC.height, nodeE.height);
+			nodeB.height = 1 + qMax(nodeA.height, nodeD.height);
+		}
+		else
+		{
+			nodeB.right = e;
+			nodeA.left = d;
+			nodeD.parent = a;
+			nodeA.box = united(nodeC.box, nodeD.box);
+			nodeB.box = united(nodeA.box, nodeE.box);
+			nodeA.height = 1 + qMax(nodeC.height, nodeD.height);
+			nodeB.height = 1 + qMax(nodeA.height, nodeE.height);
+		}
+		return b;
+	}
+	return a;
+}
@@ -0,0 +1,108 @@
+#ifndef AABBTREE_H
+#define AABBTREE_H
+
+#include <QRectF>
+#include <QVarLengthArray>
+#include <QVector>
+
+// Динамическое дерево ограничивающих прямоугольников. Лист хранит прямоугольник,
+// расширенный на margin: небольшие сдвиги не трогают дерево, а вставка и
+// удаление стоят O(log n) и балансируются поворотами, без полной перестройки.
+class AabbTree
+{
+  public:
+	static constexpr int NullNode = -1;
+
+	explicit AabbTree(qreal margin = 8) : margin_(margin) {}
+
+	int insert(const QRectF& bounds, void* data);
+	void remove(int proxy);
+	// false - новый прямоугольник поместился в расширенный, дерево не менялось
+	bool move(int proxy, const QRectF& bounds);
+	void clear();
+
+	void* data(int proxy) const { return nodes_[proxy].data; }
+	QRectF fatBounds(int proxy) const;
+	int count() const { return count_; }
+	int height() const { return root_ == NullNode ? 0 : nodes_[root_].height; }
+
+	// visitor(int proxy) -> bool; false прекращает обход. Границы включаются,
+	// поэтому прямоугольник нулевого размера работает как точка
+	template <typename Visitor>
+	void query(const QRectF& rect, Visitor visitor) const;
+
+  private:
+	struct Box
+	{
+		qreal left;
+		qreal top;
+		qreal right;
+		qreal bottom;
+	};
+
+	struct Node
+	{
+		Box box;
+		void* data = nullptr;
+		int parent = NullNode; // в списке свободных - следующий свободный узел
+		int left = NullNode;
+		int right = NullNode;
+		int height = 0;        // 0 - лист, -1 - свободный узел
+
+		bool isLeaf() const { return left == NullNode; }
+	};
+
+	QVector<Node> nodes_;
+	int root_ = NullNode;
+	int freeList_ = NullNode;
+	int count_ = 0;
+	qreal margin_;
+
+	int allocateNode();
+	void freeNode(int index);
+	void insertLeaf(int leaf);
+	void removeLeaf(int leaf);
+	int balance(int index);
+	void refit(int index);
+
+	static Box toBox(const QRectF& rect);
+	static Box united(const Box& a, const Box& b);
+	static qreal perimeter(const Box& box) { return 2 * ((box.right - box.left) + (box.bottom - box.top)); }
+	static bool contains(const Box& outer, const Box& inner);
+	static bool overlaps(const Box& a, const Box& b)
+	{
+		return a.left <= b.right && b.left <= a.right && a.top <= b.bottom && b.top <= a.bottom;
+	}
+};
+
+template <typename Visitor>
+void AabbTree::query(const QRectF& rect, Visitor visitor) const
+{
+	if (root_ == NullNode)
+		return;
+
+	const Box box = toBox(rect);
+	QVarLengthArray<int, 64> stack;
+	stack.append(root_);
+	while (!stack.isEmpty())
+	{
+		const int index = stack.last();
+		stack.removeLast();
+
+		const Node& node = nodes_[index];
+		if (!overlaps(node.box, box))
+			continue;
+		if (node.isLeaf())
+		{
+			if (!visitor(index))
+				return;
+		}
+		else
+		{
+			stack.append(node.left);
+			stack.append(node.right);
+		}
+	}
+}
+
+#endif // AABBTREE_H
@@ -0,0 +1,267 @@
+#include "batchrunner.h"
+#include "csvtable.h"
+#include "sceneexporter.h"
+#include "sceneserializer.h"
+
+#include <QBuffer>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QFuture>
+#include <QGraphicsScene>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <cstring>
+
+namespace
+{
+	enum class Command
+	{
+		NormalizeCsv,
+		CsvToJson,
+		SceneToPng
+	};
+
+	struct Options
+	{
+		Command command;
+		QString outputDirectory; // пусто - рядом с исходным файлом
+		qreal dpi = SceneExporter::ScreenDpi;
+	};
+
+	struct FileResult
+	{
+		QString input;
+		QString output;
+		QString error;
+		QByteArray sceneData; // scene-to-png: файл прочитан в пуле, сцена строится в главном потоке
+		qint64 bytes = 0;
+		double ms = 0;
+	};
+
+	QString outputPath(const QString& input, const Options& options)
+	{
+		const QFileInfo info(input);
+		const QString directory = options.outputDirectory.isEmpty() ? info.absolutePath() : options.outputDirectory;
+		QString suffix;
+		switch (options.command)
+		{
+		case Command::NormalizeCsv:
+			suffix = QStringLiteral(".csv");
+			break;
+		case Command::CsvToJson:
+			suffix = QStringLiteral(".json");
+			break;
+		case Command::SceneToPng:
+			suffix = QStringLiteral(".png");
+			break;
+		}
+
+		QString path = QDir(directory).filePath(info.completeBaseName() + suffix);
+		// Исходник не перезаписывается
+		if (QFileInfo(path).absoluteFilePath() == info.absoluteFilePath())
+			path = QDir(directory).filePath(info.completeBaseName() + QStringLiteral(".normalized") + suffix);
+		return path;
+	}
+
+	bool readData(const QString& path, QByteArray& data, QString& error)
+	{
+		QFile file(path);
+		if (!file.open(QIODevice::ReadOnly))
+		{
+			error = file.errorString();
+			return false;
+		}
+		data = file.readAll();
+		return true;
+	}
+
+	bool readText(const QString& path, QString& text, QString& error)
+	{
+		QFile file(path);
+		if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+		{
+			error = file.errorString();
+			return false;
+		}
+		text = QTextStream(&file).readAll();
+		return true;
+	}
+
+	bool writeData(const QString& path, const QByteArray& data, QString& error)
+	{
+		QSaveFile file(path);
+		if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit())
+		{
+			error = file.errorString();
+			return false;
+		}
+		return true;
+	}
+
+	// QGraphicsScene и QPixmap работают только в главном потоке, поэтому сцены
+	// строятся и экспортируются по одной; плитки экспорт и так рисует в своём пуле
+	bool renderScene(const QByteArray& data, const QString& output, qreal dpi, QString& error)
+	{
+		QBuffer buffer;
+		buffer.setData(data);
+		buffer.open(QIODevice::ReadOnly);
+		QGraphicsScene scene;
+		if (!SceneSerializer::load(&scene, &buffer, &error))
+			return false;
+		return SceneExporter::exportScene(&scene, output, dpi, &error);
+	}
+
+	FileResult processFile(const QString& input, const Options& options)
+	{
+		FileResult result;
+		result.input = input;
+		result.output = outputPath(input, options);
+		result.bytes = QFileInfo(input).size();
+
+		QElapsedTimer timer;
+		timer.start();
+		QString text;
+		switch (options.command)
+		{
+		case Command::NormalizeCsv:
+			if (readText(input, text, result.error))
+				writeData(result.output, CsvTable::write(CsvTable::parse(text)).toUtf8(), result.error);
+			break;
+		case Command::CsvToJson:
+			if (readText(input, text, result.error))
+				writeData(result.output, CsvTable::toJson(CsvTable::parse(text)).toJson(), result.error);
+			break;
+		case Command::SceneToPng:
+			readData(input, result.sceneData, result.error);
+			break;
+		}
+		result.ms = timer.nsecsElapsed() / 1e6;
+		return result;
+	}
+
+	double megabytesPerSecond(qint64 bytes, double ms) { return ms > 0 ? bytes / 1e3 / ms : 0; }
+}
+
+bool BatchRunner::isBatch(int argc, char* argv[])
+{
+	for (int i = 1; i < argc; ++i)
+		if (std::strcmp(argv[i], "--batch") == 0 || std::strncmp(argv[i], "--batch=", 8) == 0)
+			return true;
+	return false;
+}
+
+int BatchRunner::run(const QStringList& arguments)
+{
+	QCommandLineParser parser;
+	parser.setApplicationDescription(QStringLiteral("Converts and renders files without opening a window."));
+	parser.addHelpOption();
+	parser.addOption({QStringLiteral("batch"), QStringLiteral("normalize-csv, csv-to-json or scene-to-png."),
+					  QStringLiteral("command")});
+	parser.addOption({{QStringLiteral("o"), QStringLiteral("output")},
+					  QStringLiteral("Directory for results (default: next to each input)."), QStringLiteral("directory")});
+	parser.addOption({{QStringLiteral("j"), QStringLiteral("jobs")},
+					  QStringLiteral("Files processed at once (default: number of cores)."), QStringLiteral("count")});
+	parser.addOption({QStringLiteral("dpi"), QStringLiteral("Resolution of rendered scenes."), QStringLiteral("dpi"),
+					  QString::number(SceneExporter::ScreenDpi)});
+	parser.addPositionalArgument(QStringLiteral("files"), QStringLiteral("Input files."), QStringLiteral("files..."));
+	parser.process(arguments);
+
+	QTextStream out(stdout);
+	QTextStream err(stderr);
+
+	Options options;
+	const QString command = parser.value(QStringLiteral("batch"));
+	if (command == QLatin1String("normalize-csv"))
+		options.command = Command::NormalizeCsv;
+	else if (command == QLatin1String("csv-to-json"))
+		options.command = Command::CsvToJson;
+	else if (command == QLatin1String("scene-to-png"))
+		options.command = Command::SceneToPng;
+	else
+	{
+		err << "Unknown batch command: " << command << "\n" << parser.helpText();
+		return 2;
+	}
+
+	const QStringList files = parser.positionalArguments();
+	if (files.isEmpty())
+	{
+		err << "No input files\n" << parser.helpText();
+		return 2;
+	}
+
+	options.outputDirectory = parser.value(QStringLiteral("output"));
+	if (!options.outputDirectory.isEmpty() && !QDir().mkpath(options.outputDirectory))
+	{
+		err << "Cannot create " << options.outputDirectory << "\n";
+		return 2;
+	}
+	bool ok = true;
+	options.dpi = parser.value(QStringLiteral("dpi")).toDouble(&ok);
+	if (!ok || options.dpi <= 0)
+	{
+		err << "Invalid --dpi\n";
+		return 2;
+	}
+
+	QThreadPool pool;
+	if (parser.isSet(QStringLiteral("jobs")))
+	{
+		const int jobs = parser.value(QStringLiteral("jobs")).toInt(&ok);
+		if (!ok || jobs <= 0)
+		{
+			err << "Invalid --jobs\n";
+			return 2;
+		}
+		pool.setMaxThreadCount(jobs);
+	}
+
+	QElapsedTimer timer;
+	timer.start();
+	QList<QFuture<FileResult>> futures;
+	futures.reserve(files.size());
+	for (const QString& file : files)
+		futures.append(QtConcurrent::run(&pool, processFile, file, options));
+
+	// Результаты выводятся в порядке файлов, по мере готовности
+	int failed = 0;
+	qint64 totalBytes = 0;
+	for (QFuture<FileResult>& future : futures)
+	{
+		FileResult result = future.result();
+		future = QFuture<FileResult>(); // прочитанная сцена не должна жить до конца пакета
+		totalBytes += result.bytes;
+		if (options.command == Command::SceneToPng && result.error.isEmpty())
+		{
+			QElapsedTimer renderTimer;
+			renderTimer.start();
+			if (!renderScene(result.sceneData, result.output, options.dpi, result.error) && result.error.isEmpty())
+				result.error = QStringLiteral("Export failed");
+			result.sceneData.clear();
+			result.ms += renderTimer.nsecsElapsed() / 1e6;
+		}
+		if (!result.error.isEmpty())
+		{
+			++failed;
+			err << "FAIL " << result.input << ": " << result.error << "\n";
+			err.flush();
+			continue;
+		}
+		out << "ok   " << result.input << " -> " << result.output << "  "
+			<< QString::number(result.ms, 'f', 1) << " ms  "
+			<< QString::number(megabytesPerSecond(result.bytes, result.ms), 'f', 2) << " MB/s\n";
+		out.flush();
+	}
+
+	const double totalMs = timer.nsecsElapsed() / 1e6;
+	out << files.size() << " file(s), " << failed << " failed, " << QString::number(totalMs, 'f', 1) << " ms, "
+		<< QString::number(totalMs > 0 ? files.size() * 1000.0 / totalMs : 0, 'f', 1) << " files/s, "
+		<< QString::number(megabytesPerSecond(totalBytes, totalMs), 'f', 2) << " MB/s\n";
+	return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,22 @@
+#ifndef BATCHRUNNER_H
+#define BATCHRUNNER_H
+
+#include <QStringList>
+
+// Пакетный режим без окна:
+//   TextEditor-And-Paint --batch <команда> [-o каталог] [-j потоков] [--dpi N] файлы...
+// Команды: normalize-csv (кавычки по RFC 4180, строки одной ширины), csv-to-json
+// (массив объектов по первой строке), scene-to-png (тот же экспорт, что и в окне).
+// Разбор, запись и отрисовка - общий код с виджетами; CSV обрабатываются
+// параллельно в пуле потоков, сцены пул только читает, а строит и рисует главный
+// поток по одной. По каждому файлу выводятся время и скорость.
+class BatchRunner
+{
+  public:
+	// Смотрит argv до создания QApplication: пакетному режиму нужна платформа offscreen
+	static bool isBatch(int argc, char* argv[]);
+	// Возвращает код выхода: 0 - всё обработано, 1 - были ошибки, 2 - неверные параметры
+	static int run(const QStringList& arguments);
+};
+
+#endif // BATCHRUNNER_H
@@ -0,0 +1,80 @@
+#include "collisionsoundpool.h"
+
+#include <QtMath>
+
+#ifdef WITH_MULTIMEDIA
+#include <QSoundEffect>
+#endif
+
+CollisionSoundPool::CollisionSoundPool(const QUrl& source, QObject* parent) : QObject(parent), source_(source)
+{
+	flushTimer_.setSingleShot(true);
+	flushTimer_.setTimerType(Qt::PreciseTimer);
+	connect(&flushTimer_, &QTimer::timeout, this, &CollisionSoundPool::playPending);
+}
+
+void CollisionSoundPool::prepare()
+{
+#ifdef WITH_MULTIMEDIA
+	if (!voices_.isEmpty())
+		return;
+	for (int i = 0; i < VoiceCount; ++i)
+	{
+		QSoundEffect* voice = new QSoundEffect(this);
+		voice->setSource(source_);
+		voices_.append(voice);
+	}
+#endif
+}
+
+void CollisionSoundPool::hit(int count)
+{
+	if (count <= 0)
+		return;
+	prepare();
+
+	pendingHits_ += count;
+	const qint64 elapsed = lastPlay_.isValid() ? lastPlay_.elapsed() : MinIntervalMs;
+	if (elapsed >= MinIntervalMs)
+		playPending();
+	else if (!flushTimer_.isActive())
+		flushTimer_.start(int(MinIntervalMs - elapsed));
+}
+
+void CollisionSoundPool::playPending()
+{
+	if (pendingHits_ == 0)
+		return;
+
+	// Чем больше ударов слилось в один, тем громче, но не громче полного
+	const float gain = float(qMin(1.0, 0.6 + 0.2 * std::log2(double(pendingHits_))));
+	pendingHits_ = 0;
+	lastPlay_.start();
+
+#ifdef WITH_MULTIMEDIA
+	QSoundEffect* voice = freeVoice();
+	voice->setVolume(volume_ * gain);
+	voice->play();
+#else
+	Q_UNUSED(gain);
+#endif
+}
+
+#ifdef WITH_MULTIMEDIA
+QSoundEffect* CollisionSoundPool::freeVoice()
+{
+	for (int i = 0; i < voices_.size(); ++i)
+	{
+		QSoundEffect* voice = voices_[(nextVoice_ + i) % voices_.size()];
+		if (!voice->isPlaying())
+		{
+			nextVoice_ = (nextVoice_ + i + 1) % voices_.size();
+			return voice;
+		}
+	}
+	// Все заняты - перезапускаем самый давний
+	QSoundEffect* voice = voices_[nextVoice_];
+	nextVoice_ = (nextVoice_ + 1) % voices_.size();
+	return voice;
+}
+#endif
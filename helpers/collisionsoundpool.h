@@ -0,0 +1,46 @@
+#ifndef COLLISIONSOUNDPOOL_H
+#define COLLISIONSOUNDPOOL_H
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QObject>
+#include <QTimer>
+#include <QUrl>
+
+class QSoundEffect;
+
+// Несколько голосов QSoundEffect с одним и тем же звуком. Сэмпл декодируется
+// один раз (QSoundEffect делит его через общий кэш), одновременные удары
+// звучат поверх друг друга. Удары чаще MinIntervalMs копятся и проигрываются
+// одним звуком погромче.
+// Голоса, а с ними и звуковой бэкенд Qt Multimedia, создаются только при первом
+// использовании. Без WITH_MULTIMEDIA пул молчит.
+class CollisionSoundPool : public QObject
+{
+	Q_OBJECT
+
+  public:
+	static constexpr int VoiceCount = 6;
+	static constexpr int MinIntervalMs = 35;
+
+	explicit CollisionSoundPool(const QUrl& source, QObject* parent = nullptr);
+
+	// Заранее, чтобы к первому удару сэмпл уже был загружен
+	void prepare();
+	void setVolume(float volume) { volume_ = volume; }
+	void hit(int count = 1);
+
+  private:
+	QUrl source_;
+	QList<QSoundEffect*> voices_;
+	int nextVoice_ = 0;
+	int pendingHits_ = 0;
+	float volume_ = 0.5f;
+	QElapsedTimer lastPlay_;
+	QTimer flushTimer_;
+
+	void playPending();
+	QSoundEffect* freeVoice();
+};
+
+#endif // COLLISIONSOUNDPOOL_H
@@ -0,0 +1,139 @@
+#include "csvtable.h"
+
+#include <QJsonArray>
+#include <QJsonObject>
+
+namespace
+{
+	void appendField(QString& out, const QString& field)
+	{
+		const bool needsQuotes = field.contains(u',') || field.contains(u'"') || field.contains(u'\n') || field.contains(u'\r');
+		if (!needsQuotes)
+		{
+			out += field;
+			return;
+		}
+		out += u'"';
+		for (const QChar c : field)
+		{
+			if (c == u'"')
+				out += u'"';
+			out += c;
+		}
+		out += u'"';
+	}
+}
+
+QList<QStringList> CsvTable::parse(const QString& text)
+{
+	QList<QStringList> rows;
+	QStringList row;
+	QString field;
+	bool isQuoted = false;
+	bool isFieldStart = true;
+	bool hasRow = false;
+
+	const qsizetype size = text.size();
+	for (qsizetype i = 0; i < size; ++i)
+	{
+		const QChar c = text[i];
+		if (isQuoted)
+		{
+			if (c != u'"')
+				field += c;
+			else if (i + 1 < size && text[i + 1] == u'"')
+				field += text[++i];
+			else
+				isQuoted = false;
+			continue;
+		}
+
+		if (c == u',')
+		{
+			row.append(field);
+			field.clear();
+			isFieldStart = true;
+			hasRow = true;
+		}
+		else if (c == u'\n' || c == u'\r')
+		{
+			if (c == u'\r' && i + 1 < size && text[i + 1] == u'\n')
+				++i;
+			row.append(field);
+			rows.append(row);
+			row.clear();
+			field.clear();
+			isFieldStart = true;
+			hasRow = false;
+		}
+		else if (c == u'"' && isFieldStart)
+		{
+			isQuoted = true;
+			isFieldStart = false;
+			hasRow = true;
+		}
+		else
+		{
+			// Кавычка посреди поля без кавычек - обычный символ
+			field += c;
+			isFieldStart = false;
+			hasRow = true;
+		}
+	}
+
+	if (hasRow)
+	{
+		row.append(field);
+		rows.append(row);
+	}
+	return rows;
+}
+
+QString CsvTable::write(const QList<QStringList>& rows)
+{
+	const int columns = columnCount(rows);
+	QString out;
+	for (const QStringList& row : rows)
+	{
+		for (int column = 0; column < columns; ++column)
+		{
+			if (column > 0)
+				out += u',';
+			if (column < row.size())
+				appendField(out, row[column]);
+		}
+		out += u'\n';
+	}
+	return out;
+}
+
+QJsonDocument CsvTable::toJson(const QList<QStringList>& rows)
+{
+	QJsonArray array;
+	if (rows.isEmpty())
+		return QJsonDocument(array);
+
+	const int columns = columnCount(rows);
+	QStringList keys = rows.first();
+	keys.resize(columns);
+	for (int column = 0; column < columns; ++column)
+		if (keys[column].isEmpty())
+			keys[column] = QStringLiteral("column%1").arg(column + 1);
+
+	for (qsizetype i = 1; i < rows.size(); ++i)
+	{
+		QJsonObject object;
+		for (int column = 0; column < columns; ++column)
+			object.insert(keys[column], rows[i].value(column));
+		array.append(object);
+	}
+	return QJsonDocument(array);
+}
+
+int CsvTable::columnCount(const QList<QStringList>& rows)
+{
+	qsizetype columns = 0;
+	for (const QStringList& row : rows)
+		columns = qMax(columns, row.size());
+	return int(columns);
+}
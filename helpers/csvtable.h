@@ -0,0 +1,24 @@
+#ifndef CSVTABLE_H
+#define CSVTABLE_H
+
+#include <QJsonDocument>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+// CSV по RFC 4180: поле в кавычках может содержать запятые, переводы строк
+// и удвоенные кавычки. Общий код таблицы и пакетного режима.
+class CsvTable
+{
+  public:
+	// Понимает \n и \r\n; последний перевод строки не даёт пустой строки таблицы
+	static QList<QStringList> parse(const QString& text);
+	// Кавычки ставятся только там, где без них поле не прочитать; короткие строки дополняются пустыми полями
+	static QString write(const QList<QStringList>& rows);
+	// Массив объектов, ключи - первая строка (пустой заголовок - "column<номер>")
+	static QJsonDocument toJson(const QList<QStringList>& rows);
+
+	static int columnCount(const QList<QStringList>& rows);
+};
+
+#endif // CSVTABLE_H
@@ -0,0 +1,144 @@
+#include "floodfill.h"
+
+#include <QList>
+
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	// Состояния пикселя в маске
+	constexpr uchar Rejected = 0;
+	constexpr uchar Matching = 1;
+	constexpr uchar Filled = 2;
+
+	// Без ветвлений и ранних выходов - цикл векторизуется на всю строку
+	void matchRow(const QRgb* pixels, uchar* mask, int width, QRgb target, int tolerance)
+	{
+		const int targetA = qAlpha(target);
+		const int targetR = qRed(target);
+		const int targetG = qGreen(target);
+		const int targetB = qBlue(target);
+		for (int x = 0; x < width; ++x)
+		{
+			const QRgb pixel = pixels[x];
+			const int da = qAbs(int(pixel >> 24) - targetA);
+			const int dr = qAbs(int((pixel >> 16) & 0xff) - targetR);
+			const int dg = qAbs(int((pixel >> 8) & 0xff) - targetG);
+			const int db = qAbs(int(pixel & 0xff) - targetB);
+			mask[x] = uchar(qMax(qMax(da, dr), qMax(dg, db)) <= tolerance);
+		}
+	}
+
+	class Filler
+	{
+	  public:
+		Filler(const QImage& image, QRgb target, int tolerance)
+			: image_(image), width_(image.width()), target_(target), tolerance_(tolerance),
+			  mask_(size_t(image.width()) * size_t(image.height())), rowReady_(size_t(image.height()), false)
+		{
+		}
+
+		// Маска строки считается при первом обращении - нетронутые строки не сравниваются вовсе
+		uchar* row(int y)
+		{
+			uchar* mask = mask_.data() + size_t(y) * size_t(width_);
+			if (!rowReady_[size_t(y)])
+			{
+				matchRow(reinterpret_cast<const QRgb*>(image_.constScanLine(y)), mask, width_, target_, tolerance_);
+				rowReady_[size_t(y)] = true;
+			}
+			return mask;
+		}
+
+		const uchar* filledRow(int y) const { return mask_.data() + size_t(y) * size_t(width_); }
+
+	  private:
+		const QImage& image_;
+		int width_;
+		QRgb target_;
+		int tolerance_;
+		std::vector<uchar> mask_;
+		std::vector<bool> rowReady_;
+	};
+}
+
+QImage FloodFill::fill(const QImage& image, const QPoint& seed, const QColor& color, int tolerance, QPoint* offset)
+{
+	if (!image.rect().contains(seed))
+		return QImage();
+
+	const QImage source = image.format() == QImage::Format_ARGB32 || image.format() == QImage::Format_RGB32
+							  ? image
+							  : image.convertToFormat(QImage::Format_ARGB32);
+	const int width = source.width();
+	const int height = source.height();
+	Filler filler(source, source.pixel(seed), qBound(0, tolerance, 255));
+
+	struct Seed
+	{
+		int x;
+		int y;
+	};
+	QList<Seed> stack;
+	stack.append({seed.x(), seed.y()});
+	int minX = seed.x();
+	int maxX = seed.x();
+	int minY = seed.y();
+	int maxY = seed.y();
+
+	while (!stack.isEmpty())
+	{
+		const Seed current = stack.takeLast();
+		uchar* row = filler.row(current.y);
+		if (row[current.x] != Matching)
+			continue;
+
+		int left = current.x;
+		int right = current.x;
+		while (left > 0 && row[left - 1] == Matching)
+			--left;
+		while (right < width - 1 && row[right + 1] == Matching)
+			++right;
+		std::memset(row + left, Filled, size_t(right - left + 1));
+
+		minX = qMin(minX, left);
+		maxX = qMax(maxX, right);
+		minY = qMin(minY, current.y);
+		maxY = qMax(maxY, current.y);
+
+		// По одному семени на каждый подходящий отрезок соседних строк
+		for (int y : {current.y - 1, current.y + 1})
+		{
+			if (y < 0 || y >= height)
+				continue;
+			const uchar* next = filler.row(y);
+			int x = left;
+			while (x <= right)
+			{
+				while (x <= right && next[x] != Matching)
+					++x;
+				if (x > right)
+					break;
+				stack.append({x, y});
+				while (x <= right && next[x] == Matching)
+					++x;
+			}
+		}
+	}
+
+	const QRect bounds(QPoint(minX, minY), QPoint(maxX, maxY));
+	QImage result(bounds.size(), QImage::Format_ARGB32_Premultiplied);
+	const QRgb fillColor = qPremultiply(color.rgba());
+	for (int y = 0; y < bounds.height(); ++y)
+	{
+		const uchar* mask = filler.filledRow(bounds.top() + y) + bounds.left();
+		QRgb* out = reinterpret_cast<QRgb*>(result.scanLine(y));
+		for (int x = 0; x < bounds.width(); ++x)
+			out[x] = mask[x] == Filled ? fillColor : 0;
+	}
+
+	if (offset)
+		*offset = bounds.topLeft();
+	return result;
+}
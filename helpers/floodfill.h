@@ -0,0 +1,21 @@
+#ifndef FLOODFILL_H
+#define FLOODFILL_H
+
+#include <QColor>
+#include <QImage>
+#include <QPoint>
+
+// Заливка связной области картинки построчно, отрезками: отрезок расширяется
+// влево и вправо до границы, а строки выше и ниже дают по одному семени на
+// каждый подходящий отрезок. Сравнение с цветом считается сразу для всей
+// строки простым циклом без ветвлений - компилятор его векторизует.
+class FloodFill
+{
+  public:
+	// Пиксель подходит, если каждый его канал отличается от цвета под seed не больше чем на tolerance (0..255).
+	// Возвращает залитую область цветом color на прозрачном фоне, обрезанную по её границам;
+	// offset - положение результата в image
+	static QImage fill(const QImage& image, const QPoint& seed, const QColor& color, int tolerance, QPoint* offset = nullptr);
+};
+
+#endif // FLOODFILL_H
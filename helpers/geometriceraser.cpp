@@ -0,0 +1,351 @@
+#include "geometriceraser.h"
+#include "sceneindex.h"
+#include "../items/strokeitem.h"
+
+#include <QGraphicsLineItem>
+#include <QGraphicsPathItem>
+#include <QPen>
+#include <QtMath>
+
+#include <algorithm>
+
+namespace
+{
+	struct Interval
+	{
+		qreal from;
+		qreal to;
+	};
+
+	// Участок отрезка a->b (в долях длины), попадающий внутрь окружности
+	bool segmentCircleInterval(const QPointF& a, const QPointF& b, const QPointF& center, qreal radius, Interval& out)
+	{
+		const QPointF d = b - a;
+		const QPointF f = a - center;
+		const qreal qa = QPointF::dotProduct(d, d);
+		const qreal qb = 2 * QPointF::dotProduct(f, d);
+		const qreal qc = QPointF::dotProduct(f, f) - radius * radius;
+
+		if (qa <= 0)
+		{
+			if (qc > 0)
+				return false;
+			out = {0, 1};
+			return true;
+		}
+
+		const qreal discriminant = qb * qb - 4 * qa * qc;
+		if (discriminant <= 0)
+			return false;
+
+		const qreal root = qSqrt(discriminant);
+		const qreal t1 = (-qb - root) / (2 * qa);
+		const qreal t2 = (-qb + root) / (2 * qa);
+		if (t2 <= 0 || t1 >= 1)
+			return false;
+
+		out = {qMax<qreal>(0, t1), qMin<qreal>(1, t2)};
+		return true;
+	}
+
+	qreal uniformScale(const QTransform& transform) { return qSqrt(qAbs(transform.determinant())); }
+
+	QPainterPath footprintPath(const QPolygonF& centers, qreal radius)
+	{
+		QPainterPath path;
+		path.setFillRule(Qt::WindingFill);
+		for (const QPointF& center : centers)
+			path.addEllipse(center, radius, radius);
+		return path;
+	}
+
+	// Толщина в точках куска: точки среза получают толщину ближайшей исходной точки
+	QList<qreal> pieceWidths(const StrokeItem* stroke, const QPolygonF& piece)
+	{
+		QList<qreal> widths;
+		if (!stroke->hasVariableWidth())
+			return widths;
+
+		const QPolygonF& points = stroke->points();
+		widths.reserve(piece.size());
+		for (const QPointF& point : piece)
+		{
+			int nearest = 0;
+			qreal nearestDistance = -1;
+			for (int i = 0; i < points.size(); ++i)
+			{
+				const QPointF d = points[i] - point;
+				const qreal distance = QPointF::dotProduct(d, d);
+				if (nearestDistance < 0 || distance < nearestDistance)
+				{
+					nearest = i;
+					nearestDistance = distance;
+				}
+			}
+			widths.append(stroke->widths()[nearest]);
+		}
+		return widths;
+	}
+
+	bool isGeometricShape(const QGraphicsItem* item)
+	{
+		switch (item->type())
+		{
+		case QGraphicsRectItem::Type:
+		case QGraphicsEllipseItem::Type:
+		case QGraphicsPathItem::Type:
+		case QGraphicsPolygonItem::Type:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	QPainterPath fillPath(const QGraphicsItem* item)
+	{
+		QPainterPath path;
+		if (auto rectItem = qgraphicsitem_cast<const QGraphicsRectItem*>(item))
+			path.addRect(rectItem->rect());
+		else if (auto ellipseItem = qgraphicsitem_cast<const QGraphicsEllipseItem*>(item))
+			path.addEllipse(ellipseItem->rect());
+		else if (auto pathItem = qgraphicsitem_cast<const QGraphicsPathItem*>(item))
+			path = pathItem->path();
+		else if (auto polygonItem = qgraphicsitem_cast<const QGraphicsPolygonItem*>(item))
+			path.addPolygon(polygonItem->polygon());
+		return path;
+	}
+}
+
+QPolygonF GeometricEraser::sampleCircles(const QPolygonF& eraserPath, qreal radius)
+{
+	// Шаг не больше половины радиуса: между соседними кругами не остаётся щелей
+	QPolygonF centers;
+	if (eraserPath.isEmpty())
+		return centers;
+
+	const qreal step = qMax<qreal>(0.5, radius / 2);
+	centers.append(eraserPath.first());
+	for (int i = 1; i < eraserPath.size(); ++i)
+	{
+		const QLineF segment(eraserPath[i - 1], eraserPath[i]);
+		const int steps = qCeil(segment.length() / step);
+		for (int s = 1; s <= steps; ++s)
+			centers.append(segment.pointAt(qreal(s) / steps));
+	}
+	return centers;
+}
+
+QList<QPolygonF> GeometricEraser::clipPolyline(const QPolygonF& polyline, const QPolygonF& centers, qreal radius)
+{
+	QList<QPolygonF> pieces;
+	QPolygonF piece;
+	const qreal epsilon = 1e-6;
+
+	auto flush = [&]()
+	{
+		if (piece.size() >= 2)
+			pieces.append(piece);
+		piece.clear();
+	};
+
+	for (int i = 1; i < polyline.size(); ++i)
+	{
+		const QPointF a = polyline[i - 1];
+		const QPointF b = polyline[i];
+		const QRectF segmentBounds = QRectF(a, b).normalized().adjusted(-radius, -radius, radius, radius);
+
+		QList<Interval> removed;
+		for (const QPointF& center : centers)
+		{
+			Interval interval;
+			if (segmentBounds.contains(center) && segmentCircleInterval(a, b, center, radius, interval))
+				removed.append(interval);
+		}
+		std::sort(removed.begin(), removed.end(), [](const Interval& l, const Interval& r) { return l.from < r.from; });
+
+		// Оставшиеся участки - дополнение объединения вырезанных
+		qreal cursor = 0;
+		QList<Interval> kept;
+		for (const Interval& interval : removed)
+		{
+			if (interval.from > cursor + epsilon)
+				kept.append({cursor, interval.from});
+			cursor = qMax(cursor, interval.to);
+		}
+		if (cursor < 1 - epsilon)
+			kept.append({cursor, 1});
+
+		const QLineF segment(a, b);
+		auto pointAt = [&](qreal t) { return t <= epsilon ? a : (t >= 1 - epsilon ? b : segment.pointAt(t)); };
+		for (const Interval& interval : kept)
+		{
+			const QPointF from = pointAt(interval.from);
+			const QPointF to = pointAt(interval.to);
+			if (interval.from <= epsilon && !piece.isEmpty())
+			{
+				piece.append(to);
+			}
+			else
+			{
+				flush();
+				piece << from << to;
+			}
+			if (interval.to < 1 - epsilon)
+				flush();
+		}
+		if (kept.isEmpty())
+			flush();
+	}
+	flush();
+	return pieces;
+}
+
+void GeometricEraser::copyItemState(const QGraphicsItem* from, QGraphicsItem* to)
+{
+	to->setPos(from->pos());
+	to->setTransformOriginPoint(from->transformOriginPoint());
+	to->setRotation(from->rotation());
+	to->setScale(from->scale());
+	to->setTransform(from->transform());
+	to->setZValue(from->zValue());
+	to->setFlags(from->flags());
+}
+
+GeometricEraser::Result GeometricEraser::erase(QGraphicsScene* scene, const QPolygonF& eraserPath, qreal radius)
+{
+	if (!scene || eraserPath.isEmpty())
+		return {};
+
+	// Один запрос к индексу сцены на всю пачку движений ластика
+	const QRectF bounds = eraserPath.boundingRect().adjusted(-radius, -radius, radius, radius);
+	return erase(scene, SceneIndex::items(scene, bounds, Qt::IntersectsItemBoundingRect), eraserPath, radius);
+}
+
+GeometricEraser::Result GeometricEraser::erase(QGraphicsScene* scene, const QList<QGraphicsItem*>& candidates,
+											   const QPolygonF& eraserPath, qreal radius)
+{
+	Result result;
+	if (!scene || eraserPath.isEmpty())
+		return result;
+
+	const QPolygonF sceneCenters = sampleCircles(eraserPath, radius);
+
+	for (QGraphicsItem* item : candidates)
+	{
+		// Элементы внутри групп режем вместе с группой - не трогаем
+		if (item->parentItem())
+			continue;
+
+		const QTransform toItem = item->sceneTransform().inverted();
+		const qreal scale = qMax<qreal>(1e-6, uniformScale(item->sceneTransform()));
+		const QPolygonF centers = toItem.map(sceneCenters);
+		const qreal itemRadius = radius / scale;
+
+		if (auto stroke = qgraphicsitem_cast<StrokeItem*>(item))
+		{
+			if (stroke->isDrawing())
+				continue;
+
+			QPolygonF polyline = stroke->points();
+			if (stroke->isSmoothed())
+			{
+				const QList<QPolygonF> flattened = stroke->path().toSubpathPolygons();
+				polyline = flattened.isEmpty() ? polyline : flattened.first();
+			}
+
+			const QList<QPolygonF> pieces = clipPolyline(polyline, centers, itemRadius + stroke->pen().widthF() / 2);
+			if (pieces.size() == 1 && pieces.first() == polyline)
+				continue;
+
+			for (const QPolygonF& piece : pieces)
+			{
+				StrokeItem* part = new StrokeItem(stroke->pen(), QPointF());
+				part->setPoints(piece, false, pieceWidths(stroke, piece));
+				copyItemState(stroke, part);
+				result.added.append(part);
+			}
+			result.removed.append(item);
+		}
+		else if (auto lineItem = qgraphicsitem_cast<QGraphicsLineItem*>(item))
+		{
+			QPolygonF polyline;
+			polyline << lineItem->line().p1() << lineItem->line().p2();
+			const QList<QPolygonF> pieces = clipPolyline(polyline, centers, itemRadius + lineItem->pen().widthF() / 2);
+			if (pieces.size() == 1 && pieces.first() == polyline)
+				continue;
+
+			for (const QPolygonF& piece : pieces)
+			{
+				QGraphicsLineItem* part = new QGraphicsLineItem(QLineF(piece.first(), piece.last()));
+				part->setPen(lineItem->pen());
+				copyItemState(lineItem, part);
+				result.added.append(part);
+			}
+			result.removed.append(item);
+		}
+		else if (isGeometricShape(item) && static_cast<QAbstractGraphicsShapeItem*>(item)->brush().style() == Qt::NoBrush)
+		{
+			// Незалитая фигура - только контур (например, ломаная из SVG): режем его как штрих
+			auto shapeItem = static_cast<QAbstractGraphicsShapeItem*>(item);
+			const QList<QPolygonF> outlines = fillPath(item).toSubpathPolygons();
+			QPainterPath remaining;
+			bool isChanged = false;
+			for (const QPolygonF& outline : outlines)
+			{
+				if (outline.size() < 2)
+					continue;
+				const QList<QPolygonF> pieces =
+					clipPolyline(outline, centers, itemRadius + shapeItem->pen().widthF() / 2);
+				isChanged = isChanged || pieces.size() != 1 || pieces.first() != outline;
+				for (const QPolygonF& piece : pieces)
+				{
+					remaining.moveTo(piece.first());
+					for (int i = 1; i < piece.size(); ++i)
+						remaining.lineTo(piece[i]);
+				}
+			}
+			if (!isChanged)
+				continue;
+
+			if (!remaining.isEmpty())
+			{
+				QGraphicsPathItem* part = new QGraphicsPathItem(remaining);
+				part->setPen(shapeItem->pen());
+				copyItemState(item, part);
+				result.added.append(part);
+			}
+			result.removed.append(item);
+		}
+		else if (isGeometricShape(item))
+		{
+			auto shapeItem = static_cast<QAbstractGraphicsShapeItem*>(item);
+			const QPainterPath footprint = footprintPath(centers, itemRadius);
+			const QPainterPath original = fillPath(item);
+			if (!original.intersects(footprint))
+				continue;
+
+			const QPainterPath remaining = original.subtracted(footprint);
+			if (!remaining.isEmpty())
+			{
+				QGraphicsPathItem* part = new QGraphicsPathItem(remaining);
+				part->setPen(shapeItem->pen());
+				part->setBrush(shapeItem->brush());
+				copyItemState(item, part);
+				result.added.append(part);
+			}
+			result.removed.append(item);
+		}
+	}
+
+	for (QGraphicsItem* item : std::as_const(result.removed))
+	{
+		SceneIndex::remove(scene, item);
+		scene->removeItem(item);
+	}
+	for (QGraphicsItem* item : std::as_const(result.added))
+	{
+		scene->addItem(item);
+		SceneIndex::update(scene, item);
+	}
+	return result;
+}
@@ -0,0 +1,31 @@
+#ifndef GEOMETRICERASER_H
+#define GEOMETRICERASER_H
+
+#include <QGraphicsItem>
+#include <QGraphicsScene>
+#include <QList>
+#include <QPolygonF>
+
+// Ластик, который вырезает след из геометрии, а не удаляет элементы целиком.
+// Штрихи и незалитые контуры режутся по линии на части, у залитых фигур вычитается площадь.
+class GeometricEraser
+{
+  public:
+	struct Result
+	{
+		QList<QGraphicsItem*> removed; // уже убраны со сцены, удаляет вызывающий
+		QList<QGraphicsItem*> added;
+	};
+
+	static Result erase(QGraphicsScene* scene, const QPolygonF& eraserPath, qreal radius);
+	static Result erase(QGraphicsScene* scene, const QList<QGraphicsItem*>& candidates,
+						const QPolygonF& eraserPath, qreal radius);
+
+	static QList<QPolygonF> clipPolyline(const QPolygonF& polyline, const QPolygonF& centers, qreal radius);
+
+  private:
+	static QPolygonF sampleCircles(const QPolygonF& eraserPath, qreal radius);
+	static void copyItemState(const QGraphicsItem* from, QGraphicsItem* to);
+};
+
+#endif // GEOMETRICERASER_H
@@ -0,0 +1,373 @@
+#include "imagestreamwriter.h"
+
+#include <QFileInfo>
+#include <QImageWriter>
+#include <QtEndian>
+
+#include <csetjmp>
+#include <cstdio>
+#include <cstring>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef HAVE_JPEG
+extern "C"
+{
+#include <jpeglib.h>
+}
+#endif
+
+namespace
+{
+#ifdef HAVE_ZLIB
+	class PngStreamWriter : public ImageStreamWriter
+	{
+	  public:
+		~PngStreamWriter() override
+		{
+			if (streamOpen_)
+				deflateEnd(&stream_);
+		}
+
+		bool hasAlpha() const override { return true; }
+
+		bool begin(QIODevice* device, const QSize& size, qreal dpi) override
+		{
+			device_ = device;
+			width_ = size.width();
+			if (device_->write("\x89PNG\r\n\x1a\n", 8) != 8)
+				return fail();
+
+			QByteArray header(13, 0);
+			qToBigEndian<quint32>(size.width(), header.data());
+			qToBigEndian<quint32>(size.height(), header.data() + 4);
+			header[8] = 8;  // бит на канал
+			header[9] = 6;  // RGBA
+			if (!writeChunk("IHDR", header))
+				return false;
+
+			// Разрешение в точках на метр - чтобы печать шла в выбранном DPI
+			QByteArray physical(9, 0);
+			const quint32 pixelsPerMeter = quint32(dpi / 0.0254 + 0.5);
+			qToBigEndian<quint32>(pixelsPerMeter, physical.data());
+			qToBigEndian<quint32>(pixelsPerMeter, physical.data() + 4);
+			physical[8] = 1;
+			if (!writeChunk("pHYs", physical))
+				return false;
+
+			stream_ = {};
+			if (deflateInit(&stream_, CompressionLevel) != Z_OK)
+			{
+				errorString_ = QStringLiteral("Could not initialize the PNG compressor");
+				return false;
+			}
+			streamOpen_ = true;
+			row_.resize(1 + width_ * 4);
+			output_.resize(64 * 1024);
+			return true;
+		}
+
+		bool writeRows(const QImage& rows) override
+		{
+			const QImage rgba = rows.convertToFormat(QImage::Format_RGBA8888);
+			uchar* filtered = reinterpret_cast<uchar*>(row_.data());
+			const int bytes = width_ * 4;
+			for (int y = 0; y < rgba.height(); ++y)
+			{
+				// Фильтр Sub: разность с соседним пикселем заметно лучше сжимается
+				const uchar* raw = rgba.constScanLine(y);
+				filtered[0] = 1;
+				for (int i = 0; i < 4 && i < bytes; ++i)
+					filtered[1 + i] = raw[i];
+				for (int i = 4; i < bytes; ++i)
+					filtered[1 + i] = uchar(raw[i] - raw[i - 4]);
+
+				if (!deflateData(filtered, row_.size(), Z_NO_FLUSH))
+					return false;
+			}
+			return true;
+		}
+
+		bool finish() override
+		{
+			if (!deflateData(nullptr, 0, Z_FINISH))
+				return false;
+			deflateEnd(&stream_);
+			streamOpen_ = false;
+			return writeChunk("IEND", QByteArray());
+		}
+
+	  private:
+		static constexpr int CompressionLevel = 4;
+
+		QIODevice* device_ = nullptr;
+		int width_ = 0;
+		z_stream stream_ = {};
+		bool streamOpen_ = false;
+		QByteArray row_;
+		QByteArray output_;
+
+		bool fail()
+		{
+			errorString_ = device_->errorString();
+			return false;
+		}
+
+		bool writeChunk(const char* type, const QByteArray& data)
+		{
+			uchar length[4];
+			qToBigEndian<quint32>(data.size(), length);
+			uLong crc = crc32(0, reinterpret_cast<const Bytef*>(type), 4);
+			crc = crc32(crc, reinterpret_cast<const Bytef*>(data.constData()), uInt(data.size()));
+			uchar crcBytes[4];
+			qToBigEndian<quint32>(quint32(crc), crcBytes);
+
+			if (device_->write(reinterpret_cast<const char*>(length), 4) != 4 || device_->write(type, 4) != 4
+				|| device_->write(data) != data.size() || device_->write(reinterpret_cast<const char*>(crcBytes), 4) != 4)
+				return fail();
+			return true;
+		}
+
+		bool deflateData(const uchar* data, qsizetype size, int flush)
+		{
+			stream_.next_in = const_cast<Bytef*>(data);
+			stream_.avail_in = uInt(size);
+			while (true)
+			{
+				stream_.next_out = reinterpret_cast<Bytef*>(output_.data());
+				stream_.avail_out = uInt(output_.size());
+				const int result = deflate(&stream_, flush);
+				if (result == Z_STREAM_ERROR)
+				{
+					errorString_ = QStringLiteral("PNG compression failed");
+					return false;
+				}
+
+				const qsizetype produced = output_.size() - stream_.avail_out;
+				if (produced > 0 && !writeChunk("IDAT", QByteArray::fromRawData(output_.constData(), produced)))
+					return false;
+
+				if (flush == Z_FINISH ? result == Z_STREAM_END : stream_.avail_out != 0)
+					return true;
+			}
+		}
+	};
+
+#endif
+
+#ifdef HAVE_JPEG
+	// libjpeg сообщает об ошибках через error_exit - возвращаемся по longjmp
+	struct JpegError
+	{
+		jpeg_error_mgr manager;
+		std::jmp_buf jump;
+		char message[JMSG_LENGTH_MAX];
+	};
+
+	void jpegErrorExit(j_common_ptr info)
+	{
+		JpegError* error = reinterpret_cast<JpegError*>(info->err);
+		(*info->err->format_message)(info, error->message);
+		std::longjmp(error->jump, 1);
+	}
+
+	struct JpegDestination
+	{
+		jpeg_destination_mgr manager;
+		QIODevice* device;
+		JOCTET buffer[64 * 1024];
+		bool failed;
+	};
+
+	void jpegInitDestination(j_compress_ptr info)
+	{
+		JpegDestination* destination = reinterpret_cast<JpegDestination*>(info->dest);
+		destination->manager.next_output_byte = destination->buffer;
+		destination->manager.free_in_buffer = sizeof(destination->buffer);
+	}
+
+	boolean jpegEmptyBuffer(j_compress_ptr info)
+	{
+		JpegDestination* destination = reinterpret_cast<JpegDestination*>(info->dest);
+		if (destination->device->write(reinterpret_cast<const char*>(destination->buffer), sizeof(destination->buffer))
+			!= qint64(sizeof(destination->buffer)))
+			destination->failed = true;
+		jpegInitDestination(info);
+		return TRUE;
+	}
+
+	void jpegTermDestination(j_compress_ptr info)
+	{
+		JpegDestination* destination = reinterpret_cast<JpegDestination*>(info->dest);
+		const qint64 size = sizeof(destination->buffer) - destination->manager.free_in_buffer;
+		if (size > 0 && destination->device->write(reinterpret_cast<const char*>(destination->buffer), size) != size)
+			destination->failed = true;
+	}
+
+	class JpegStreamWriter : public ImageStreamWriter
+	{
+	  public:
+		JpegStreamWriter()
+		{
+			info_.err = jpeg_std_error(&error_.manager);
+			error_.manager.error_exit = jpegErrorExit;
+			jpeg_create_compress(&info_);
+		}
+
+		~JpegStreamWriter() override { jpeg_destroy_compress(&info_); }
+
+		bool hasAlpha() const override { return false; }
+
+		bool begin(QIODevice* device, const QSize& size, qreal dpi) override
+		{
+			// Ограничение самого формата JPEG
+			if (size.width() > JPEG_MAX_DIMENSION || size.height() > JPEG_MAX_DIMENSION)
+			{
+				errorString_ = QStringLiteral("JPEG images cannot be larger than %1 pixels per side").arg(JPEG_MAX_DIMENSION);
+				return false;
+			}
+
+			destination_.manager.init_destination = jpegInitDestination;
+			destination_.manager.empty_output_buffer = jpegEmptyBuffer;
+			destination_.manager.term_destination = jpegTermDestination;
+			destination_.device = device;
+			destination_.failed = false;
+			info_.dest = &destination_.manager;
+
+			if (setjmp(error_.jump))
+				return failed();
+
+			info_.image_width = JDIMENSION(size.width());
+			info_.image_height = JDIMENSION(size.height());
+			info_.input_components = 3;
+			info_.in_color_space = JCS_RGB;
+			jpeg_set_defaults(&info_);
+			jpeg_set_quality(&info_, Quality, TRUE);
+			info_.density_unit = 1;
+			info_.X_density = UINT16(qBound(1, qRound(dpi), 65535));
+			info_.Y_density = info_.X_density;
+			jpeg_start_compress(&info_, TRUE);
+			return true;
+		}
+
+		bool writeRows(const QImage& rows) override
+		{
+			const QImage rgb = rows.convertToFormat(QImage::Format_RGB888);
+			return writeScanlines(rgb.constBits(), rgb.height(), rgb.bytesPerLine());
+		}
+
+		bool finish() override
+		{
+			if (setjmp(error_.jump))
+				return failed();
+			jpeg_finish_compress(&info_);
+			if (destination_.failed)
+				return failed();
+			return true;
+		}
+
+	  private:
+		static constexpr int Quality = 90;
+
+		jpeg_compress_struct info_;
+		JpegError error_;
+		JpegDestination destination_;
+
+		bool failed()
+		{
+			errorString_ = destination_.failed ? destination_.device->errorString() : QString::fromLocal8Bit(error_.message);
+			return false;
+		}
+
+		// Без объектов с деструкторами: сюда может вернуться longjmp
+		bool writeScanlines(const uchar* bits, int count, qsizetype bytesPerLine)
+		{
+			if (setjmp(error_.jump))
+				return failed();
+			for (int y = 0; y < count; ++y)
+			{
+				JSAMPROW row = const_cast<JSAMPROW>(bits + y * bytesPerLine);
+				jpeg_write_scanlines(&info_, &row, 1);
+			}
+			return !destination_.failed || failed();
+		}
+	};
+#endif
+
+#if !defined(HAVE_ZLIB) || !defined(HAVE_JPEG)
+	// Сборка без zlib или libjpeg: полосы собираются в целое изображение, его пишет QImageWriter
+	class BufferedImageWriter : public ImageStreamWriter
+	{
+	  public:
+		explicit BufferedImageWriter(const QByteArray& format) : format_(format) {}
+
+		bool hasAlpha() const override { return format_ == "png"; }
+
+		bool begin(QIODevice* device, const QSize& size, qreal dpi) override
+		{
+			device_ = device;
+			image_ = QImage(size, QImage::Format_ARGB32_Premultiplied);
+			if (image_.isNull())
+			{
+				errorString_ = QStringLiteral("Not enough memory for a %1x%2 image").arg(size.width()).arg(size.height());
+				return false;
+			}
+			image_.setDotsPerMeterX(qRound(dpi / 0.0254));
+			image_.setDotsPerMeterY(qRound(dpi / 0.0254));
+			nextRow_ = 0;
+			return true;
+		}
+
+		bool writeRows(const QImage& rows) override
+		{
+			const QImage converted = rows.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+			const qsizetype bytes = qMin(converted.bytesPerLine(), image_.bytesPerLine());
+			for (int y = 0; y < converted.height() && nextRow_ < image_.height(); ++y)
+				std::memcpy(image_.scanLine(nextRow_++), converted.constScanLine(y), bytes);
+			return true;
+		}
+
+		bool finish() override
+		{
+			QImageWriter writer(device_, format_);
+			writer.setQuality(Quality);
+			const QImage output = hasAlpha() ? image_ : image_.convertToFormat(QImage::Format_RGB32);
+			image_ = QImage();
+			if (!writer.write(output))
+			{
+				errorString_ = writer.errorString();
+				return false;
+			}
+			return true;
+		}
+
+	  private:
+		static constexpr int Quality = 90;
+
+		QByteArray format_;
+		QIODevice* device_ = nullptr;
+		QImage image_;
+		int nextRow_ = 0;
+	};
+#endif
+}
+
+std::unique_ptr<ImageStreamWriter> ImageStreamWriter::create(const QString& filePath)
+{
+	const QString suffix = QFileInfo(filePath).suffix().toLower();
+	if (suffix == "png")
+#ifdef HAVE_ZLIB
+		return std::make_unique<PngStreamWriter>();
+#else
+		return std::make_unique<BufferedImageWriter>("png");
+#endif
+	if (suffix == "jpg" || suffix == "jpeg")
+#ifdef HAVE_JPEG
+		return std::make_unique<JpegStreamWriter>();
+#else
+		return std::make_unique<BufferedImageWriter>("jpeg");
+#endif
+	return nullptr;
+}
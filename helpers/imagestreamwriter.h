@@ -0,0 +1,33 @@
+#ifndef IMAGESTREAMWRITER_H
+#define IMAGESTREAMWRITER_H
+
+#include <QImage>
+#include <QIODevice>
+#include <QString>
+
+#include <memory>
+
+// Кодировщик, принимающий картинку полосами сверху вниз: целиком изображение
+// в памяти не держится. Поддерживаются PNG (zlib) и JPEG (libjpeg); сборка без
+// этих библиотек пишет формат через QImageWriter, собирая изображение целиком.
+class ImageStreamWriter
+{
+  public:
+	virtual ~ImageStreamWriter() = default;
+
+	// nullptr, если формат по расширению файла не поддерживается
+	static std::unique_ptr<ImageStreamWriter> create(const QString& filePath);
+
+	virtual bool begin(QIODevice* device, const QSize& size, qreal dpi) = 0;
+	// Полоса шириной во всё изображение, формат ARGB32_Premultiplied
+	virtual bool writeRows(const QImage& rows) = 0;
+	virtual bool finish() = 0;
+
+	virtual bool hasAlpha() const = 0;
+	QString errorString() const { return errorString_; }
+
+  protected:
+	QString errorString_;
+};
+
+#endif // IMAGESTREAMWRITER_H
@@ -0,0 +1,116 @@
+#include "keyframetimeline.h"
+#include "sceneindex.h"
+#include "sceneserializer.h"
+
+#include <QGraphicsItem>
+
+#include <algorithm>
+
+KeyframeState KeyframeState::of(const QGraphicsItem* item)
+{
+	KeyframeState state;
+	state.pos = item->pos();
+	state.rotation = item->rotation();
+	state.scale = item->scale();
+	state.opacity = item->opacity();
+	return state;
+}
+
+void KeyframeState::applyTo(QGraphicsItem* item) const
+{
+	if (item->pos() != pos)
+		item->setPos(pos);
+	if (item->rotation() != rotation)
+		item->setRotation(rotation);
+	if (item->scale() != scale)
+		item->setScale(scale);
+	if (item->opacity() != opacity)
+		item->setOpacity(opacity);
+}
+
+void KeyframeTimeline::setKeyframe(quint64 itemId, const Keyframe& keyframe)
+{
+	QList<Keyframe>& track = tracks_[itemId];
+	auto it = std::lower_bound(track.begin(), track.end(), keyframe.time,
+							   [](const Keyframe& k, qreal time) { return k.time < time; });
+	if (it != track.end() && qFuzzyCompare(it->time + 1, keyframe.time + 1))
+		*it = keyframe;
+	else
+		track.insert(it, keyframe);
+}
+
+qreal KeyframeTimeline::duration() const
+{
+	qreal duration = 0;
+	for (const QList<Keyframe>& track : tracks_)
+		if (!track.isEmpty())
+			duration = qMax(duration, track.last().time);
+	return duration;
+}
+
+bool KeyframeTimeline::stateAt(quint64 itemId, qreal time, KeyframeState* state) const
+{
+	auto trackIt = tracks_.constFind(itemId);
+	if (trackIt == tracks_.constEnd() || trackIt->isEmpty())
+		return false;
+
+	const QList<Keyframe>& track = *trackIt;
+	if (time <= track.first().time)
+	{
+		*state = track.first().state;
+		return true;
+	}
+	if (time >= track.last().time)
+	{
+		*state = track.last().state;
+		return true;
+	}
+
+	auto next = std::upper_bound(track.begin(), track.end(), time,
+								 [](qreal t, const Keyframe& k) { return t < k.time; });
+	const Keyframe& to = *next;
+	const Keyframe& from = *(next - 1);
+
+	const qreal progress = QEasingCurve(to.easing).valueForProgress((time - from.time) / (to.time - from.time));
+	auto lerp = [progress](qreal a, qreal b) { return a + (b - a) * progress; };
+	state->pos = from.state.pos + (to.state.pos - from.state.pos) * progress;
+	state->rotation = lerp(from.state.rotation, to.state.rotation);
+	state->scale = lerp(from.state.scale, to.state.scale);
+	state->opacity = lerp(from.state.opacity, to.state.opacity);
+	return true;
+}
+
+void KeyframeTimeline::apply(QGraphicsScene* scene, qreal time) const
+{
+	if (tracks_.isEmpty())
+		return;
+
+	// На сцене редактора элементы ищутся по индексу id - обходятся только дорожки
+	if (SceneIndex::of(scene))
+	{
+		for (auto it = tracks_.constBegin(); it != tracks_.constEnd(); ++it)
+		{
+			QGraphicsItem* item = SceneIndex::findById(scene, it.key());
+			KeyframeState state;
+			if (item && stateAt(it.key(), time, &state))
+			{
+				state.applyTo(item);
+				SceneIndex::update(scene, item);
+			}
+		}
+		return;
+	}
+
+	// У копий сцены для экспорта индекса нет
+	const QList<QGraphicsItem*> items = scene->items();
+	for (QGraphicsItem* item : items)
+	{
+		const QVariant id = item->data(SceneSerializer::ItemIdKey);
+		KeyframeState state;
+		if (id.isValid() && stateAt(id.toULongLong(), time, &state))
+		{
+			state.applyTo(item);
+			SceneIndex::update(scene, item);
+		}
+	}
+}
@@ -0,0 +1,49 @@
+#ifndef KEYFRAMETIMELINE_H
+#define KEYFRAMETIMELINE_H
+
+#include <QEasingCurve>
+#include <QGraphicsScene>
+#include <QHash>
+#include <QList>
+#include <QPointF>
+
+struct KeyframeState
+{
+	QPointF pos;
+	qreal rotation = 0;
+	qreal scale = 1;
+	qreal opacity = 1;
+
+	static KeyframeState of(const QGraphicsItem* item);
+	void applyTo(QGraphicsItem* item) const;
+};
+
+struct Keyframe
+{
+	qreal time = 0; // секунды от начала
+	KeyframeState state;
+	QEasingCurve::Type easing = QEasingCurve::Linear; // кривая участка, который заканчивается этим ключом
+};
+
+// Ключевые кадры по элементам сцены. Элементы задаются постоянным id
+// (SceneSerializer::ItemIdKey), поэтому одна шкала подходит и к копиям сцены.
+// Состояние - чистая функция времени: кадр зависит только от t, а не от числа тиков.
+class KeyframeTimeline
+{
+  public:
+	void setKeyframe(quint64 itemId, const Keyframe& keyframe);
+	void removeItem(quint64 itemId) { tracks_.remove(itemId); }
+	void clear() { tracks_.clear(); }
+
+	bool isEmpty() const { return tracks_.isEmpty(); }
+	int itemCount() const { return tracks_.size(); }
+	qreal duration() const;
+
+	bool stateAt(quint64 itemId, qreal time, KeyframeState* state) const;
+	void apply(QGraphicsScene* scene, qreal time) const;
+
+  private:
+	QHash<quint64, QList<Keyframe>> tracks_; // по возрастанию времени
+};
+
+#endif // KEYFRAMETIMELINE_H
@@ -0,0 +1,302 @@
+#include "motionengine.h"
+
+#include <QtMath>
+
+#include <algorithm>
+
+namespace
+{
+	quint64 cellKey(int cx, int cy) { return (quint64(quint32(cx)) << 32) | quint32(cy); }
+	int cellX(quint64 key) { return qint32(key >> 32); }
+	int cellY(quint64 key) { return qint32(key & 0xffffffff); }
+
+	double dot(const QPointF& a, const QPointF& b) { return a.x() * b.x() + a.y() * b.y(); }
+
+	// Нормаль направлена от a к b; depth - глубина проникновения
+	bool boxBox(const QRectF& a, const QRectF& b, QPointF& normal, double& depth)
+	{
+		const double overlapX = qMin(a.right(), b.right()) - qMax(a.left(), b.left());
+		const double overlapY = qMin(a.bottom(), b.bottom()) - qMax(a.top(), b.top());
+		if (overlapX <= 0 || overlapY <= 0)
+			return false;
+
+		if (overlapX < overlapY)
+		{
+			normal = QPointF(b.center().x() >= a.center().x() ? 1 : -1, 0);
+			depth = overlapX;
+		}
+		else
+		{
+			normal = QPointF(0, b.center().y() >= a.center().y() ? 1 : -1);
+			depth = overlapY;
+		}
+		return true;
+	}
+
+	bool circleCircle(const QRectF& a, const QRectF& b, QPointF& normal, double& depth)
+	{
+		const double ra = qMin(a.width(), a.height()) / 2;
+		const double rb = qMin(b.width(), b.height()) / 2;
+		const QPointF d = b.center() - a.center();
+		const double distance = qSqrt(dot(d, d));
+		if (distance >= ra + rb)
+			return false;
+
+		normal = distance > 0 ? d / distance : QPointF(1, 0);
+		depth = ra + rb - distance;
+		return true;
+	}
+
+	bool circleBox(const QRectF& circle, const QRectF& box, QPointF& normal, double& depth)
+	{
+		const double radius = qMin(circle.width(), circle.height()) / 2;
+		const QPointF center = circle.center();
+		const QPointF closest(qBound(box.left(), center.x(), box.right()), qBound(box.top(), center.y(), box.bottom()));
+		const QPointF d = closest - center;
+		const double distance = qSqrt(dot(d, d));
+		if (distance >= radius)
+			return false;
+		// Центр внутри прямоугольника - считаем как два прямоугольника
+		if (distance == 0)
+			return boxBox(circle, box, normal, depth);
+
+		normal = d / distance;
+		depth = radius - distance;
+		return true;
+	}
+}
+
+int MotionEngine::addBody(const MotionBody& body)
+{
+	bodies_.append(body);
+	indexById_.insert(body.id, bodies_.size() - 1);
+	isCellSizeDirty_ = true;
+	return bodies_.size() - 1;
+}
+
+void MotionEngine::removeBody(int index)
+{
+	if (index < 0 || index >= bodies_.size())
+		return;
+	indexById_.remove(bodies_[index].id);
+	if (index != bodies_.size() - 1)
+	{
+		bodies_[index] = bodies_.last();
+		indexById_.insert(bodies_[index].id, index);
+	}
+	bodies_.removeLast();
+	isCellSizeDirty_ = true;
+}
+
+int MotionEngine::indexOf(quint32 id) const { return indexById_.value(id, -1); }
+
+void MotionEngine::clear()
+{
+	bodies_.clear();
+	indexById_.clear();
+	isCellSizeDirty_ = true;
+	accumulator_ = 0;
+}
+
+int MotionEngine::movingCount() const
+{
+	int count = 0;
+	for (const MotionBody& body : bodies_)
+		if (!body.isStatic)
+			++count;
+	return count;
+}
+
+void MotionEngine::updateCellSize()
+{
+	// Ячейка примерно в два средних подвижных тела: мало пар на ячейку и мало ячеек на тело
+	double total = 0;
+	int count = 0;
+	for (const MotionBody& body : std::as_const(bodies_))
+	{
+		if (body.isStatic)
+			continue;
+		total += qMax(body.bounds.width(), body.bounds.height());
+		++count;
+	}
+	cellSize_ = count > 0 ? qMax(16.0, 2 * total / count) : 64;
+}
+
+int MotionEngine::advance(double seconds)
+{
+	accumulator_ += seconds;
+	int collisions = 0;
+	int steps = 0;
+	while (accumulator_ >= TimeStep && steps < MaxStepsPerAdvance)
+	{
+		collisions += step(TimeStep);
+		accumulator_ -= TimeStep;
+		++steps;
+	}
+	// Не догоняем бесконечно после долгой паузы
+	if (steps == MaxStepsPerAdvance)
+		accumulator_ = 0;
+	return collisions;
+}
+
+int MotionEngine::step(double dt)
+{
+	int collisions = 0;
+
+	// Размер ячейки пересчитывается раз за шаг, а не на каждое добавленное тело
+	if (isCellSizeDirty_)
+	{
+		updateCellSize();
+		isCellSizeDirty_ = false;
+	}
+
+	for (MotionBody& body : bodies_)
+	{
+		if (body.isStatic)
+			continue;
+
+		body.bounds.translate(body.velocity * dt);
+		if (!worldBounds_.isNull())
+			collisions += collideWithWorld(body);
+
+		if (body.lifetime >= 0)
+		{
+			body.lifetime -= dt;
+			if (body.lifetime <= 0)
+			{
+				body.isStatic = true;
+				body.velocity = QPointF();
+				body.lifetime = 0;
+				isCellSizeDirty_ = true;
+			}
+		}
+	}
+
+	// Широкая фаза: тела раскладываются по ячейкам, пары ищутся внутри ячейки
+	entries_.clear();
+	cellMinX_.assign(bodies_.size(), 0);
+	cellMinY_.assign(bodies_.size(), 0);
+	for (int i = 0; i < bodies_.size(); ++i)
+	{
+		const MotionBody& body = bodies_[i];
+		if (body.isStatic && !body.isSolid)
+			continue;
+
+		const int left = qFloor(body.bounds.left() / cellSize_);
+		const int right = qFloor(body.bounds.right() / cellSize_);
+		const int top = qFloor(body.bounds.top() / cellSize_);
+		const int bottom = qFloor(body.bounds.bottom() / cellSize_);
+		cellMinX_[i] = left;
+		cellMinY_[i] = top;
+		for (int cx = left; cx <= right; ++cx)
+			for (int cy = top; cy <= bottom; ++cy)
+				entries_.push_back({cellKey(cx, cy), i});
+	}
+	std::sort(entries_.begin(), entries_.end(),
+			  [](const CellEntry& l, const CellEntry& r) { return l.key < r.key; });
+
+	for (size_t first = 0; first < entries_.size();)
+	{
+		size_t last = first + 1;
+		while (last < entries_.size() && entries_[last].key == entries_[first].key)
+			++last;
+
+		const int cx = cellX(entries_[first].key);
+		const int cy = cellY(entries_[first].key);
+		for (size_t i = first; i < last; ++i)
+		{
+			for (size_t j = i + 1; j < last; ++j)
+			{
+				const int a = entries_[i].body;
+				const int b = entries_[j].body;
+				if (bodies_[a].isStatic && bodies_[b].isStatic)
+					continue;
+				// Пару проверяем только в одной общей ячейке - левой верхней из пересечения
+				if (cx != qMax(cellMinX_[a], cellMinX_[b]) || cy != qMax(cellMinY_[a], cellMinY_[b]))
+					continue;
+				if (collide(bodies_[a], bodies_[b]))
+					++collisions;
+			}
+		}
+		first = last;
+	}
+	return collisions;
+}
+
+int MotionEngine::collideWithWorld(MotionBody& body)
+{
+	int collisions = 0;
+	if (body.bounds.left() < worldBounds_.left() && body.velocity.x() < 0)
+	{
+		body.bounds.moveLeft(worldBounds_.left());
+		body.velocity.setX(-body.velocity.x());
+		++collisions;
+	}
+	else if (body.bounds.right() > worldBounds_.right() && body.velocity.x() > 0)
+	{
+		body.bounds.moveRight(worldBounds_.right());
+		body.velocity.setX(-body.velocity.x());
+		++collisions;
+	}
+
+	if (body.bounds.top() < worldBounds_.top() && body.velocity.y() < 0)
+	{
+		body.bounds.moveTop(worldBounds_.top());
+		body.velocity.setY(-body.velocity.y());
+		++collisions;
+	}
+	else if (body.bounds.bottom() > worldBounds_.bottom() && body.velocity.y() > 0)
+	{
+		body.bounds.moveBottom(worldBounds_.bottom());
+		body.velocity.setY(-body.velocity.y());
+		++collisions;
+	}
+	return collisions;
+}
+
+bool MotionEngine::collide(MotionBody& a, MotionBody& b)
+{
+	QPointF normal;
+	double depth = 0;
+	bool hit = false;
+	if (a.isCircle && b.isCircle)
+		hit = circleCircle(a.bounds, b.bounds, normal, depth);
+	else if (a.isCircle)
+		hit = circleBox(a.bounds, b.bounds, normal, depth);
+	else if (b.isCircle)
+	{
+		hit = circleBox(b.bounds, a.bounds, normal, depth);
+		normal = -normal;
+	}
+	else
+		hit = boxBox(a.bounds, b.bounds, normal, depth);
+
+	if (!hit)
+		return false;
+
+	// Расталкиваем тела и отражаем скорости вдоль нормали (массы равные, удар упругий)
+	if (a.isStatic)
+		b.bounds.translate(normal * depth);
+	else if (b.isStatic)
+		a.bounds.translate(-normal * depth);
+	else
+	{
+		a.bounds.translate(-normal * depth / 2);
+		b.bounds.translate(normal * depth / 2);
+	}
+
+	const double approach = dot(b.velocity - a.velocity, normal);
+	if (approach >= 0)
+		return false;
+
+	if (a.isStatic)
+		b.velocity -= 2 * dot(b.velocity, normal) * normal;
+	else if (b.isStatic)
+		a.velocity -= 2 * dot(a.velocity, normal) * normal;
+	else
+	{
+		a.velocity += approach * normal;
+		b.velocity -= approach * normal;
+	}
+	return true;
+}
@@ -0,0 +1,71 @@
+#ifndef MOTIONENGINE_H
+#define MOTIONENGINE_H
+
+#include <QHash>
+#include <QPointF>
+#include <QRectF>
+#include <QVector>
+
+#include <vector>
+
+struct MotionBody
+{
+	quint32 id = 0;
+	QRectF bounds;         // AABB в координатах сцены
+	QPointF velocity;      // пикселей в секунду
+	double lifetime = -1;  // секунд до остановки, < 0 - без ограничения, 0 - уже остановилось
+	bool isCircle = false;
+	bool isStatic = false;
+	bool isSolid = true;   // неподвижное тело служит препятствием
+};
+
+// Движение с фиксированным шагом. Кандидаты на столкновение ищутся по
+// равномерной сетке, точная проверка - AABB и окружности.
+class MotionEngine
+{
+  public:
+	static constexpr double TimeStep = 1.0 / 60.0;
+	static constexpr int MaxStepsPerAdvance = 5;
+
+	void setWorldBounds(const QRectF& bounds) { worldBounds_ = bounds; }
+	QRectF worldBounds() const { return worldBounds_; }
+
+	int addBody(const MotionBody& body);
+	// Последнее тело переезжает на место удалённого - вызывающий должен повторить это у себя
+	void removeBody(int index);
+	int indexOf(quint32 id) const;
+	void clear();
+
+	int bodyCount() const { return bodies_.size(); }
+	int movingCount() const;
+	MotionBody& body(int index) { return bodies_[index]; }
+	const QVector<MotionBody>& bodies() const { return bodies_; }
+
+	// Возвращает число столкновений за прошедшее время
+	int advance(double seconds);
+	int step(double dt);
+
+  private:
+	struct CellEntry
+	{
+		quint64 key;
+		int body;
+	};
+
+	QVector<MotionBody> bodies_;
+	QHash<quint32, int> indexById_;
+	QRectF worldBounds_;
+	double accumulator_ = 0;
+	double cellSize_ = 64;
+	bool isCellSizeDirty_ = false;
+
+	std::vector<CellEntry> entries_;
+	std::vector<int> cellMinX_;
+	std::vector<int> cellMinY_;
+
+	void updateCellSize();
+	int collideWithWorld(MotionBody& body);
+	bool collide(MotionBody& a, MotionBody& b);
+};
+
+#endif // MOTIONENGINE_H
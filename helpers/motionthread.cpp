@@ -0,0 +1,173 @@
+#include "motionthread.h"
+#include "trace.h"
+
+#include <QElapsedTimer>
+#include <QMutexLocker>
+
+MotionThread::MotionThread(QObject* parent) : QThread(parent) { setObjectName(QStringLiteral("motion")); }
+
+MotionThread::~MotionThread()
+{
+	stopSimulation();
+}
+
+void MotionThread::reset()
+{
+	// Только при остановленном потоке - движок ему больше не принадлежит
+	stopSimulation();
+	QMutexLocker commandLock(&commandMutex_);
+	QMutexLocker frameLock(&frameMutex_);
+	commands_.clear();
+	lastCommand_ = 0;
+	appliedCommand_ = 0;
+	engine_.clear();
+	frames_[0] = Frame();
+	frames_[1] = Frame();
+	frontFrame_ = 0;
+	takenSequence_ = 0;
+	collisions_ = 0;
+}
+
+void MotionThread::setWorldBounds(const QRectF& bounds)
+{
+	MotionBody body;
+	body.bounds = bounds;
+	pushCommand({CommandType::SetWorldBounds, body});
+}
+
+void MotionThread::addBody(const MotionBody& body)
+{
+	pushCommand({CommandType::AddBody, body});
+}
+
+void MotionThread::removeBody(quint32 id)
+{
+	MotionBody body;
+	body.id = id;
+	pushCommand({CommandType::RemoveBody, body});
+}
+
+void MotionThread::setBodyBounds(quint32 id, const QRectF& bounds)
+{
+	MotionBody body;
+	body.id = id;
+	body.bounds = bounds;
+	pushCommand({CommandType::SetBodyBounds, body});
+}
+
+void MotionThread::stopSimulation()
+{
+	if (!isRunning())
+		return;
+	stopRequested_ = true;
+	wait();
+	stopRequested_ = false;
+}
+
+bool MotionThread::takeFrame(Frame& frame)
+{
+	QMutexLocker lock(&frameMutex_);
+	const Frame& front = frames_[frontFrame_];
+	if (front.sequence == takenSequence_)
+		return false;
+
+	takenSequence_ = front.sequence;
+	frame = front;
+	return true;
+}
+
+void MotionThread::pushCommand(const Command& command)
+{
+	QMutexLocker lock(&commandMutex_);
+	commands_.append(command);
+	++lastCommand_;
+}
+
+void MotionThread::applyCommands()
+{
+	QVector<Command> commands;
+	{
+		QMutexLocker lock(&commandMutex_);
+		commands.swap(commands_);
+		appliedCommand_ = lastCommand_;
+	}
+
+	for (const Command& command : std::as_const(commands))
+	{
+		switch (command.type)
+		{
+		case CommandType::SetWorldBounds:
+			engine_.setWorldBounds(command.body.bounds);
+			break;
+		case CommandType::AddBody:
+			engine_.addBody(command.body);
+			break;
+		case CommandType::RemoveBody:
+			engine_.removeBody(engine_.indexOf(command.body.id));
+			break;
+		case CommandType::SetBodyBounds:
+		{
+			const int index = engine_.indexOf(command.body.id);
+			if (index >= 0)
+				engine_.body(index).bounds = command.body.bounds;
+			break;
+		}
+		}
+	}
+}
+
+void MotionThread::publish(quint64 sequence)
+{
+	// Задний кадр GUI-поток не читает, поэтому заполняем его без блокировки
+	const int back = 1 - frontFrame_;
+	Frame& frame = frames_[back];
+	const QVector<MotionBody>& bodies = engine_.bodies();
+
+	frame.ids.resize(0);
+	frame.bounds.resize(0);
+	frame.movingCount = 0;
+	for (const MotionBody& body : bodies)
+	{
+		if (body.isStatic && body.lifetime < 0)
+			continue; // препятствия двигает только GUI-поток
+		frame.ids.append(body.id);
+		frame.bounds.append(body.bounds);
+		if (!body.isStatic)
+			++frame.movingCount;
+	}
+	frame.sequence = sequence;
+	frame.appliedCommand = appliedCommand_;
+
+	QMutexLocker lock(&frameMutex_);
+	frontFrame_ = back;
+}
+
+void MotionThread::run()
+{
+	const qint64 stepNs = qint64(MotionEngine::TimeStep * 1e9);
+	QElapsedTimer clock;
+	clock.start();
+	qint64 nextStep = 0;
+	quint64 sequence = 0;
+	{
+		QMutexLocker lock(&frameMutex_);
+		sequence = frames_[frontFrame_].sequence;
+	}
+
+	while (!stopRequested_)
+	{
+		{
+			TraceSpan span("MotionThread::step");
+			applyCommands();
+			collisions_ += engine_.step(MotionEngine::TimeStep);
+			publish(++sequence);
+		}
+
+		nextStep += stepNs;
+		const qint64 remaining = nextStep - clock.nsecsElapsed();
+		if (remaining > 0)
+			QThread::usleep(quint64(remaining / 1000));
+		else if (-remaining > MotionEngine::MaxStepsPerAdvance * stepNs)
+			nextStep = clock.nsecsElapsed(); // не догоняем бесконечно после долгой паузы
+	}
+}
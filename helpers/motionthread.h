@@ -0,0 +1,82 @@
+#ifndef MOTIONTHREAD_H
+#define MOTIONTHREAD_H
+
+#include "motionengine.h"
+
+#include <QMutex>
+#include <QThread>
+#include <QVector>
+
+#include <atomic>
+
+// Симуляция движения в отдельном потоке. GUI-поток передаёт изменения через
+// очередь команд и раз в кадр забирает последние опубликованные положения.
+class MotionThread : public QThread
+{
+	Q_OBJECT
+
+  public:
+	struct Frame
+	{
+		quint64 sequence = 0;
+		quint64 appliedCommand = 0; // номер последней учтённой команды
+		int movingCount = 0;
+		QVector<quint32> ids;
+		QVector<QRectF> bounds;
+	};
+
+	explicit MotionThread(QObject* parent = nullptr);
+	~MotionThread() override;
+
+	// Вызываются из GUI-потока
+	void reset();
+	void setWorldBounds(const QRectF& bounds);
+	void addBody(const MotionBody& body);
+	void removeBody(quint32 id);
+	void setBodyBounds(quint32 id, const QRectF& bounds);
+	void stopSimulation();
+
+	bool takeFrame(Frame& frame);
+	int takeCollisions() { return collisions_.exchange(0); }
+	quint64 lastCommand() const { return lastCommand_; }
+
+  protected:
+	void run() override;
+
+  private:
+	enum class CommandType
+	{
+		SetWorldBounds,
+		AddBody,
+		RemoveBody,
+		SetBodyBounds
+	};
+
+	struct Command
+	{
+		CommandType type;
+		MotionBody body;
+	};
+
+	QMutex commandMutex_;
+	QVector<Command> commands_;
+	quint64 lastCommand_ = 0;
+	quint64 appliedCommand_ = 0;
+
+	MotionEngine engine_; // принадлежит рабочему потоку
+
+	// Двойной буфер: поток пишет в задний кадр и под мьютексом меняет их местами
+	QMutex frameMutex_;
+	Frame frames_[2];
+	int frontFrame_ = 0;
+	quint64 takenSequence_ = 0;
+
+	std::atomic<int> collisions_{0};
+	std::atomic<bool> stopRequested_{false};
+
+	void pushCommand(const Command& command);
+	void applyCommands();
+	void publish(quint64 sequence);
+};
+
+#endif // MOTIONTHREAD_H
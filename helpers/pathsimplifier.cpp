@@ -0,0 +1,137 @@
+#include "pathsimplifier.h"
+
+#include <QLineF>
+#include <QPair>
+#include <QVector>
+
+namespace
+{
+	qreal squaredDistanceToSegment(const QPointF& p, const QPointF& a, const QPointF& b)
+	{
+		const qreal dx = b.x() - a.x();
+		const qreal dy = b.y() - a.y();
+		const qreal lengthSquared = dx * dx + dy * dy;
+		qreal t = 0;
+		if (lengthSquared > 0)
+			t = qBound<qreal>(0, ((p.x() - a.x()) * dx + (p.y() - a.y()) * dy) / lengthSquared, 1);
+		const qreal px = a.x() + t * dx - p.x();
+		const qreal py = a.y() + t * dy - p.y();
+		return px * px + py * py;
+	}
+}
+
+QPolygonF PathSimplifier::simplify(const QPolygonF& points, qreal tolerance)
+{
+	QPolygonF result;
+	const QList<int> indices = simplifyIndices(points, tolerance);
+	result.reserve(indices.size());
+	for (int index : indices)
+		result.append(points[index]);
+	return result;
+}
+
+QList<int> PathSimplifier::simplifyIndices(const QPolygonF& points, qreal tolerance)
+{
+	QList<int> result;
+	if (points.size() < 3 || tolerance <= 0)
+	{
+		for (int i = 0; i < points.size(); ++i)
+			result.append(i);
+		return result;
+	}
+
+	const qreal toleranceSquared = tolerance * tolerance;
+	QVector<bool> keep(points.size(), false);
+	keep.first() = true;
+	keep.last() = true;
+
+	// Явный стек вместо рекурсии: длинный штрих не должен переполнять стек вызовов
+	QVector<QPair<int, int>> stack;
+	stack.append({0, int(points.size()) - 1});
+	while (!stack.isEmpty())
+	{
+		const QPair<int, int> range = stack.takeLast();
+		qreal maxDistance = 0;
+		int index = -1;
+		for (int i = range.first + 1; i < range.second; ++i)
+		{
+			qreal distance = squaredDistanceToSegment(points[i], points[range.first], points[range.second]);
+			if (distance > maxDistance)
+			{
+				maxDistance = distance;
+				index = i;
+			}
+		}
+
+		if (index != -1 && maxDistance > toleranceSquared)
+		{
+			keep[index] = true;
+			stack.append({range.first, index});
+			stack.append({index, range.second});
+		}
+	}
+
+	for (int i = 0; i < points.size(); ++i)
+		if (keep[i])
+			result.append(i);
+	return result;
+}
+
+QPainterPath PathSimplifier::toPolylinePath(const QPolygonF& points)
+{
+	QPainterPath path;
+	if (points.isEmpty())
+		return path;
+
+	path.moveTo(points.first());
+	if (points.size() == 1)
+		path.lineTo(points.first() + QPointF(0.01, 0));
+	for (int i = 1; i < points.size(); ++i)
+		path.lineTo(points[i]);
+	return path;
+}
+
+QPainterPath PathSimplifier::toSmoothPath(const QPolygonF& points)
+{
+	if (points.size() < 3)
+		return toPolylinePath(points);
+
+	QPainterPath path;
+	path.moveTo(points.first());
+	path.lineTo((points[0] + points[1]) / 2);
+	for (int i = 1; i < points.size() - 1; ++i)
+		path.quadTo(points[i], (points[i] + points[i + 1]) / 2);
+	path.lineTo(points.last());
+	return path;
+}
+
+QPainterPath PathSimplifier::toVariableWidthPath(const QPolygonF& points, const QList<qreal>& widths)
+{
+	// Круг в каждой точке и трапеция на каждом отрезке; перекрытия закрашиваются по WindingFill
+	QPainterPath path;
+	path.setFillRule(Qt::WindingFill);
+	if (points.isEmpty() || widths.size() != points.size())
+		return path;
+
+	for (int i = 0; i < points.size(); ++i)
+	{
+		const qreal radius = widths[i] / 2;
+		path.addEllipse(points[i], radius, radius);
+		if (i == 0)
+			continue;
+
+		const QLineF segment(points[i - 1], points[i]);
+		if (segment.length() <= 0)
+			continue;
+		const QLineF unitNormal = segment.normalVector().unitVector();
+		const QPointF normal = unitNormal.p2() - unitNormal.p1();
+		const qreal fromRadius = widths[i - 1] / 2;
+
+		QPolygonF quad;
+		quad << segment.p1() + normal * fromRadius << segment.p2() + normal * radius
+			 << segment.p2() - normal * radius << segment.p1() - normal * fromRadius;
+		path.addPolygon(quad);
+		path.closeSubpath();
+	}
+	return path;
+}
@@ -0,0 +1,23 @@
+#ifndef PATHSIMPLIFIER_H
+#define PATHSIMPLIFIER_H
+
+#include <QList>
+#include <QPainterPath>
+#include <QPolygonF>
+
+class PathSimplifier
+{
+  public:
+	// Рамер-Дуглас-Пекер: точки ближе tolerance к хорде выбрасываются
+	static QPolygonF simplify(const QPolygonF& points, qreal tolerance);
+	// То же, но возвращает номера оставленных точек - чтобы вместе с ними оставить и их атрибуты
+	static QList<int> simplifyIndices(const QPolygonF& points, qreal tolerance);
+
+	// Сглаживание квадратичными кривыми через середины отрезков
+	static QPainterPath toSmoothPath(const QPolygonF& points);
+	static QPainterPath toPolylinePath(const QPolygonF& points);
+	// Контур линии переменной толщины (widths - толщина в каждой точке) для заливки
+	static QPainterPath toVariableWidthPath(const QPolygonF& points, const QList<qreal>& widths);
+};
+
+#endif // PATHSIMPLIFIER_H
@@ -0,0 +1,262 @@
+#include "scenecommands.h"
+#include "sceneindex.h"
+#include "sceneserializer.h"
+#include "../items/instanceitem.h"
+#include "../items/rasterlayeritem.h"
+
+#include <QBuffer>
+#include <QCborMap>
+#include <QCborValue>
+#include <QRandomGenerator>
+
+#include <algorithm>
+
+namespace
+{
+	QByteArray encodeTile(const QImage& image)
+	{
+		QByteArray data;
+		if (image.isNull())
+			return data;
+		QBuffer buffer(&data);
+		buffer.open(QIODevice::WriteOnly);
+		image.save(&buffer, "PNG");
+		return data;
+	}
+
+	QHash<QPoint, QByteArray> encodeTiles(const QHash<QPoint, QImage>& tiles)
+	{
+		QHash<QPoint, QByteArray> encoded;
+		for (auto it = tiles.constBegin(); it != tiles.constEnd(); ++it)
+			encoded.insert(it.key(), encodeTile(it.value()));
+		return encoded;
+	}
+
+	qsizetype snapshotsCost(const QList<ItemSnapshot>& snapshots)
+	{
+		qsizetype cost = 0;
+		for (const ItemSnapshot& snapshot : snapshots)
+			cost += sizeof(ItemSnapshot) + snapshot.data.size();
+		return cost;
+	}
+
+	qsizetype tilesCost(const QHash<QPoint, QByteArray>& tiles)
+	{
+		qsizetype cost = 0;
+		for (const QByteArray& tile : tiles)
+			cost += sizeof(QPoint) + sizeof(QByteArray) + tile.size();
+		return cost;
+	}
+}
+
+quint64 SceneCommand::ensureId(QGraphicsItem* item)
+{
+	// У детей группы тоже должны быть id: после отмены объединения они снова станут самостоятельными
+	for (QGraphicsItem* child : item->childItems())
+		ensureId(child);
+
+	const QVariant value = item->data(SceneSerializer::ItemIdKey);
+	if (value.isValid())
+		return value.toULongLong();
+
+	const quint64 id = QRandomGenerator::global()->generate64();
+	item->setData(SceneSerializer::ItemIdKey, id);
+	return id;
+}
+
+QGraphicsItem* SceneCommand::findItem(QGraphicsScene* scene, quint64 id)
+{
+	if (QGraphicsItem* item = SceneIndex::findById(scene, id))
+		return item;
+
+	// Id мог появиться уже после того, как элемент попал в индекс (ensureId), или индекса нет вовсе
+	const QList<QGraphicsItem*> items = scene->items();
+	for (QGraphicsItem* item : items)
+	{
+		const QVariant value = item->data(SceneSerializer::ItemIdKey);
+		if (value.isValid() && value.toULongLong() == id)
+		{
+			SceneIndex::update(scene, item);
+			return item;
+		}
+	}
+	return nullptr;
+}
+
+bool SceneCommand::skipFirstRedo()
+{
+	const bool first = firstRedo_;
+	firstRedo_ = false;
+	return first;
+}
+
+ItemSnapshot ItemSnapshot::take(QGraphicsItem* item)
+{
+	const quint64 id = SceneCommand::ensureId(item);
+	QCborMap map = SceneSerializer::itemToCbor(item);
+	QSharedPointer<InstanceSource> source;
+	if (auto instance = qgraphicsitem_cast<InstanceItem*>(item))
+	{
+		source = instance->source();
+		map.remove(QStringLiteral("source"));
+	}
+	return {id, map.toCborValue().toCbor(), source};
+}
+
+QList<ItemSnapshot> ItemSnapshot::take(const QList<QGraphicsItem*>& items)
+{
+	QList<ItemSnapshot> snapshots;
+	snapshots.reserve(items.size());
+	for (QGraphicsItem* item : items)
+		snapshots.append(take(item));
+	return snapshots;
+}
+
+ReplaceItemsCommand::ReplaceItemsCommand(QGraphicsScene* scene, const QList<ItemSnapshot>& removed,
+										 const QList<ItemSnapshot>& added, const QString& text, int gesture,
+										 QUndoCommand* parent)
+	: SceneCommand(text, parent), scene_(scene), removed_(removed), added_(added), gesture_(gesture)
+{
+}
+
+void ReplaceItemsCommand::undo() { apply(added_, removed_); }
+
+void ReplaceItemsCommand::redo()
+{
+	if (skipFirstRedo())
+		return;
+	apply(removed_, added_);
+}
+
+void ReplaceItemsCommand::apply(const QList<ItemSnapshot>& remove, const QList<ItemSnapshot>& add)
+{
+	for (const ItemSnapshot& snapshot : remove)
+	{
+		QGraphicsItem* item = findItem(scene_, snapshot.id);
+		SceneIndex::remove(scene_, item);
+		delete item;
+	}
+
+	for (const ItemSnapshot& snapshot : add)
+	{
+		QGraphicsItem* item = SceneSerializer::itemFromCbor(QCborValue::fromCbor(snapshot.data).toMap());
+		if (item)
+		{
+			scene_->addItem(item);
+			SceneIndex::update(scene_, item);
+		}
+	}
+}
+
+bool ReplaceItemsCommand::mergeWith(const QUndoCommand* other)
+{
+	auto command = static_cast<const ReplaceItemsCommand*>(other);
+	if (command->gesture_ != gesture_)
+		return false;
+
+	// Кусок, появившийся и стёртый в одном жесте, в истории не нужен вовсе
+	for (const ItemSnapshot& snapshot : command->removed_)
+	{
+		auto it = std::find_if(added_.begin(), added_.end(),
+							   [&snapshot](const ItemSnapshot& added) { return added.id == snapshot.id; });
+		if (it != added_.end())
+			added_.erase(it);
+		else
+			removed_.append(snapshot);
+	}
+	added_.append(command->added_);
+	return true;
+}
+
+qsizetype ReplaceItemsCommand::memoryCost() const { return sizeof(*this) + snapshotsCost(removed_) + snapshotsCost(added_); }
+
+TransformCommand::TransformCommand(QGraphicsScene* scene, Kind kind, const QList<State>& states, int gesture)
+	: SceneCommand(kind == Scale ? QObject::tr("Scale") : QObject::tr("Rotate")), scene_(scene), kind_(kind), states_(states),
+	  gesture_(gesture)
+{
+}
+
+void TransformCommand::redo()
+{
+	if (skipFirstRedo())
+		return;
+	apply(true);
+}
+
+void TransformCommand::apply(bool useNew)
+{
+	for (const State& state : std::as_const(states_))
+	{
+		QGraphicsItem* item = findItem(scene_, state.id);
+		if (!item)
+			continue;
+		item->setTransformOriginPoint(useNew ? state.newOrigin : state.oldOrigin);
+		if (kind_ == Scale)
+			item->setScale(useNew ? state.newValue : state.oldValue);
+		else
+			item->setRotation(useNew ? state.newValue : state.oldValue);
+		SceneIndex::update(scene_, item);
+	}
+}
+
+bool TransformCommand::mergeWith(const QUndoCommand* other)
+{
+	auto command = static_cast<const TransformCommand*>(other);
+	if (command->gesture_ != gesture_ || command->states_.size() != states_.size())
+		return false;
+	for (int i = 0; i < states_.size(); ++i)
+		if (command->states_[i].id != states_[i].id)
+			return false;
+
+	for (int i = 0; i < states_.size(); ++i)
+	{
+		states_[i].newValue = command->states_[i].newValue;
+		states_[i].newOrigin = command->states_[i].newOrigin;
+	}
+	return true;
+}
+
+BackgroundCommand::BackgroundCommand(QGraphicsScene* scene, const QBrush& oldBrush, const QBrush& newBrush,
+									 QUndoCommand* parent)
+	: SceneCommand(QObject::tr("Change background"), parent), scene_(scene), oldBrush_(oldBrush), newBrush_(newBrush)
+{
+}
+
+void BackgroundCommand::redo()
+{
+	if (skipFirstRedo())
+		return;
+	scene_->setBackgroundBrush(newBrush_);
+}
+
+RasterTilesCommand::RasterTilesCommand(QGraphicsScene* scene, quint64 layerId, const QHash<QPoint, QImage>& before,
+									   const QHash<QPoint, QImage>& after)
+	: SceneCommand(QObject::tr("Raster brush")), scene_(scene), layerId_(layerId), before_(encodeTiles(before)),
+	  after_(encodeTiles(after))
+{
+}
+
+void RasterTilesCommand::redo()
+{
+	if (skipFirstRedo())
+		return;
+	apply(after_);
+}
+
+void RasterTilesCommand::apply(const QHash<QPoint, QByteArray>& tiles)
+{
+	auto layer = qgraphicsitem_cast<RasterLayerItem*>(findItem(scene_, layerId_));
+	if (!layer)
+		return;
+
+	for (auto it = tiles.constBegin(); it != tiles.constEnd(); ++it)
+	{
+		if (it.value().isEmpty())
+			layer->removeTile(it.key());
+		else
+			layer->setTileImage(it.key(), QImage::fromData(it.value()));
+	}
+	SceneIndex::update(scene_, layer);
+}
+
+qsizetype RasterTilesCommand::memoryCost() const { return sizeof(*this) + tilesCost(before_) + tilesCost(after_); }
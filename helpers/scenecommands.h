@@ -0,0 +1,141 @@
+#ifndef SCENECOMMANDS_H
+#define SCENECOMMANDS_H
+
+#include <QBrush>
+#include <QGraphicsScene>
+#include <QHash>
+#include <QImage>
+#include <QPoint>
+#include <QSharedPointer>
+#include <QUndoCommand>
+
+class InstanceSource;
+
+// Команды для SceneHistory. Элементы сцены пересоздаются при отмене, поэтому
+// команды ссылаются на них по постоянному id (SceneSerializer::ItemIdKey),
+// а удалённые элементы хранят в виде CBOR.
+class SceneCommand : public QUndoCommand
+{
+  public:
+	using QUndoCommand::QUndoCommand;
+
+	virtual qsizetype memoryCost() const = 0;
+
+	static quint64 ensureId(QGraphicsItem* item);
+	static QGraphicsItem* findItem(QGraphicsScene* scene, quint64 id);
+
+  protected:
+	// Первый redo() пропускается: изменение к моменту push уже сделано на сцене
+	bool skipFirstRedo();
+
+  private:
+	bool firstRedo_ = true;
+};
+
+struct ItemSnapshot
+{
+	quint64 id;
+	QByteArray data;
+	// Копия держит свой источник живым, а не кладёт его в data: иначе каждая копия хранила бы его целиком
+	QSharedPointer<InstanceSource> source;
+
+	static ItemSnapshot take(QGraphicsItem* item);
+	static QList<ItemSnapshot> take(const QList<QGraphicsItem*>& items);
+};
+
+// Удаление одних элементов и добавление других: кисть, ластик, фигуры, объединение, очистка
+class ReplaceItemsCommand : public SceneCommand
+{
+  public:
+	// gesture >= 0 - команды одного жеста (движения ластика) сливаются в одну
+	ReplaceItemsCommand(QGraphicsScene* scene, const QList<ItemSnapshot>& removed, const QList<ItemSnapshot>& added,
+						const QString& text, int gesture = -1, QUndoCommand* parent = nullptr);
+
+	void undo() override;
+	void redo() override;
+	int id() const override { return gesture_ >= 0 ? 1 : -1; }
+	bool mergeWith(const QUndoCommand* other) override;
+	qsizetype memoryCost() const override;
+
+  private:
+	QGraphicsScene* scene_;
+	QList<ItemSnapshot> removed_;
+	QList<ItemSnapshot> added_;
+	int gesture_;
+
+	void apply(const QList<ItemSnapshot>& remove, const QList<ItemSnapshot>& add);
+};
+
+// Масштаб или поворот выделенных элементов ползунком
+class TransformCommand : public SceneCommand
+{
+  public:
+	enum Kind
+	{
+		Scale,
+		Rotation
+	};
+
+	struct State
+	{
+		quint64 id;
+		qreal oldValue;
+		qreal newValue;
+		QPointF oldOrigin;
+		QPointF newOrigin;
+	};
+
+	// gesture >= 0 - шаги одного перетаскивания ползунка сливаются в одну команду
+	TransformCommand(QGraphicsScene* scene, Kind kind, const QList<State>& states, int gesture = -1);
+
+	void undo() override { apply(false); }
+	void redo() override;
+	int id() const override { return gesture_ < 0 ? -1 : kind_ == Scale ? 2 : 3; }
+	bool mergeWith(const QUndoCommand* other) override;
+	qsizetype memoryCost() const override { return sizeof(*this) + states_.size() * sizeof(State); }
+
+  private:
+	QGraphicsScene* scene_;
+	Kind kind_;
+	QList<State> states_;
+	int gesture_;
+
+	void apply(bool useNew);
+};
+
+class BackgroundCommand : public SceneCommand
+{
+  public:
+	BackgroundCommand(QGraphicsScene* scene, const QBrush& oldBrush, const QBrush& newBrush, QUndoCommand* parent = nullptr);
+
+	void undo() override { scene_->setBackgroundBrush(oldBrush_); }
+	void redo() override;
+	qsizetype memoryCost() const override { return sizeof(*this); }
+
+  private:
+	QGraphicsScene* scene_;
+	QBrush oldBrush_;
+	QBrush newBrush_;
+};
+
+// Мазок по растровому слою: плитки до и после в PNG, пустой массив - плитки не было
+class RasterTilesCommand : public SceneCommand
+{
+  public:
+	RasterTilesCommand(QGraphicsScene* scene, quint64 layerId, const QHash<QPoint, QImage>& before,
+					   const QHash<QPoint, QImage>& after);
+
+	void undo() override { apply(before_); }
+	void redo() override;
+	qsizetype memoryCost() const override;
+
+  private:
+	QGraphicsScene* scene_;
+	quint64 layerId_;
+	QHash<QPoint, QByteArray> before_;
+	QHash<QPoint, QByteArray> after_;
+
+	void apply(const QHash<QPoint, QByteArray>& tiles);
+};
+
+#endif // SCENECOMMANDS_H
@@ -0,0 +1,136 @@
+#include "scenecopypool.h"
+#include "sceneserializer.h"
+#include "../items/imageitem.h"
+
+#include <QCoreApplication>
+#include <QGraphicsPixmapItem>
+#include <QPainter>
+#include <QtConcurrent/QtConcurrentMap>
+
+namespace
+{
+	// QPixmap можно рисовать только в GUI-потоке, поэтому в копиях вместо
+	// QGraphicsPixmapItem стоит элемент с QImage
+	class PixmapCopyItem : public QGraphicsItem
+	{
+	  public:
+		PixmapCopyItem(const QGraphicsPixmapItem* source, const QImage& image)
+			: image_(image), offset_(source->offset()),
+			  isSmooth_(source->transformationMode() == Qt::SmoothTransformation)
+		{
+		}
+
+		QRectF boundingRect() const override { return QRectF(offset_, image_.deviceIndependentSize()); }
+
+		void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget) override
+		{
+			Q_UNUSED(option);
+			Q_UNUSED(widget);
+			painter->setRenderHint(QPainter::SmoothPixmapTransform, isSmooth_);
+			painter->drawImage(offset_, image_);
+		}
+
+	  private:
+		QImage image_;
+		QPointF offset_;
+		bool isSmooth_;
+	};
+
+	// Порядок обхода одинаков у сцены и её копий: копии строятся из тех же элементов в том же порядке
+	void collectPixmapItems(QGraphicsItem* item, QList<QGraphicsPixmapItem*>& items)
+	{
+		if (auto pixmapItem = qgraphicsitem_cast<QGraphicsPixmapItem*>(item))
+			items.append(pixmapItem);
+		const QList<QGraphicsItem*> children = item->childItems();
+		for (QGraphicsItem* child : children)
+			collectPixmapItems(child, items);
+	}
+
+	QList<QGraphicsPixmapItem*> pixmapItems(const QGraphicsScene* scene)
+	{
+		QList<QGraphicsPixmapItem*> items;
+		const QList<QGraphicsItem*> topLevel = SceneSerializer::topLevelItems(scene);
+		for (QGraphicsItem* item : topLevel)
+			collectPixmapItems(item, items);
+		return items;
+	}
+
+	void replaceWithImage(QGraphicsPixmapItem* pixmapItem, const QImage& image)
+	{
+		auto copy = new PixmapCopyItem(pixmapItem, image);
+		copy->setPos(pixmapItem->pos());
+		copy->setTransformOriginPoint(pixmapItem->transformOriginPoint());
+		copy->setRotation(pixmapItem->rotation());
+		copy->setScale(pixmapItem->scale());
+		copy->setTransform(pixmapItem->transform());
+		copy->setZValue(pixmapItem->zValue());
+		copy->setOpacity(pixmapItem->opacity());
+		copy->setVisible(pixmapItem->isVisible());
+		copy->setData(SceneSerializer::ItemIdKey, pixmapItem->data(SceneSerializer::ItemIdKey)); // по нему анимирует KeyframeTimeline
+		if (pixmapItem->parentItem())
+			copy->setParentItem(pixmapItem->parentItem());
+		else
+			pixmapItem->scene()->addItem(copy);
+		copy->stackBefore(pixmapItem);
+
+		const QList<QGraphicsItem*> children = pixmapItem->childItems();
+		for (QGraphicsItem* child : children)
+			child->setParentItem(copy);
+		delete pixmapItem;
+	}
+}
+
+SceneCopyPool::SceneCopyPool(const QGraphicsScene* scene, int count)
+{
+	const QByteArray data = SceneSerializer::itemsToBytes(SceneSerializer::topLevelItems(scene));
+
+	// Картинки в полном разрешении декодируются один раз и делятся между копиями
+	QList<QByteArray> sources;
+	for (QGraphicsItem* item : scene->items())
+		if (auto image = qgraphicsitem_cast<ImageItem*>(item))
+			if (!sources.contains(image->sourceData()))
+				sources.append(image->sourceData());
+	const QList<QImage> images = QtConcurrent::blockingMapped<QList<QImage>>(sources, &ImageItem::decode);
+
+	QList<QImage> pixmapImages;
+	for (const QGraphicsPixmapItem* item : pixmapItems(scene))
+		pixmapImages.append(item->pixmap().toImage());
+
+	for (int i = 0; i < count; ++i)
+	{
+		QGraphicsScene* copy = new QGraphicsScene(scene->sceneRect());
+		copy->setBackgroundBrush(scene->backgroundBrush());
+		copy->setForegroundBrush(scene->foregroundBrush());
+		// Без BSP-индекса запрос элементов ничего не перестраивает внутри сцены
+		copy->setItemIndexMethod(QGraphicsScene::NoIndex);
+		for (QGraphicsItem* item : SceneSerializer::itemsFromBytes(data))
+			copy->addItem(item);
+		for (QGraphicsItem* item : copy->items())
+			if (auto image = qgraphicsitem_cast<ImageItem*>(item))
+				image->setFullImage(images.value(sources.indexOf(image->sourceData())));
+		const QList<QGraphicsPixmapItem*> copiedPixmaps = pixmapItems(copy);
+		for (int j = 0; j < copiedPixmaps.size() && j < pixmapImages.size(); ++j)
+			replaceWithImage(copiedPixmaps[j], pixmapImages[j]);
+
+		// Отложенные вызовы выполняем сейчас, а дальше сцена событий не получает:
+		// иначе GUI-поток обрабатывал бы их одновременно с рабочим
+		QCoreApplication::sendPostedEvents(copy);
+		copy->moveToThread(nullptr);
+		scenes_.append(copy);
+	}
+	free_ = scenes_;
+}
+
+SceneCopyPool::~SceneCopyPool() { qDeleteAll(scenes_); }
+
+QGraphicsScene* SceneCopyPool::acquire()
+{
+	QMutexLocker lock(&mutex_);
+	return free_.takeLast();
+}
+
+void SceneCopyPool::release(QGraphicsScene* scene)
+{
+	QMutexLocker lock(&mutex_);
+	free_.append(scene);
+}
@@ -0,0 +1,27 @@
+#ifndef SCENECOPYPOOL_H
+#define SCENECOPYPOOL_H
+
+#include <QGraphicsScene>
+#include <QList>
+#include <QMutex>
+
+// QGraphicsScene не потокобезопасна (индекс, кэши элементов), поэтому для
+// рендера в пуле потоков у каждого потока своя копия сцены. Копия берётся
+// из пула на время одной задачи (плитка, кадр) и возвращается обратно.
+// Растровые элементы в копиях держат QImage: QPixmap вне GUI-потока рисовать нельзя.
+class SceneCopyPool
+{
+  public:
+	SceneCopyPool(const QGraphicsScene* scene, int count);
+	~SceneCopyPool();
+
+	QGraphicsScene* acquire();
+	void release(QGraphicsScene* scene);
+
+  private:
+	QMutex mutex_;
+	QList<QGraphicsScene*> scenes_;
+	QList<QGraphicsScene*> free_;
+};
+
+#endif // SCENECOPYPOOL_H
@@ -0,0 +1,218 @@
+#include "sceneexporter.h"
+#include "imagestreamwriter.h"
+#include "scenecopypool.h"
+
+#include <QDir>
+#include <QFuture>
+#include <QPainter>
+#include <QQueue>
+#include <QSaveFile>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <QtMath>
+
+#include <atomic>
+#include <cstring>
+
+bool SceneExporter::canExport(const QString& filePath)
+{
+	return ImageStreamWriter::create(filePath) != nullptr;
+}
+
+QRectF SceneExporter::page(const QGraphicsScene* scene)
+{
+	const QVariant page = scene->property(PageProperty);
+	return page.isValid() ? page.toRectF() : scene->sceneRect();
+}
+
+void SceneExporter::setPage(QGraphicsScene* scene, const QRectF& rect)
+{
+	scene->setProperty(PageProperty, rect);
+}
+
+QRectF SceneExporter::exportRect(const QGraphicsScene* scene)
+{
+	return page(scene).united(scene->itemsBoundingRect());
+}
+
+QSize SceneExporter::outputSize(const QGraphicsScene* scene, qreal dpi)
+{
+	const qreal scale = dpi / ScreenDpi;
+	const QRectF rect = exportRect(scene);
+	return QSize(qMax(1, qCeil(rect.width() * scale)), qMax(1, qCeil(rect.height() * scale)));
+}
+
+bool SceneExporter::exportScene(const QGraphicsScene* scene, const QString& filePath, qreal dpi, QString* errorString,
+								const Progress& progress)
+{
+	auto setError = [errorString](const QString& message)
+	{
+		if (errorString)
+			*errorString = message;
+		return false;
+	};
+
+	std::unique_ptr<ImageStreamWriter> writer = ImageStreamWriter::create(filePath);
+	if (!writer)
+		return setError(QStringLiteral("Unsupported image format"));
+
+	QSaveFile file(filePath);
+	if (!file.open(QIODevice::WriteOnly))
+		return setError(file.errorString());
+
+	const QSize size = outputSize(scene, dpi);
+	if (!writer->begin(&file, size, dpi))
+		return setError(writer->errorString());
+
+	const qreal scale = dpi / ScreenDpi;
+	const QRectF sceneRect = exportRect(scene);
+	const int columns = (size.width() + TileSize - 1) / TileSize;
+	const int bands = (size.height() + TileSize - 1) / TileSize;
+	const int workers = qBound(1, QThread::idealThreadCount(), columns * bands);
+	const bool transparent = writer->hasAlpha();
+
+	QThreadPool pool;
+	pool.setMaxThreadCount(workers);
+	SceneCopyPool copies(scene, workers);
+	std::atomic<bool> canceled{false};
+
+	auto renderTile = [&](const QRect& target)
+	{
+		QImage tile(target.size(), QImage::Format_ARGB32_Premultiplied);
+		tile.fill(transparent ? Qt::transparent : Qt::white);
+		if (canceled)
+			return tile;
+
+		QGraphicsScene* copy = copies.acquire();
+		QPainter painter(&tile);
+		painter.setRenderHints(QPainter::Antialiasing | QPainter::SmoothPixmapTransform | QPainter::TextAntialiasing);
+		const QRectF source(sceneRect.x() + target.x() / scale, sceneRect.y() + target.y() / scale,
+							target.width() / scale, target.height() / scale);
+		copy->render(&painter, QRectF(QPointF(0, 0), target.size()), source, Qt::IgnoreAspectRatio);
+		painter.end();
+		copies.release(copy);
+		return tile;
+	};
+
+	auto submitBand = [&](int band)
+	{
+		QList<QFuture<QImage>> tiles;
+		const int top = band * TileSize;
+		const int height = qMin(TileSize, size.height() - top);
+		for (int column = 0; column < columns; ++column)
+		{
+			const int left = column * TileSize;
+			const QRect target(left, top, qMin(TileSize, size.width() - left), height);
+			tiles.append(QtConcurrent::run(&pool, renderTile, target));
+		}
+		return tiles;
+	};
+
+	// Вперёд считаем столько полос, чтобы пул был занят, пока кодируется текущая
+	const int window = qMax(2, (workers + columns - 1) / columns + 1);
+	QQueue<QList<QFuture<QImage>>> inFlight;
+	int submitted = 0;
+	bool ok = true;
+	QString error;
+
+	for (int band = 0; band < bands && ok; ++band)
+	{
+		while (submitted < bands && submitted < band + window)
+			inFlight.enqueue(submitBand(submitted++));
+
+		const QList<QFuture<QImage>> tiles = inFlight.dequeue();
+		const int height = qMin(TileSize, size.height() - band * TileSize);
+		QImage rows(size.width(), height, QImage::Format_ARGB32_Premultiplied);
+		for (int column = 0; column < tiles.size(); ++column)
+		{
+			const QImage tile = tiles[column].result();
+			const qsizetype bytes = qsizetype(tile.width()) * 4;
+			for (int y = 0; y < height; ++y)
+				std::memcpy(rows.scanLine(y) + qsizetype(column) * TileSize * 4, tile.constScanLine(y), bytes);
+		}
+
+		if (!writer->writeRows(rows))
+		{
+			ok = false;
+			error = writer->errorString();
+		}
+		else if (progress && !progress(band + 1, bands))
+		{
+			ok = false;
+		}
+	}
+
+	canceled = true;
+	pool.waitForDone();
+
+	if (ok && !writer->finish())
+	{
+		ok = false;
+		error = writer->errorString();
+	}
+	if (!ok)
+	{
+		file.cancelWriting();
+		return error.isEmpty() ? false : setError(error);
+	}
+	if (!file.commit())
+		return setError(file.errorString());
+	return true;
+}
+
+bool SceneExporter::exportFrames(const QGraphicsScene* scene, const KeyframeTimeline& timeline, const QString& directory,
+								 int fps, QString* errorString, const Progress& progress)
+{
+	const QDir dir(directory);
+	const int frames = qFloor(timeline.duration() * fps) + 1;
+	const int workers = qBound(1, QThread::idealThreadCount(), frames);
+	const QRectF sceneRect = exportRect(scene);
+	const QSize size = sceneRect.size().toSize().expandedTo(QSize(1, 1));
+
+	QThreadPool pool;
+	pool.setMaxThreadCount(workers);
+	SceneCopyPool copies(scene, workers);
+	std::atomic<bool> canceled{false};
+
+	// Каждый кадр задаёт все анимированные элементы целиком, так что копии не помнят прошлых кадров
+	auto renderFrame = [&](int frame)
+	{
+		if (canceled)
+			return QString();
+
+		QImage image(size, QImage::Format_ARGB32_Premultiplied);
+		image.fill(Qt::transparent);
+
+		QGraphicsScene* copy = copies.acquire();
+		timeline.apply(copy, qreal(frame) / fps);
+		QPainter painter(&image);
+		painter.setRenderHints(QPainter::Antialiasing | QPainter::SmoothPixmapTransform | QPainter::TextAntialiasing);
+		copy->render(&painter, QRectF(QPointF(0, 0), size), sceneRect, Qt::IgnoreAspectRatio);
+		painter.end();
+		copies.release(copy);
+
+		const QString path = dir.filePath(QStringLiteral("frame_%1.png").arg(frame, 5, 10, QLatin1Char('0')));
+		return image.save(path, "PNG") ? QString() : QObject::tr("Could not write %1").arg(path);
+	};
+
+	QQueue<QFuture<QString>> inFlight;
+	int submitted = 0;
+	QString error;
+	bool ok = true;
+	for (int frame = 0; frame < frames && ok; ++frame)
+	{
+		while (submitted < frames && submitted < frame + 2 * workers)
+			inFlight.enqueue(QtConcurrent::run(&pool, renderFrame, submitted++));
+
+		error = inFlight.dequeue().result();
+		if (!error.isEmpty() || (progress && !progress(frame + 1, frames)))
+			ok = false;
+	}
+
+	canceled = true;
+	pool.waitForDone();
+
+	if (!error.isEmpty() && errorString)
+		*errorString = error;
+	return ok;
+}
@@ -0,0 +1,43 @@
+#ifndef SCENEEXPORTER_H
+#define SCENEEXPORTER_H
+
+#include "keyframetimeline.h"
+
+#include <QGraphicsScene>
+#include <QSize>
+#include <QString>
+
+#include <functional>
+
+// Экспорт сцены в PNG/JPEG в заданном разрешении. Сцена рисуется плитками в
+// пуле потоков, готовые полосы сразу уходят в кодировщик - память ограничена
+// несколькими полосами, а не размером всего изображения.
+class SceneExporter
+{
+  public:
+	static constexpr int TileSize = 256;
+	static constexpr qreal ScreenDpi = 96;
+	static constexpr char PageProperty[] = "exportPage";
+
+	// Возвращает false, чтобы прервать экспорт
+	using Progress = std::function<bool(int done, int total)>;
+
+	static bool canExport(const QString& filePath);
+	// Лист документа хранится свойством сцены, а не в sceneRect: sceneRect растёт
+	// вместе с элементами, чтобы BSP-индекс сцены покрывал весь холст.
+	// Без листа его роль играет sceneRect
+	static QRectF page(const QGraphicsScene* scene);
+	static void setPage(QGraphicsScene* scene, const QRectF& rect);
+	// Холст не ограничен: экспортируется лист вместе со всем, что за него выходит
+	static QRectF exportRect(const QGraphicsScene* scene);
+	static QSize outputSize(const QGraphicsScene* scene, qreal dpi);
+
+	static bool exportScene(const QGraphicsScene* scene, const QString& filePath, qreal dpi,
+							QString* errorString = nullptr, const Progress& progress = Progress());
+
+	// Анимация в directory/frame_00000.png, ... с частотой fps; кадры рисуются параллельно
+	static bool exportFrames(const QGraphicsScene* scene, const KeyframeTimeline& timeline, const QString& directory,
+							 int fps, QString* errorString = nullptr, const Progress& progress = Progress());
+};
+
+#endif // SCENEEXPORTER_H
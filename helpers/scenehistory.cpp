@@ -0,0 +1,109 @@
+#include "scenehistory.h"
+#include "scenecommands.h"
+
+SceneHistory::SceneHistory(QObject* parent) : QObject(parent) {}
+
+SceneHistory::~SceneHistory() { qDeleteAll(commands_); }
+
+qsizetype SceneHistory::costOf(const QUndoCommand* command)
+{
+	qsizetype cost = sizeof(QUndoCommand);
+	if (auto sceneCommand = dynamic_cast<const SceneCommand*>(command))
+		cost = sceneCommand->memoryCost();
+	for (int i = 0; i < command->childCount(); ++i)
+		cost += costOf(command->child(i));
+	return cost;
+}
+
+void SceneHistory::push(QUndoCommand* command)
+{
+	command->redo();
+
+	// Отменённые шаги больше не вернуть
+	while (commands_.size() > index_)
+		removeAt(commands_.size() - 1);
+	if (cleanIndex_ > index_)
+		cleanIndex_ = -1;
+
+	// В шаг, после которого сохраняли, не сливаем: отмена должна вернуть к сохранённому
+	QUndoCommand* top = index_ > 0 && cleanIndex_ != index_ ? commands_[index_ - 1] : nullptr;
+	if (top && command->id() != -1 && top->id() == command->id() && top->mergeWith(command))
+	{
+		delete command;
+		usage_ -= costs_[index_ - 1];
+		costs_[index_ - 1] = costOf(top);
+		usage_ += costs_[index_ - 1];
+	}
+	else
+	{
+		commands_.append(command);
+		costs_.append(costOf(command));
+		usage_ += costs_.last();
+		++index_;
+	}
+
+	evict();
+	emit changed();
+}
+
+void SceneHistory::undo()
+{
+	if (!canUndo())
+		return;
+	commands_[--index_]->undo();
+	emit changed();
+}
+
+void SceneHistory::redo()
+{
+	if (!canRedo())
+		return;
+	commands_[index_++]->redo();
+	emit changed();
+}
+
+void SceneHistory::clear()
+{
+	qDeleteAll(commands_);
+	commands_.clear();
+	costs_.clear();
+	index_ = 0;
+	cleanIndex_ = 0;
+	usage_ = 0;
+	emit changed();
+}
+
+void SceneHistory::setClean()
+{
+	cleanIndex_ = index_;
+	emit changed();
+}
+
+void SceneHistory::setMemoryBudget(qsizetype bytes)
+{
+	budget_ = bytes;
+	evict();
+}
+
+void SceneHistory::evict()
+{
+	// Последнюю выполненную команду оставляем, даже если она одна больше бюджета
+	while (usage_ > budget_ && index_ > 1)
+	{
+		removeAt(0);
+		--index_;
+		if (cleanIndex_ >= 0)
+			--cleanIndex_;
+	}
+	while (usage_ > budget_ && commands_.size() > index_)
+		removeAt(commands_.size() - 1);
+	if (cleanIndex_ > commands_.size())
+		cleanIndex_ = -1;
+}
+
+void SceneHistory::removeAt(int index)
+{
+	usage_ -= costs_[index];
+	delete commands_.takeAt(index);
+	costs_.removeAt(index);
+}
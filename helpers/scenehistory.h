@@ -0,0 +1,55 @@
+#ifndef SCENEHISTORY_H
+#define SCENEHISTORY_H
+
+#include <QList>
+#include <QObject>
+#include <QUndoCommand>
+
+// Стек отмены для сцены. В отличие от QUndoStack ограничен не числом шагов,
+// а памятью: когда команды занимают больше memoryBudget(), самые старые удаляются.
+class SceneHistory : public QObject
+{
+	Q_OBJECT
+
+  public:
+	static constexpr qsizetype DefaultBudget = 64 * 1024 * 1024;
+
+	explicit SceneHistory(QObject* parent = nullptr);
+	~SceneHistory() override;
+
+	// Команда выполняется (redo) и попадает в стек; при совпадении id() сливается с верхней
+	void push(QUndoCommand* command);
+	void undo();
+	void redo();
+	// Как у QUndoStack: после clear() стек чистый
+	void clear();
+
+	// Чистое состояние - сохранённый или загруженный документ
+	void setClean();
+	bool isClean() const { return index_ == cleanIndex_; }
+
+	bool canUndo() const { return index_ > 0; }
+	bool canRedo() const { return index_ < commands_.size(); }
+	int count() const { return commands_.size(); }
+
+	void setMemoryBudget(qsizetype bytes);
+	qsizetype memoryBudget() const { return budget_; }
+	qsizetype memoryUsage() const { return usage_; }
+
+  signals:
+	void changed();
+
+  private:
+	QList<QUndoCommand*> commands_;
+	QList<qsizetype> costs_;
+	int index_ = 0;
+	int cleanIndex_ = 0; // -1 - чистое состояние больше не достижимо
+	qsizetype usage_ = 0;
+	qsizetype budget_ = DefaultBudget;
+
+	void evict();
+	void removeAt(int index);
+	static qsizetype costOf(const QUndoCommand* command);
+};
+
+#endif // SCENEHISTORY_H
@@ -0,0 +1,262 @@
+#include "sceneindex.h"
+#include "sceneserializer.h"
+
+#include <QPainterPath>
+
+#include <algorithm>
+
+namespace
+{
+	bool touches(const QRectF& a, const QRectF& b)
+	{
+		// В отличие от QRectF::intersects, прямоугольник нулевого размера тоже пересекается
+		return a.left() <= b.right() && b.left() <= a.right() && a.top() <= b.bottom() && b.top() <= a.bottom();
+	}
+
+	QGraphicsItem* topmostAt(QGraphicsItem* item, const QPointF& scenePos)
+	{
+		// childItems() уже отсортированы по стопке снизу вверх
+		const QList<QGraphicsItem*> children = item->childItems();
+		for (int i = children.size() - 1; i >= 0; --i)
+		{
+			QGraphicsItem* child = children[i];
+			if (!child->isVisible() || (child->flags() & QGraphicsItem::ItemStacksBehindParent))
+				continue;
+			if (QGraphicsItem* hit = topmostAt(child, scenePos))
+				return hit;
+		}
+
+		if (item->contains(item->mapFromScene(scenePos)))
+			return item;
+
+		for (int i = children.size() - 1; i >= 0; --i)
+		{
+			QGraphicsItem* child = children[i];
+			if (!child->isVisible() || !(child->flags() & QGraphicsItem::ItemStacksBehindParent))
+				continue;
+			if (QGraphicsItem* hit = topmostAt(child, scenePos))
+				return hit;
+		}
+		return nullptr;
+	}
+}
+
+SceneIndex::SceneIndex(QGraphicsScene* scene)
+	: QObject(scene), scene_(scene)
+{
+}
+
+SceneIndex* SceneIndex::install(QGraphicsScene* scene)
+{
+	if (SceneIndex* index = of(scene))
+		return index;
+
+	SceneIndex* index = new SceneIndex(scene);
+	index->rebuildIndex();
+	return index;
+}
+
+SceneIndex* SceneIndex::of(const QGraphicsScene* scene)
+{
+	return scene ? scene->findChild<SceneIndex*>(QString(), Qt::FindDirectChildrenOnly) : nullptr;
+}
+
+void SceneIndex::update(QGraphicsScene* scene, QGraphicsItem* item)
+{
+	if (SceneIndex* index = of(scene))
+		index->updateItem(item);
+}
+
+void SceneIndex::update(QGraphicsScene* scene, const QList<QGraphicsItem*>& items)
+{
+	if (SceneIndex* index = of(scene))
+		for (QGraphicsItem* item : items)
+			index->updateItem(item);
+}
+
+void SceneIndex::remove(QGraphicsScene* scene, QGraphicsItem* item)
+{
+	if (SceneIndex* index = of(scene))
+		index->removeItem(item);
+}
+
+void SceneIndex::remove(QGraphicsScene* scene, const QList<QGraphicsItem*>& items)
+{
+	if (SceneIndex* index = of(scene))
+		for (QGraphicsItem* item : items)
+			index->removeItem(item);
+}
+
+void SceneIndex::rebuild(QGraphicsScene* scene)
+{
+	if (SceneIndex* index = of(scene))
+		index->rebuildIndex();
+}
+
+QList<QGraphicsItem*> SceneIndex::items(const QGraphicsScene* scene, const QRectF& rect, Qt::ItemSelectionMode mode)
+{
+	if (const SceneIndex* index = of(scene))
+		return index->query(rect, mode);
+
+	QList<QGraphicsItem*> result;
+	if (!scene)
+		return result;
+	const QList<QGraphicsItem*> found = scene->items(rect, mode);
+	for (QGraphicsItem* item : found)
+		if (!item->parentItem())
+			result.append(item);
+	return result;
+}
+
+QGraphicsItem* SceneIndex::itemAt(const QGraphicsScene* scene, const QPointF& pos)
+{
+	if (const SceneIndex* index = of(scene))
+		return index->hitTest(pos);
+	return scene ? scene->itemAt(pos, QTransform()) : nullptr;
+}
+
+QGraphicsItem* SceneIndex::findById(const QGraphicsScene* scene, quint64 id)
+{
+	const SceneIndex* index = of(scene);
+	return index ? index->ids_.value(id) : nullptr;
+}
+
+QRectF SceneIndex::itemBounds(const QGraphicsItem* item)
+{
+	QRectF bounds = item->sceneBoundingRect();
+	if (!item->childItems().isEmpty())
+		bounds |= item->mapRectToScene(item->childrenBoundingRect());
+	return bounds;
+}
+
+void SceneIndex::updateItem(QGraphicsItem* item)
+{
+	if (!item)
+		return;
+	item = item->topLevelItem();
+	if (item->scene() != scene_)
+	{
+		removeItem(item);
+		return;
+	}
+
+	auto it = entries_.find(item);
+	if (it == entries_.end())
+		entries_.insert(item, {tree_.insert(itemBounds(item), item), nextOrder_++});
+	else
+		tree_.move(it->proxy, itemBounds(item));
+	// Состав группы мог измениться - id потомков переписываем заново
+	registerIds(item);
+}
+
+void SceneIndex::removeItem(QGraphicsItem* item)
+{
+	auto it = entries_.find(item);
+	if (it == entries_.end())
+	{
+		// Дочерний элемент удаляют отдельно от группы - указатель на него не должен остаться
+		if (item)
+			unregisterIds(item);
+		return;
+	}
+	tree_.remove(it->proxy);
+	entries_.erase(it);
+	unregisterIds(item);
+}
+
+void SceneIndex::rebuildIndex()
+{
+	// Сцену могли очистить: старые указатели не разыменовываем
+	tree_.clear();
+	entries_.clear();
+	ids_.clear();
+	nextOrder_ = 0;
+
+	const QList<QGraphicsItem*> items = scene_->items(Qt::AscendingOrder);
+	entries_.reserve(items.size());
+	for (QGraphicsItem* item : items)
+	{
+		if (item->parentItem())
+			continue;
+		entries_.insert(item, {tree_.insert(itemBounds(item), item), nextOrder_++});
+		registerIds(item);
+	}
+}
+
+void SceneIndex::registerIds(QGraphicsItem* item)
+{
+	const QVariant id = item->data(SceneSerializer::ItemIdKey);
+	if (id.isValid())
+		ids_.insert(id.toULongLong(), item);
+	const QList<QGraphicsItem*> children = item->childItems();
+	for (QGraphicsItem* child : children)
+		registerIds(child);
+}
+
+void SceneIndex::unregisterIds(QGraphicsItem* item)
+{
+	const QVariant id = item->data(SceneSerializer::ItemIdKey);
+	if (id.isValid())
+	{
+		auto it = ids_.find(id.toULongLong());
+		if (it != ids_.end() && *it == item)
+			ids_.erase(it);
+	}
+	const QList<QGraphicsItem*> children = item->childItems();
+	for (QGraphicsItem* child : children)
+		unregisterIds(child);
+}
+
+void SceneIndex::sortByStacking(QList<QGraphicsItem*>& items) const
+{
+	std::sort(items.begin(), items.end(), [this](QGraphicsItem* l, QGraphicsItem* r) {
+		if (l->zValue() != r->zValue())
+			return l->zValue() > r->zValue();
+		return entries_.value(l).order > entries_.value(r).order;
+	});
+}
+
+QList<QGraphicsItem*> SceneIndex::query(const QRectF& rect, Qt::ItemSelectionMode mode) const
+{
+	QList<QGraphicsItem*> result;
+	const bool byShape = mode == Qt::IntersectsItemShape || mode == Qt::ContainsItemShape;
+	QPainterPath scenePath;
+	if (byShape)
+		scenePath.addRect(rect);
+
+	tree_.query(rect, [&](int proxy) {
+		auto item = static_cast<QGraphicsItem*>(tree_.data(proxy));
+		if (!item->isVisible())
+			return true;
+
+		bool matches;
+		if (byShape)
+			matches = item->collidesWithPath(item->mapFromScene(scenePath), mode);
+		else if (mode == Qt::ContainsItemBoundingRect)
+			matches = rect.contains(itemBounds(item));
+		else
+			matches = touches(rect, itemBounds(item));
+		if (matches)
+			result.append(item);
+		return true;
+	});
+	sortByStacking(result);
+	return result;
+}
+
+QGraphicsItem* SceneIndex::hitTest(const QPointF& pos) const
+{
+	QList<QGraphicsItem*> candidates;
+	tree_.query(QRectF(pos, QSizeF(0, 0)), [&](int proxy) {
+		auto item = static_cast<QGraphicsItem*>(tree_.data(proxy));
+		if (item->isVisible() && touches(itemBounds(item), QRectF(pos, QSizeF(0, 0))))
+			candidates.append(item);
+		return true;
+	});
+	sortByStacking(candidates);
+
+	for (QGraphicsItem* item : std::as_const(candidates))
+		if (QGraphicsItem* hit = topmostAt(item, pos))
+			return hit;
+	return nullptr;
+}
@@ -0,0 +1,72 @@
+#ifndef SCENEINDEX_H
+#define SCENEINDEX_H
+
+#include "aabbtree.h"
+
+#include <QGraphicsItem>
+#include <QGraphicsScene>
+#include <QHash>
+#include <QList>
+#include <QObject>
+
+// Индекс верхнеуровневых элементов сцены для проверки попадания и выборки по
+// прямоугольнику в коде редактора. Встроенный BSP-индекс сцены остаётся: по нему
+// сцена и вид сами ищут элементы при отрисовке, нажатиях мыши, наведении и
+// выделении рамкой - их запросы сюда не перенаправить.
+// Об изменениях индекс узнаёт явно: update после добавления, сдвига или смены
+// размера, remove - до удаления элемента, rebuild - после clear() и загрузки.
+// Для сцены без индекса все функции работают как обычные запросы сцены.
+// Отсекать невидимое при отрисовке не нужно: вид и так рисует только элементы,
+// которые BSP-индекс находит в открытой области.
+class SceneIndex : public QObject
+{
+	Q_OBJECT
+
+  public:
+	static SceneIndex* install(QGraphicsScene* scene);
+	static SceneIndex* of(const QGraphicsScene* scene);
+
+	static void update(QGraphicsScene* scene, QGraphicsItem* item);
+	static void update(QGraphicsScene* scene, const QList<QGraphicsItem*>& items);
+	static void remove(QGraphicsScene* scene, QGraphicsItem* item);
+	static void remove(QGraphicsScene* scene, const QList<QGraphicsItem*>& items);
+	static void rebuild(QGraphicsScene* scene);
+
+	// Только верхнеуровневые элементы, сверху вниз по стопке
+	static QList<QGraphicsItem*> items(const QGraphicsScene* scene, const QRectF& rect,
+									   Qt::ItemSelectionMode mode = Qt::IntersectsItemShape);
+	// Самый верхний элемент под точкой, включая дочерние - как QGraphicsScene::itemAt
+	static QGraphicsItem* itemAt(const QGraphicsScene* scene, const QPointF& pos);
+	// Элемент (в том числе дочерний) по SceneSerializer::ItemIdKey; nullptr - в индексе такого id нет
+	static QGraphicsItem* findById(const QGraphicsScene* scene, quint64 id);
+
+	int count() const { return tree_.count(); }
+
+  private:
+	explicit SceneIndex(QGraphicsScene* scene);
+
+	struct Entry
+	{
+		int proxy;
+		quint64 order; // порядок добавления - второй ключ стопки после zValue
+	};
+
+	QGraphicsScene* scene_;
+	AabbTree tree_;
+	QHash<QGraphicsItem*, Entry> entries_;
+	QHash<quint64, QGraphicsItem*> ids_; // id элемента и всех его потомков
+	quint64 nextOrder_ = 0;
+
+	void updateItem(QGraphicsItem* item);
+	void removeItem(QGraphicsItem* item);
+	void rebuildIndex();
+	void registerIds(QGraphicsItem* item);
+	void unregisterIds(QGraphicsItem* item);
+	QList<QGraphicsItem*> query(const QRectF& rect, Qt::ItemSelectionMode mode) const;
+	QGraphicsItem* hitTest(const QPointF& pos) const;
+	void sortByStacking(QList<QGraphicsItem*>& items) const;
+
+	static QRectF itemBounds(const QGraphicsItem* item);
+};
+
+#endif // SCENEINDEX_H
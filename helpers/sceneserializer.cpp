@@ -0,0 +1,822 @@
+#include "sceneserializer.h"
+#include "sceneexporter.h"
+#include "../items/imageitem.h"
+#include "../items/instanceitem.h"
+#include "../items/rasterlayeritem.h"
+#include "../items/strokeitem.h"
+
+#include <QBuffer>
+#include <QCborArray>
+#include <QCborStreamReader>
+#include <QCborStreamWriter>
+#include <QCborValue>
+#include <QFileInfo>
+#include <QFont>
+#include <QGraphicsItemGroup>
+#include <QGraphicsPixmapItem>
+#include <QGraphicsTextItem>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QPen>
+#include <QSet>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <functional>
+
+namespace
+{
+	const QString FormatName = QStringLiteral("texteditor-scene");
+	const int FormatVersion = 1;
+
+	// PNG кодируются заранее, пачкой в пуле потоков; здесь лежат готовые байты
+	using EncodedImages = QHash<const QGraphicsItem*, QList<QByteArray>>;
+
+	// При загрузке картинки декодируются в том же порядке, в каком их потом заберут элементы
+	struct DecodedImages
+	{
+		QList<QImage> images;
+		int next = 0;
+	};
+
+	struct ImageJob
+	{
+		const QGraphicsItem* item;
+		QImage image;
+	};
+
+	QCborArray pointToArray(const QPointF& point) { return {point.x(), point.y()}; }
+
+	QPointF pointFromArray(const QCborValue& value)
+	{
+		const QCborArray array = value.toArray();
+		return QPointF(array.at(0).toDouble(), array.at(1).toDouble());
+	}
+
+	QCborArray rectToArray(const QRectF& rect) { return {rect.x(), rect.y(), rect.width(), rect.height()}; }
+
+	QRectF rectFromArray(const QCborValue& value)
+	{
+		const QCborArray array = value.toArray();
+		return QRectF(array.at(0).toDouble(), array.at(1).toDouble(), array.at(2).toDouble(), array.at(3).toDouble());
+	}
+
+	QCborArray polygonToArray(const QPolygonF& polygon)
+	{
+		QCborArray array;
+		for (const QPointF& point : polygon)
+		{
+			array.append(point.x());
+			array.append(point.y());
+		}
+		return array;
+	}
+
+	QPolygonF polygonFromArray(const QCborValue& value)
+	{
+		const QCborArray array = value.toArray();
+		QPolygonF polygon;
+		polygon.reserve(array.size() / 2);
+		for (qsizetype i = 0; i + 1 < array.size(); i += 2)
+			polygon.append(QPointF(array.at(i).toDouble(), array.at(i + 1).toDouble()));
+		return polygon;
+	}
+
+	QCborArray numbersToArray(const QList<qreal>& numbers)
+	{
+		QCborArray array;
+		for (qreal number : numbers)
+			array.append(number);
+		return array;
+	}
+
+	QList<qreal> numbersFromArray(const QCborValue& value)
+	{
+		const QCborArray array = value.toArray();
+		QList<qreal> numbers;
+		numbers.reserve(array.size());
+		for (const QCborValue& number : array)
+			numbers.append(number.toDouble());
+		return numbers;
+	}
+
+	QCborArray pathToArray(const QPainterPath& path)
+	{
+		QCborArray array;
+		for (int i = 0; i < path.elementCount(); ++i)
+		{
+			const QPainterPath::Element element = path.elementAt(i);
+			array.append(qint64(element.type));
+			array.append(element.x);
+			array.append(element.y);
+		}
+		return array;
+	}
+
+	QPainterPath pathFromArray(const QCborValue& value)
+	{
+		const QCborArray array = value.toArray();
+		QPainterPath path;
+		for (qsizetype i = 0; i + 2 < array.size(); i += 3)
+		{
+			const auto type = QPainterPath::ElementType(array.at(i).toInteger());
+			const QPointF point(array.at(i + 1).toDouble(), array.at(i + 2).toDouble());
+			if (type == QPainterPath::MoveToElement)
+				path.moveTo(point);
+			else if (type == QPainterPath::LineToElement)
+				path.lineTo(point);
+			else if (type == QPainterPath::CurveToElement && i + 8 < array.size())
+			{
+				const QPointF c2(array.at(i + 4).toDouble(), array.at(i + 5).toDouble());
+				const QPointF end(array.at(i + 7).toDouble(), array.at(i + 8).toDouble());
+				path.cubicTo(point, c2, end);
+				i += 6;
+			}
+		}
+		return path;
+	}
+
+	QCborMap penToCbor(const QPen& pen)
+	{
+		QCborMap map;
+		map[QStringLiteral("color")] = qint64(pen.color().rgba());
+		map[QStringLiteral("width")] = pen.widthF();
+		map[QStringLiteral("style")] = qint64(pen.style());
+		map[QStringLiteral("cap")] = qint64(pen.capStyle());
+		map[QStringLiteral("join")] = qint64(pen.joinStyle());
+		return map;
+	}
+
+	QPen penFromCbor(const QCborValue& value)
+	{
+		const QCborMap map = value.toMap();
+		QPen pen(QColor::fromRgba(QRgb(map.value(QStringLiteral("color")).toInteger())));
+		pen.setWidthF(map.value(QStringLiteral("width")).toDouble(1));
+		pen.setStyle(Qt::PenStyle(map.value(QStringLiteral("style")).toInteger(Qt::SolidLine)));
+		pen.setCapStyle(Qt::PenCapStyle(map.value(QStringLiteral("cap")).toInteger(Qt::SquareCap)));
+		pen.setJoinStyle(Qt::PenJoinStyle(map.value(QStringLiteral("join")).toInteger(Qt::BevelJoin)));
+		return pen;
+	}
+
+	QCborMap brushToCbor(const QBrush& brush)
+	{
+		QCborMap map;
+		map[QStringLiteral("color")] = qint64(brush.color().rgba());
+		map[QStringLiteral("style")] = qint64(brush.style());
+		return map;
+	}
+
+	QBrush brushFromCbor(const QCborValue& value)
+	{
+		const QCborMap map = value.toMap();
+		return QBrush(QColor::fromRgba(QRgb(map.value(QStringLiteral("color")).toInteger())),
+					  Qt::BrushStyle(map.value(QStringLiteral("style")).toInteger(Qt::NoBrush)));
+	}
+
+	QByteArray encodeImage(const QImage& image)
+	{
+		QByteArray data;
+		QBuffer buffer(&data);
+		buffer.open(QIODevice::WriteOnly);
+		image.save(&buffer, "PNG");
+		return data;
+	}
+
+	QImage decodeImage(const QByteArray& data) { return QImage::fromData(data); }
+
+	// В JSON байтовые строки превращаются в base64url
+	QByteArray blobFromValue(const QCborValue& value)
+	{
+		if (value.isByteArray())
+			return value.toByteArray();
+		return QByteArray::fromBase64(value.toString().toLatin1(), QByteArray::Base64UrlEncoding);
+	}
+
+	QImage takeImage(const QCborValue& value, DecodedImages* decoded)
+	{
+		if (decoded && decoded->next < decoded->images.size())
+			return decoded->images[decoded->next++];
+		return decodeImage(blobFromValue(value));
+	}
+
+	QByteArray encodedImage(const QGraphicsItem* item, int index, const EncodedImages* encoded, const QPoint& tile = QPoint())
+	{
+		if (encoded)
+		{
+			auto it = encoded->constFind(item);
+			if (it != encoded->constEnd() && index < it->size())
+				return it->at(index);
+		}
+		if (auto pixmapItem = qgraphicsitem_cast<const QGraphicsPixmapItem*>(item))
+			return encodeImage(pixmapItem->pixmap().toImage());
+		if (auto raster = qgraphicsitem_cast<const RasterLayerItem*>(item))
+			return encodeImage(raster->tileImage(tile));
+		return QByteArray();
+	}
+
+	void writeCommon(const QGraphicsItem* item, QCborMap& map)
+	{
+		map[QStringLiteral("pos")] = pointToArray(item->pos());
+		if (item->rotation() != 0)
+			map[QStringLiteral("rotation")] = item->rotation();
+		if (item->scale() != 1)
+			map[QStringLiteral("scale")] = item->scale();
+		if (!item->transformOriginPoint().isNull())
+			map[QStringLiteral("origin")] = pointToArray(item->transformOriginPoint());
+		if (item->zValue() != 0)
+			map[QStringLiteral("z")] = item->zValue();
+		if (item->opacity() != 1)
+			map[QStringLiteral("opacity")] = item->opacity();
+		if (!item->transform().isIdentity())
+		{
+			const QTransform t = item->transform();
+			map[QStringLiteral("transform")] =
+				QCborArray{t.m11(), t.m12(), t.m13(), t.m21(), t.m22(), t.m23(), t.m31(), t.m32(), t.m33()};
+		}
+		map[QStringLiteral("flags")] = qint64(item->flags().toInt());
+		const QVariant id = item->data(SceneSerializer::ItemIdKey);
+		if (id.isValid())
+			map[QStringLiteral("id")] = qint64(id.toULongLong());
+	}
+
+	void readCommon(const QCborMap& map, QGraphicsItem* item)
+	{
+		item->setPos(pointFromArray(map.value(QStringLiteral("pos"))));
+		item->setRotation(map.value(QStringLiteral("rotation")).toDouble(0));
+		item->setScale(map.value(QStringLiteral("scale")).toDouble(1));
+		if (map.contains(QStringLiteral("origin")))
+			item->setTransformOriginPoint(pointFromArray(map.value(QStringLiteral("origin"))));
+		item->setZValue(map.value(QStringLiteral("z")).toDouble(0));
+		item->setOpacity(map.value(QStringLiteral("opacity")).toDouble(1));
+		const QCborArray t = map.value(QStringLiteral("transform")).toArray();
+		if (t.size() == 9)
+			item->setTransform(QTransform(t.at(0).toDouble(), t.at(1).toDouble(), t.at(2).toDouble(),
+										  t.at(3).toDouble(), t.at(4).toDouble(), t.at(5).toDouble(),
+										  t.at(6).toDouble(), t.at(7).toDouble(), t.at(8).toDouble()));
+		item->setFlags(QGraphicsItem::GraphicsItemFlags::fromInt(int(map.value(QStringLiteral("flags")).toInteger())));
+		if (map.contains(QStringLiteral("id")))
+			item->setData(SceneSerializer::ItemIdKey, quint64(map.value(QStringLiteral("id")).toInteger()));
+	}
+
+	QCborMap writeItem(const QGraphicsItem* item, const EncodedImages* encoded)
+	{
+		QCborMap map;
+		if (auto stroke = qgraphicsitem_cast<const StrokeItem*>(item))
+		{
+			map[QStringLiteral("type")] = QStringLiteral("stroke");
+			map[QStringLiteral("pen")] = penToCbor(stroke->pen());
+			map[QStringLiteral("points")] = polygonToArray(stroke->points());
+			map[QStringLiteral("smooth")] = stroke->isSmoothed();
+			if (stroke->hasVariableWidth())
+				map[QStringLiteral("widths")] = numbersToArray(stroke->widths());
+		}
+		else if (auto pathItem = qgraphicsitem_cast<const QGraphicsPathItem*>(item))
+		{
+			map[QStringLiteral("type")] = QStringLiteral("path");
+			map[QStringLiteral("pen")] = penToCbor(pathItem->pen());
+			map[QStringLiteral("brush")] = brushToCbor(pathItem->brush());
+			map[QStringLiteral("path")] = pathToArray(pathItem->path());
+			map[QStringLiteral("fillRule")] = qint64(pathItem->path().fillRule());
+		}
+		else if (auto rectItem = qgraphicsitem_cast<const QGraphicsRectItem*>(item))
+		{
+			map[QStringLiteral("type")] = QStringLiteral("rect");
+			map[QStringLiteral("pen")] = penToCbor(rectItem->pen());
+			map[QStringLiteral("brush")] = brushToCbor(rectItem->brush());
+			map[QStringLiteral("rect")] = rectToArray(rectItem->rect());
+		}
+		else if (auto ellipseItem = qgraphicsitem_cast<const QGraphicsEllipseItem*>(item))
+		{
+			map[QStringLiteral("type")] = QStringLiteral("ellipse");
+			map[QStringLiteral("pen")] = penToCbor(ellipseItem->pen());
+			map[QStringLiteral("brush")] = brushToCbor(ellipseItem->brush());
+			map[QStringLiteral("rect")] = rectToArray(ellipseItem->rect());
+			map[QStringLiteral("startAngle")] = qint64(ellipseItem->startAngle());
+			map[QStringLiteral("spanAngle")] = qint64(ellipseItem->spanAngle());
+		}
+		else if (auto lineItem = qgraphicsitem_cast<const QGraphicsLineItem*>(item))
+		{
+			const QLineF line = lineItem->line();
+			map[QStringLiteral("type")] = QStringLiteral("line");
+			map[QStringLiteral("pen")] = penToCbor(lineItem->pen());
+			map[QStringLiteral("line")] = QCborArray{line.x1(), line.y1(), line.x2(), line.y2()};
+		}
+		else if (auto polygonItem = qgraphicsitem_cast<const QGraphicsPolygonItem*>(item))
+		{
+			map[QStringLiteral("type")] = QStringLiteral("polygon");
+			map[QStringLiteral("pen")] = penToCbor(polygonItem->pen());
+			map[QStringLiteral("brush")] = brushToCbor(polygonItem->brush());
+			map[QStringLiteral("points")] = polygonToArray(polygonItem->polygon());
+			map[QStringLiteral("fillRule")] = qint64(polygonItem->fillRule());
+		}
+		else if (auto pixmapItem = qgraphicsitem_cast<const QGraphicsPixmapItem*>(item))
+		{
+			map[QStringLiteral("type")] = QStringLiteral("pixmap");
+			map[QStringLiteral("image")] = encodedImage(item, 0, encoded);
+			map[QStringLiteral("offset")] = pointToArray(pixmapItem->offset());
+			map[QStringLiteral("smooth")] = pixmapItem->transformationMode() == Qt::SmoothTransformation;
+		}
+		else if (auto imageItem = qgraphicsitem_cast<const ImageItem*>(item))
+		{
+			// Исходный файл как есть - без перекодирования и потери качества
+			map[QStringLiteral("type")] = QStringLiteral("image");
+			map[QStringLiteral("data")] = imageItem->sourceData();
+		}
+		else if (auto textItem = qgraphicsitem_cast<const QGraphicsTextItem*>(item))
+		{
+			map[QStringLiteral("type")] = QStringLiteral("text");
+			map[QStringLiteral("html")] = textItem->toHtml();
+			map[QStringLiteral("font")] = textItem->font().toString();
+			map[QStringLiteral("color")] = qint64(textItem->defaultTextColor().rgba());
+			map[QStringLiteral("textWidth")] = textItem->textWidth();
+		}
+		else if (auto raster = qgraphicsitem_cast<const RasterLayerItem*>(item))
+		{
+			QCborArray tiles;
+			const QList<QPoint> coordinates = raster->tileCoordinates();
+			for (int i = 0; i < coordinates.size(); ++i)
+			{
+				QCborMap tile;
+				tile[QStringLiteral("x")] = coordinates[i].x();
+				tile[QStringLiteral("y")] = coordinates[i].y();
+				tile[QStringLiteral("image")] = encodedImage(item, i, encoded, coordinates[i]);
+				tiles.append(tile);
+			}
+			map[QStringLiteral("type")] = QStringLiteral("raster");
+			map[QStringLiteral("tiles")] = tiles;
+		}
+		else if (auto instance = qgraphicsitem_cast<const InstanceItem*>(item))
+		{
+			// Источник общий для всех копий; в файле он пишется только у первой
+			map[QStringLiteral("type")] = QStringLiteral("instance");
+			map[QStringLiteral("sourceId")] = qint64(instance->source()->id());
+			map[QStringLiteral("source")] = instance->source()->map();
+		}
+		else if (auto group = qgraphicsitem_cast<const QGraphicsItemGroup*>(item))
+		{
+			QCborArray children;
+			const QList<QGraphicsItem*> childItems = group->childItems();
+			for (const QGraphicsItem* child : childItems)
+			{
+				QCborMap childMap = writeItem(child, encoded);
+				if (!childMap.isEmpty())
+					children.append(childMap);
+			}
+			map[QStringLiteral("type")] = QStringLiteral("group");
+			map[QStringLiteral("children")] = children;
+		}
+		else
+		{
+			return QCborMap();
+		}
+
+		writeCommon(item, map);
+		return map;
+	}
+
+	QGraphicsItem* readItem(const QCborMap& map, DecodedImages* decoded)
+	{
+		const QString type = map.value(QStringLiteral("type")).toString();
+		QGraphicsItem* item = nullptr;
+
+		if (type == QLatin1String("stroke"))
+		{
+			auto stroke = new StrokeItem(penFromCbor(map.value(QStringLiteral("pen"))), QPointF());
+			stroke->setPoints(polygonFromArray(map.value(QStringLiteral("points"))),
+							  map.value(QStringLiteral("smooth")).toBool(),
+							  numbersFromArray(map.value(QStringLiteral("widths"))));
+			item = stroke;
+		}
+		else if (type == QLatin1String("path"))
+		{
+			QPainterPath path = pathFromArray(map.value(QStringLiteral("path")));
+			path.setFillRule(Qt::FillRule(map.value(QStringLiteral("fillRule")).toInteger(Qt::OddEvenFill)));
+			auto pathItem = new QGraphicsPathItem(path);
+			pathItem->setPen(penFromCbor(map.value(QStringLiteral("pen"))));
+			pathItem->setBrush(brushFromCbor(map.value(QStringLiteral("brush"))));
+			item = pathItem;
+		}
+		else if (type == QLatin1String("rect"))
+		{
+			auto rectItem = new QGraphicsRectItem(rectFromArray(map.value(QStringLiteral("rect"))));
+			rectItem->setPen(penFromCbor(map.value(QStringLiteral("pen"))));
+			rectItem->setBrush(brushFromCbor(map.value(QStringLiteral("brush"))));
+			item = rectItem;
+		}
+		else if (type == QLatin1String("ellipse"))
+		{
+			auto ellipseItem = new QGraphicsEllipseItem(rectFromArray(map.value(QStringLiteral("rect"))));
+			ellipseItem->setPen(penFromCbor(map.value(QStringLiteral("pen"))));
+			ellipseItem->setBrush(brushFromCbor(map.value(QStringLiteral("brush"))));
+			ellipseItem->setStartAngle(int(map.value(QStringLiteral("startAngle")).toInteger(0)));
+			ellipseItem->setSpanAngle(int(map.value(QStringLiteral("spanAngle")).toInteger(360 * 16)));
+			item = ellipseItem;
+		}
+		else if (type == QLatin1String("line"))
+		{
+			const QCborArray line = map.value(QStringLiteral("line")).toArray();
+			auto lineItem = new QGraphicsLineItem(line.at(0).toDouble(), line.at(1).toDouble(),
+												  line.at(2).toDouble(), line.at(3).toDouble());
+			lineItem->setPen(penFromCbor(map.value(QStringLiteral("pen"))));
+			item = lineItem;
+		}
+		else if (type == QLatin1String("polygon"))
+		{
+			auto polygonItem = new QGraphicsPolygonItem(polygonFromArray(map.value(QStringLiteral("points"))));
+			polygonItem->setPen(penFromCbor(map.value(QStringLiteral("pen"))));
+			polygonItem->setBrush(brushFromCbor(map.value(QStringLiteral("brush"))));
+			polygonItem->setFillRule(Qt::FillRule(map.value(QStringLiteral("fillRule")).toInteger(Qt::OddEvenFill)));
+			item = polygonItem;
+		}
+		else if (type == QLatin1String("pixmap"))
+		{
+			auto pixmapItem = new QGraphicsPixmapItem(QPixmap::fromImage(takeImage(map.value(QStringLiteral("image")), decoded)));
+			pixmapItem->setOffset(pointFromArray(map.value(QStringLiteral("offset"))));
+			if (map.value(QStringLiteral("smooth")).toBool())
+				pixmapItem->setTransformationMode(Qt::SmoothTransformation);
+			item = pixmapItem;
+		}
+		else if (type == QLatin1String("image"))
+		{
+			item = new ImageItem(blobFromValue(map.value(QStringLiteral("data"))));
+		}
+		else if (type == QLatin1String("text"))
+		{
+			auto textItem = new QGraphicsTextItem();
+			QFont font;
+			font.fromString(map.value(QStringLiteral("font")).toString());
+			textItem->setFont(font);
+			textItem->setHtml(map.value(QStringLiteral("html")).toString());
+			textItem->setDefaultTextColor(QColor::fromRgba(QRgb(map.value(QStringLiteral("color")).toInteger())));
+			textItem->setTextWidth(map.value(QStringLiteral("textWidth")).toDouble(-1));
+			item = textItem;
+		}
+		else if (type == QLatin1String("raster"))
+		{
+			auto raster = new RasterLayerItem();
+			const QCborArray tiles = map.value(QStringLiteral("tiles")).toArray();
+			for (const QCborValue& value : tiles)
+			{
+				const QCborMap tile = value.toMap();
+				const QImage image = takeImage(tile.value(QStringLiteral("image")), decoded);
+				if (!image.isNull())
+					raster->setTileImage(QPoint(int(tile.value(QStringLiteral("x")).toInteger()),
+												int(tile.value(QStringLiteral("y")).toInteger())), image);
+			}
+			item = raster;
+		}
+		else if (type == QLatin1String("instance"))
+		{
+			// Картинки источника декодируются им самим, а не пачкой: он может быть уже загружен
+			const quint64 sourceId = quint64(map.value(QStringLiteral("sourceId")).toInteger());
+			QSharedPointer<InstanceSource> source = InstanceSource::find(sourceId);
+			if (!source && map.contains(QStringLiteral("source")))
+				source = InstanceSource::create(map.value(QStringLiteral("source")).toMap(), sourceId);
+			if (source)
+				item = new InstanceItem(source);
+		}
+		else if (type == QLatin1String("group"))
+		{
+			// Пока группа в начале координат, локальные координаты детей совпадают с сохранёнными
+			auto group = new QGraphicsItemGroup();
+			const QCborArray children = map.value(QStringLiteral("children")).toArray();
+			for (const QCborValue& value : children)
+				if (QGraphicsItem* child = readItem(value.toMap(), decoded))
+					group->addToGroup(child);
+			item = group;
+		}
+
+		if (item)
+			readCommon(map, item);
+		return item;
+	}
+
+	void collectImages(const QGraphicsItem* item, QList<ImageJob>& jobs)
+	{
+		if (auto pixmapItem = qgraphicsitem_cast<const QGraphicsPixmapItem*>(item))
+		{
+			jobs.append({item, pixmapItem->pixmap().toImage()});
+		}
+		else if (auto raster = qgraphicsitem_cast<const RasterLayerItem*>(item))
+		{
+			for (const QPoint& tile : raster->tileCoordinates())
+				jobs.append({item, raster->tileImage(tile)});
+		}
+		else if (qgraphicsitem_cast<const QGraphicsItemGroup*>(item))
+		{
+			for (const QGraphicsItem* child : item->childItems())
+				collectImages(child, jobs);
+		}
+	}
+
+	void collectBlobs(const QCborMap& map, QList<QByteArray>& blobs)
+	{
+		const QString type = map.value(QStringLiteral("type")).toString();
+		if (type == QLatin1String("pixmap"))
+		{
+			blobs.append(blobFromValue(map.value(QStringLiteral("image"))));
+		}
+		else if (type == QLatin1String("raster"))
+		{
+			const QCborArray tiles = map.value(QStringLiteral("tiles")).toArray();
+			for (const QCborValue& tile : tiles)
+				blobs.append(blobFromValue(tile.toMap().value(QStringLiteral("image"))));
+		}
+		else if (type == QLatin1String("group"))
+		{
+			const QCborArray children = map.value(QStringLiteral("children")).toArray();
+			for (const QCborValue& child : children)
+				collectBlobs(child.toMap(), blobs);
+		}
+	}
+
+	// Копии одного источника идут подряд по файлу - источник достаточно записать у первой
+	QCborMap dropRepeatedSource(QCborMap map, QSet<quint64>& writtenSources)
+	{
+		if (map.value(QStringLiteral("type")).toString() != QLatin1String("instance"))
+			return map;
+		const quint64 sourceId = quint64(map.value(QStringLiteral("sourceId")).toInteger());
+		if (writtenSources.contains(sourceId))
+			map.remove(QStringLiteral("source"));
+		else
+			writtenSources.insert(sourceId);
+		return map;
+	}
+
+	EncodedImages encodeImages(const QList<QGraphicsItem*>& items)
+	{
+		QList<ImageJob> jobs;
+		for (const QGraphicsItem* item : items)
+			collectImages(item, jobs);
+
+		const QList<QByteArray> blobs = QtConcurrent::blockingMapped<QList<QByteArray>>(
+			jobs, [](const ImageJob& job) { return encodeImage(job.image); });
+
+		EncodedImages encoded;
+		for (int i = 0; i < jobs.size(); ++i)
+			encoded[jobs[i].item].append(blobs[i]);
+		return encoded;
+	}
+
+	QString readKey(QCborStreamReader& reader)
+	{
+		QString key;
+		if (!reader.isString())
+		{
+			QCborValue::fromCbor(reader);
+			return key;
+		}
+		auto chunk = reader.readString();
+		while (chunk.status == QCborStreamReader::Ok)
+		{
+			key += chunk.data;
+			chunk = reader.readString();
+		}
+		return key;
+	}
+
+	// Заголовок должен лежать до элементов: save всегда пишет его первым
+	struct ItemSink
+	{
+		std::function<bool(const QCborMap& header)> begin;
+		std::function<void(const QCborMap& map)> item;
+	};
+
+	// Элементы собираются пачками: картинки пачки декодируются параллельно,
+	// после сборки карты пачки отпускаются - в памяти не держится весь документ
+	class ItemBatch
+	{
+	  public:
+		static constexpr int MaxItems = 64;
+		static constexpr qsizetype MaxBlobBytes = 32 * 1024 * 1024;
+
+		explicit ItemBatch(QGraphicsScene* scene) : scene_(scene) {}
+
+		void append(const QCborMap& map)
+		{
+			maps_.append(map);
+			const qsizetype first = blobs_.size();
+			collectBlobs(map, blobs_);
+			for (qsizetype i = first; i < blobs_.size(); ++i)
+				blobBytes_ += blobs_[i].size();
+			if (maps_.size() >= MaxItems || blobBytes_ >= MaxBlobBytes)
+				flush();
+		}
+
+		void flush()
+		{
+			DecodedImages decoded;
+			decoded.images = QtConcurrent::blockingMapped<QList<QImage>>(blobs_, decodeImage);
+			for (const QCborMap& map : std::as_const(maps_))
+				if (QGraphicsItem* item = readItem(map, &decoded))
+					scene_->addItem(item);
+			maps_.clear();
+			blobs_.clear();
+			blobBytes_ = 0;
+		}
+
+	  private:
+		QGraphicsScene* scene_;
+		QList<QCborMap> maps_;
+		QList<QByteArray> blobs_;
+		qsizetype blobBytes_ = 0;
+	};
+
+	bool readCbor(QIODevice* device, QCborMap& header, const ItemSink& sink, QString* errorString)
+	{
+		QCborStreamReader reader(device);
+		if (reader.isTag() && reader.toTag() == QCborKnownTags::Signature)
+			reader.next();
+
+		if (!reader.isMap())
+		{
+			if (errorString)
+				*errorString = QObject::tr("The file is not a scene.");
+			return false;
+		}
+
+		// Каждый элемент отдаётся, как только прочитана его карта; весь документ в памяти не строится
+		reader.enterContainer();
+		while (reader.lastError() == QCborError::NoError && reader.hasNext())
+		{
+			const QString key = readKey(reader);
+			if (key == QLatin1String("items") && reader.isArray())
+			{
+				if (!sink.begin(header))
+					return false;
+				reader.enterContainer();
+				while (reader.lastError() == QCborError::NoError && reader.hasNext())
+					sink.item(QCborValue::fromCbor(reader).toMap());
+				reader.leaveContainer();
+			}
+			else
+			{
+				header.insert(key, QCborValue::fromCbor(reader));
+			}
+		}
+		if (reader.lastError() == QCborError::NoError)
+			reader.leaveContainer();
+
+		if (reader.lastError() != QCborError::NoError)
+		{
+			if (errorString)
+				*errorString = reader.lastError().toString();
+			return false;
+		}
+		return true;
+	}
+
+	// Потокового чтения JSON в Qt нет: документ разбирается целиком, элементы отдаются по одному
+	bool readJson(QIODevice* device, QCborMap& header, const ItemSink& sink, QString* errorString)
+	{
+		QJsonParseError parseError;
+		QJsonDocument document = QJsonDocument::fromJson(device->readAll(), &parseError);
+		if (parseError.error != QJsonParseError::NoError || !document.isObject())
+		{
+			if (errorString)
+				*errorString = parseError.errorString();
+			return false;
+		}
+
+		QJsonObject object = document.object();
+		document = QJsonDocument();
+		const QJsonArray array = object.take(QStringLiteral("items")).toArray();
+		header = QCborMap::fromJsonObject(object);
+		if (!sink.begin(header))
+			return false;
+		for (const QJsonValue& value : array)
+			sink.item(QCborMap::fromJsonObject(value.toObject()));
+		return true;
+	}
+}
+
+SceneSerializer::Format SceneSerializer::formatForFile(const QString& filePath)
+{
+	return QFileInfo(filePath).suffix().toLower() == QLatin1String("cbor") ? Format::Cbor : Format::Json;
+}
+
+QList<QGraphicsItem*> SceneSerializer::topLevelItems(const QGraphicsScene* scene)
+{
+	QList<QGraphicsItem*> result;
+	const QList<QGraphicsItem*> items = scene->items(Qt::AscendingOrder);
+	for (QGraphicsItem* item : items)
+		if (!item->parentItem())
+			result.append(item);
+	return result;
+}
+
+bool SceneSerializer::save(const QGraphicsScene* scene, QIODevice* device, Format format, QString* errorString)
+{
+	if (!device->isWritable())
+	{
+		if (errorString)
+			*errorString = device->errorString();
+		return false;
+	}
+
+	const QList<QGraphicsItem*> items = topLevelItems(scene);
+	const EncodedImages encoded = encodeImages(items);
+	QSet<quint64> writtenSources;
+
+	QCborMap header;
+	header[QStringLiteral("format")] = FormatName;
+	header[QStringLiteral("version")] = FormatVersion;
+	header[QStringLiteral("background")] = qint64(scene->backgroundBrush().color().rgba());
+	header[QStringLiteral("sceneRect")] = rectToArray(SceneExporter::page(scene));
+
+	if (format == Format::Cbor)
+	{
+		QCborStreamWriter writer(device);
+		writer.append(QCborKnownTags::Signature);
+		writer.startMap();
+		for (auto it = header.constBegin(); it != header.constEnd(); ++it)
+		{
+			QCborValue(it.key()).toCbor(writer);
+			QCborValue(it.value()).toCbor(writer);
+		}
+		writer.append(QLatin1String("items"));
+		writer.startArray(quint64(items.size()));
+		for (const QGraphicsItem* item : items)
+			QCborValue(dropRepeatedSource(writeItem(item, &encoded), writtenSources)).toCbor(writer);
+		writer.endArray();
+		writer.endMap();
+	}
+	else
+	{
+		// JSON пишется кусками: заголовок, затем каждый элемент отдельно
+		QByteArray head = QJsonDocument(header.toJsonObject()).toJson(QJsonDocument::Compact);
+		head.chop(1);
+		head += ",\"items\":[";
+		device->write(head);
+		for (int i = 0; i < items.size(); ++i)
+		{
+			if (i > 0)
+				device->write(",");
+			const QCborMap map = dropRepeatedSource(writeItem(items[i], &encoded), writtenSources);
+			device->write(QJsonDocument(map.toJsonObject()).toJson(QJsonDocument::Compact));
+		}
+		device->write("]}\n");
+	}
+
+	return true;
+}
+
+bool SceneSerializer::load(QGraphicsScene* scene, QIODevice* device, QString* errorString)
+{
+	// Сцена очищается только после проверки заголовка; ошибка посреди элементов оставляет прочитанное
+	ItemBatch batch(scene);
+	bool isStarted = false;
+	ItemSink sink;
+	sink.begin = [&](const QCborMap& header)
+	{
+		if (header.value(QStringLiteral("format")).toString() != FormatName)
+		{
+			if (errorString)
+				*errorString = QObject::tr("The file is not a scene.");
+			return false;
+		}
+
+		scene->clear();
+		if (header.contains(QStringLiteral("background")))
+			scene->setBackgroundBrush(QColor::fromRgba(QRgb(header.value(QStringLiteral("background")).toInteger())));
+		if (header.contains(QStringLiteral("sceneRect")))
+			SceneExporter::setPage(scene, rectFromArray(header.value(QStringLiteral("sceneRect"))));
+		isStarted = true;
+		return true;
+	};
+	sink.item = [&batch](const QCborMap& map) { batch.append(map); };
+
+	QCborMap header;
+	const QByteArray head = device->peek(1);
+	const bool isCbor = !head.isEmpty() && (uchar(head[0]) == 0xd9 || (uchar(head[0]) & 0xe0) == 0xa0);
+	const bool isRead = isCbor ? readCbor(device, header, sink, errorString) : readJson(device, header, sink, errorString);
+	batch.flush();
+	if (!isRead)
+		return false;
+
+	// Сцена без массива элементов
+	return isStarted || sink.begin(header);
+}
+
+QCborMap SceneSerializer::itemToCbor(const QGraphicsItem* item) { return writeItem(item, nullptr); }
+
+QGraphicsItem* SceneSerializer::itemFromCbor(const QCborMap& map) { return readItem(map, nullptr); }
+
+QByteArray SceneSerializer::itemsToBytes(const QList<QGraphicsItem*>& items)
+{
+	QCborArray array;
+	QSet<quint64> writtenSources;
+	for (const QGraphicsItem* item : items)
+		array.append(dropRepeatedSource(writeItem(item, nullptr), writtenSources));
+	return QCborValue(array).toCbor();
+}
+
+QList<QGraphicsItem*> SceneSerializer::itemsFromBytes(const QByteArray& data)
+{
+	QList<QGraphicsItem*> items;
+	const QCborArray array = QCborValue::fromCbor(data).toArray();
+	for (const QCborValue& value : array)
+		if (QGraphicsItem* item = readItem(value.toMap(), nullptr))
+			items.append(item);
+	return items;
+}
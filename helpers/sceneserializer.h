@@ -0,0 +1,40 @@
+#ifndef SCENESERIALIZER_H
+#define SCENESERIALIZER_H
+
+#include <QCborMap>
+#include <QGraphicsItem>
+#include <QGraphicsScene>
+#include <QIODevice>
+#include <QList>
+
+// Сохранение и загрузка сцены. Внутреннее представление - CBOR; на диск оно
+// пишется либо как JSON (для обмена), либо как бинарный CBOR (быстрый формат).
+// Картинки хранятся внутри файла в виде PNG.
+class SceneSerializer
+{
+  public:
+	enum class Format
+	{
+		Json,
+		Cbor
+	};
+
+	// Ключ data() с постоянным id элемента; id сохраняется вместе с элементом
+	static constexpr int ItemIdKey = 0x4944;
+
+	static Format formatForFile(const QString& filePath);
+
+	static bool save(const QGraphicsScene* scene, QIODevice* device, Format format, QString* errorString = nullptr);
+	static bool load(QGraphicsScene* scene, QIODevice* device, QString* errorString = nullptr);
+
+	static QCborMap itemToCbor(const QGraphicsItem* item);
+	static QGraphicsItem* itemFromCbor(const QCborMap& map);
+
+	// Компактная форма для списка элементов (бинарный CBOR)
+	static QByteArray itemsToBytes(const QList<QGraphicsItem*>& items);
+	static QList<QGraphicsItem*> itemsFromBytes(const QByteArray& data);
+
+	static QList<QGraphicsItem*> topLevelItems(const QGraphicsScene* scene);
+};
+
+#endif // SCENESERIALIZER_H
@@ -0,0 +1,1374 @@
+#include "scenesvg.h"
+#include "pathsimplifier.h"
+#include "sceneexporter.h"
+#include "sceneserializer.h"
+#include "../items/imageitem.h"
+#include "../items/instanceitem.h"
+#include "../items/rasterlayeritem.h"
+#include "../items/strokeitem.h"
+
+#include <QBuffer>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QFontInfo>
+#include <QFontMetricsF>
+#include <QGraphicsEllipseItem>
+#include <QGraphicsItemGroup>
+#include <QGraphicsLineItem>
+#include <QGraphicsPathItem>
+#include <QGraphicsPixmapItem>
+#include <QGraphicsPolygonItem>
+#include <QGraphicsRectItem>
+#include <QGraphicsTextItem>
+#include <QImageReader>
+#include <QPainterPath>
+#include <QPen>
+#include <QTextDocument>
+#include <QVarLengthArray>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+#include <QtMath>
+
+#include <memory>
+
+namespace
+{
+	const QString SvgNamespace = QStringLiteral("http://www.w3.org/2000/svg");
+	const QString XlinkNamespace = QStringLiteral("http://www.w3.org/1999/xlink");
+	const QString BackgroundId = QStringLiteral("scene-background");
+
+	// Две цифры после запятой - сотая доля пикселя, без лишних нулей.
+	// QString::number на миллионах координат заметно медленнее
+	void appendNumber(QString& out, qreal value)
+	{
+		qint64 scaled = qRound64(value * 100);
+		if (scaled < 0)
+		{
+			out += QLatin1Char('-');
+			scaled = -scaled;
+		}
+		qint64 whole = scaled / 100;
+		const int fraction = int(scaled % 100);
+
+		char digits[20];
+		int count = 0;
+		do
+		{
+			digits[count++] = char('0' + whole % 10);
+			whole /= 10;
+		} while (whole > 0);
+		while (count > 0)
+			out += QLatin1Char(digits[--count]);
+
+		if (fraction != 0)
+		{
+			out += QLatin1Char('.');
+			out += QLatin1Char(char('0' + fraction / 10));
+			if (fraction % 10 != 0)
+				out += QLatin1Char(char('0' + fraction % 10));
+		}
+	}
+
+	QString number(qreal value)
+	{
+		QString result;
+		appendNumber(result, value);
+		return result;
+	}
+
+	void appendPoint(QString& out, qreal x, qreal y)
+	{
+		appendNumber(out, x);
+		out += QLatin1Char(' ');
+		appendNumber(out, y);
+	}
+
+	void appendPath(QString& out, const QPainterPath& path)
+	{
+		const int count = path.elementCount();
+		for (int i = 0; i < count; ++i)
+		{
+			const QPainterPath::Element& element = path.elementAt(i);
+			if (element.isMoveTo())
+			{
+				out += QLatin1Char('M');
+				appendPoint(out, element.x, element.y);
+			}
+			else if (element.isLineTo())
+			{
+				out += QLatin1Char('L');
+				appendPoint(out, element.x, element.y);
+			}
+			else if (element.isCurveTo() && i + 2 < count)
+			{
+				const QPainterPath::Element& c2 = path.elementAt(i + 1);
+				const QPainterPath::Element& end = path.elementAt(i + 2);
+				out += QLatin1Char('C');
+				appendPoint(out, element.x, element.y);
+				out += QLatin1Char(' ');
+				appendPoint(out, c2.x, c2.y);
+				out += QLatin1Char(' ');
+				appendPoint(out, end.x, end.y);
+				i += 2;
+			}
+		}
+	}
+
+	QString matrixString(const QTransform& t)
+	{
+		// Повороту нужны все знаки - сотых долей здесь мало
+		return QStringLiteral("matrix(%1 %2 %3 %4 %5 %6)")
+			.arg(t.m11(), 0, 'g', 9)
+			.arg(t.m12(), 0, 'g', 9)
+			.arg(t.m21(), 0, 'g', 9)
+			.arg(t.m22(), 0, 'g', 9)
+			.arg(t.dx(), 0, 'g', 9)
+			.arg(t.dy(), 0, 'g', 9);
+	}
+
+	QByteArray pngData(const QImage& image)
+	{
+		QByteArray data;
+		QBuffer buffer(&data);
+		buffer.open(QIODevice::WriteOnly);
+		image.save(&buffer, "PNG");
+		return data;
+	}
+
+	// Атрибуты стиля и их строковый ключ: одинаковый ключ - можно слить в один путь
+	struct Style
+	{
+		QXmlStreamAttributes attributes;
+		QString key;
+		bool mergeable = false;
+
+		void add(const QString& name, const QString& value)
+		{
+			attributes.append(name, value);
+			key += name;
+			key += QLatin1Char('=');
+			key += value;
+			key += QLatin1Char(';');
+		}
+
+		void addColor(const QString& name, const QColor& color)
+		{
+			add(name, color.name(QColor::HexRgb));
+			if (color.alpha() < 255)
+				add(name + QStringLiteral("-opacity"), number(color.alphaF()));
+		}
+	};
+
+	Style shapeStyle(const QGraphicsItem* item, const QPen& pen, const QBrush& brush, Qt::FillRule fillRule)
+	{
+		Style style;
+		if (brush.style() == Qt::NoBrush)
+		{
+			style.add(QStringLiteral("fill"), QStringLiteral("none"));
+		}
+		else
+		{
+			style.addColor(QStringLiteral("fill"), brush.color());
+			if (fillRule == Qt::OddEvenFill)
+				style.add(QStringLiteral("fill-rule"), QStringLiteral("evenodd"));
+		}
+
+		if (pen.style() == Qt::NoPen || pen.brush().style() == Qt::NoBrush)
+		{
+			style.add(QStringLiteral("stroke"), QStringLiteral("none"));
+		}
+		else
+		{
+			// Координаты пишутся в системе сцены, поэтому и толщина - с учётом масштаба элемента
+			const qreal scale = qSqrt(qAbs(item->sceneTransform().determinant()));
+			const qreal width = pen.isCosmetic() ? qMax<qreal>(1, pen.widthF()) : pen.widthF() * scale;
+			style.addColor(QStringLiteral("stroke"), pen.color());
+			style.add(QStringLiteral("stroke-width"), number(width));
+			style.add(QStringLiteral("stroke-linecap"), pen.capStyle() == Qt::RoundCap    ? QStringLiteral("round")
+														: pen.capStyle() == Qt::SquareCap ? QStringLiteral("square")
+																						  : QStringLiteral("butt"));
+			style.add(QStringLiteral("stroke-linejoin"), pen.joinStyle() == Qt::RoundJoin   ? QStringLiteral("round")
+														 : pen.joinStyle() == Qt::BevelJoin ? QStringLiteral("bevel")
+																							: QStringLiteral("miter"));
+			if (pen.style() != Qt::SolidLine)
+			{
+				// Штрихи пера заданы в толщинах пера
+				QStringList dashes;
+				for (qreal dash : pen.dashPattern())
+					dashes.append(number(dash * qMax<qreal>(1, width)));
+				style.add(QStringLiteral("stroke-dasharray"), dashes.join(QLatin1Char(' ')));
+			}
+		}
+
+		const qreal opacity = item->effectiveOpacity();
+		if (opacity < 1)
+			style.add(QStringLiteral("opacity"), number(opacity));
+
+		// Перекрытия внутри одного пути рисуются один раз - сливаем только непрозрачные контуры без заливки
+		style.mergeable = brush.style() == Qt::NoBrush && pen.color().alpha() == 255 && opacity >= 1;
+		return style;
+	}
+
+	class SvgWriter
+	{
+	  public:
+		explicit SvgWriter(QIODevice* device) : xml_(device) {}
+
+		bool write(const QGraphicsScene* scene);
+
+	  private:
+		QXmlStreamWriter xml_;
+		QString pendingPath_;
+		Style pendingStyle_;
+
+		void writeItem(const QGraphicsItem* item);
+		void writeShape(const QGraphicsItem* item, const QPainterPath& path, const QPen& pen, const QBrush& brush);
+		void writeImage(const QGraphicsItem* item, const QRectF& rect, const QByteArray& data, const QByteArray& format);
+		void writeText(const QGraphicsTextItem* item);
+		void writeOpacity(const QGraphicsItem* item);
+		void flushPath();
+	};
+
+	bool SvgWriter::write(const QGraphicsScene* scene)
+	{
+		const QRectF area = SceneExporter::exportRect(scene);
+
+		xml_.writeStartDocument();
+		xml_.writeStartElement(QStringLiteral("svg"));
+		xml_.writeAttribute(QStringLiteral("xmlns"), SvgNamespace);
+		xml_.writeAttribute(QStringLiteral("xmlns:xlink"), XlinkNamespace);
+		xml_.writeAttribute(QStringLiteral("version"), QStringLiteral("1.1"));
+		xml_.writeAttribute(QStringLiteral("width"), number(area.width()));
+		xml_.writeAttribute(QStringLiteral("height"), number(area.height()));
+		// Координаты сцены пишутся как есть, поэтому при импорте элементы встают на свои места
+		xml_.writeAttribute(QStringLiteral("viewBox"), QStringLiteral("%1 %2 %3 %4")
+													   .arg(number(area.x()), number(area.y()), number(area.width()), number(area.height())));
+
+		const QBrush background = scene->backgroundBrush();
+		if (background.style() != Qt::NoBrush)
+		{
+			xml_.writeEmptyElement(QStringLiteral("rect"));
+			xml_.writeAttribute(QStringLiteral("id"), BackgroundId);
+			xml_.writeAttribute(QStringLiteral("x"), number(area.x()));
+			xml_.writeAttribute(QStringLiteral("y"), number(area.y()));
+			xml_.writeAttribute(QStringLiteral("width"), number(area.width()));
+			xml_.writeAttribute(QStringLiteral("height"), number(area.height()));
+			xml_.writeAttribute(QStringLiteral("fill"), background.color().name(QColor::HexRgb));
+		}
+
+		const QList<QGraphicsItem*> items = SceneSerializer::topLevelItems(scene);
+		for (const QGraphicsItem* item : items)
+			writeItem(item);
+		flushPath();
+
+		xml_.writeEndElement();
+		xml_.writeEndDocument();
+		return !xml_.hasError();
+	}
+
+	void SvgWriter::writeItem(const QGraphicsItem* item)
+	{
+		if (!item->isVisible())
+			return;
+		if (auto stroke = qgraphicsitem_cast<const StrokeItem*>(item))
+		{
+			if (stroke->hasVariableWidth())
+			{
+				// Штрих с нажимом - залитый контур цвета пера
+				writeShape(item, PathSimplifier::toVariableWidthPath(stroke->points(), stroke->widths()), Qt::NoPen,
+						   stroke->pen().color());
+			}
+			else
+			{
+				QPainterPath path = stroke->path();
+				if (path.isEmpty())
+					path = PathSimplifier::toPolylinePath(stroke->points());
+				writeShape(item, path, stroke->pen(), Qt::NoBrush);
+			}
+		}
+		else if (auto pathItem = qgraphicsitem_cast<const QGraphicsPathItem*>(item))
+		{
+			writeShape(item, pathItem->path(), pathItem->pen(), pathItem->brush());
+		}
+		else if (auto rectItem = qgraphicsitem_cast<const QGraphicsRectItem*>(item))
+		{
+			QPainterPath path;
+			path.addRect(rectItem->rect());
+			writeShape(item, path, rectItem->pen(), rectItem->brush());
+		}
+		else if (auto ellipseItem = qgraphicsitem_cast<const QGraphicsEllipseItem*>(item))
+		{
+			const QRectF rect = ellipseItem->rect();
+			QPainterPath path;
+			if (qAbs(ellipseItem->spanAngle()) >= 360 * 16)
+			{
+				path.addEllipse(rect);
+			}
+			else
+			{
+				// Неполный эллипс QGraphicsEllipseItem рисует сектором
+				path.moveTo(rect.center());
+				path.arcTo(rect, ellipseItem->startAngle() / 16.0, ellipseItem->spanAngle() / 16.0);
+				path.closeSubpath();
+			}
+			writeShape(item, path, ellipseItem->pen(), ellipseItem->brush());
+		}
+		else if (auto lineItem = qgraphicsitem_cast<const QGraphicsLineItem*>(item))
+		{
+			QPainterPath path(lineItem->line().p1());
+			path.lineTo(lineItem->line().p2());
+			writeShape(item, path, lineItem->pen(), Qt::NoBrush);
+		}
+		else if (auto polygonItem = qgraphicsitem_cast<const QGraphicsPolygonItem*>(item))
+		{
+			QPainterPath path;
+			path.addPolygon(polygonItem->polygon());
+			path.closeSubpath();
+			path.setFillRule(polygonItem->fillRule());
+			writeShape(item, path, polygonItem->pen(), polygonItem->brush());
+		}
+		else if (auto pixmapItem = qgraphicsitem_cast<const QGraphicsPixmapItem*>(item))
+		{
+			const QPixmap pixmap = pixmapItem->pixmap();
+			writeImage(item, QRectF(pixmapItem->offset(), pixmap.deviceIndependentSize()), pngData(pixmap.toImage()), "png");
+		}
+		else if (auto imageItem = qgraphicsitem_cast<const ImageItem*>(item))
+		{
+			// Исходный файл как есть, без перекодирования
+			QByteArray data = imageItem->sourceData();
+			QBuffer buffer(&data);
+			buffer.open(QIODevice::ReadOnly);
+			QByteArray format = QImageReader(&buffer).format();
+			if (format == "jpg")
+				format = "jpeg";
+			writeImage(item, imageItem->boundingRect(), data, format);
+		}
+		else if (auto raster = qgraphicsitem_cast<const RasterLayerItem*>(item))
+		{
+			const QList<QPoint> tiles = raster->tileCoordinates();
+			for (const QPoint& tile : tiles)
+			{
+				const QRectF rect(tile.x() * qreal(RasterLayerItem::TileSize), tile.y() * qreal(RasterLayerItem::TileSize),
+								  RasterLayerItem::TileSize, RasterLayerItem::TileSize);
+				writeImage(item, rect, pngData(raster->tileImage(tile)), "png");
+			}
+		}
+		else if (auto textItem = qgraphicsitem_cast<const QGraphicsTextItem*>(item))
+		{
+			writeText(textItem);
+		}
+		else if (auto instance = qgraphicsitem_cast<const InstanceItem*>(item))
+		{
+			// В SVG копия пишется целиком: источник собирается заново с преобразованием копии
+			std::unique_ptr<QGraphicsItem> copy(SceneSerializer::itemFromCbor(instance->source()->map()));
+			if (copy)
+			{
+				copy->setTransform(instance->sceneTransform());
+				copy->setOpacity(instance->effectiveOpacity());
+				writeItem(copy.get());
+			}
+		}
+		else if (auto group = qgraphicsitem_cast<const QGraphicsItemGroup*>(item))
+		{
+			// Группа раскрывается: у каждого дочернего элемента своё преобразование сцены
+			const QList<QGraphicsItem*> children = group->childItems();
+			for (const QGraphicsItem* child : children)
+				writeItem(child);
+		}
+	}
+
+	void SvgWriter::writeShape(const QGraphicsItem* item, const QPainterPath& path, const QPen& pen, const QBrush& brush)
+	{
+		if (path.isEmpty())
+			return;
+
+		const Style style = shapeStyle(item, pen, brush, path.fillRule());
+		if (!pendingPath_.isEmpty() && style.key != pendingStyle_.key)
+			flushPath();
+		pendingStyle_ = style;
+
+		const QTransform transform = item->sceneTransform();
+		appendPath(pendingPath_, transform.isIdentity() ? path : transform.map(path));
+		if (!style.mergeable)
+			flushPath();
+	}
+
+	void SvgWriter::flushPath()
+	{
+		if (pendingPath_.isEmpty())
+			return;
+		xml_.writeEmptyElement(QStringLiteral("path"));
+		xml_.writeAttribute(QStringLiteral("d"), pendingPath_);
+		xml_.writeAttributes(pendingStyle_.attributes);
+		pendingPath_.clear();
+	}
+
+	void SvgWriter::writeOpacity(const QGraphicsItem* item)
+	{
+		const qreal opacity = item->effectiveOpacity();
+		if (opacity < 1)
+			xml_.writeAttribute(QStringLiteral("opacity"), number(opacity));
+	}
+
+	void SvgWriter::writeImage(const QGraphicsItem* item, const QRectF& rect, const QByteArray& data, const QByteArray& format)
+	{
+		if (data.isEmpty())
+			return;
+		flushPath();
+
+		xml_.writeEmptyElement(QStringLiteral("image"));
+		const QTransform transform = item->sceneTransform();
+		if (!transform.isIdentity())
+			xml_.writeAttribute(QStringLiteral("transform"), matrixString(transform));
+		xml_.writeAttribute(QStringLiteral("x"), number(rect.x()));
+		xml_.writeAttribute(QStringLiteral("y"), number(rect.y()));
+		xml_.writeAttribute(QStringLiteral("width"), number(rect.width()));
+		xml_.writeAttribute(QStringLiteral("height"), number(rect.height()));
+		xml_.writeAttribute(QStringLiteral("preserveAspectRatio"), QStringLiteral("none"));
+		writeOpacity(item);
+		xml_.writeAttribute(QStringLiteral("xlink:href"), QStringLiteral("data:image/%1;base64,%2")
+															 .arg(QString::fromLatin1(format), QString::fromLatin1(data.toBase64())));
+	}
+
+	void SvgWriter::writeText(const QGraphicsTextItem* item)
+	{
+		const QString text = item->toPlainText();
+		if (text.isEmpty())
+			return;
+		flushPath();
+
+		// Первая строка встаёт на базовую линию под отступом документа - как рисует QGraphicsTextItem
+		const QFont font = item->font();
+		const QFontMetricsF metrics(font);
+		const qreal margin = item->document()->documentMargin();
+
+		xml_.writeStartElement(QStringLiteral("text"));
+		const QTransform transform = item->sceneTransform();
+		if (!transform.isIdentity())
+			xml_.writeAttribute(QStringLiteral("transform"), matrixString(transform));
+		xml_.writeAttribute(QStringLiteral("xml:space"), QStringLiteral("preserve"));
+		xml_.writeAttribute(QStringLiteral("font-family"), font.family());
+		xml_.writeAttribute(QStringLiteral("font-size"), number(QFontInfo(font).pixelSize()));
+		if (font.weight() >= QFont::DemiBold)
+			xml_.writeAttribute(QStringLiteral("font-weight"), QStringLiteral("bold"));
+		if (font.italic())
+			xml_.writeAttribute(QStringLiteral("font-style"), QStringLiteral("italic"));
+		const QColor color = item->defaultTextColor();
+		xml_.writeAttribute(QStringLiteral("fill"), color.name(QColor::HexRgb));
+		if (color.alpha() < 255)
+			xml_.writeAttribute(QStringLiteral("fill-opacity"), number(color.alphaF()));
+		writeOpacity(item);
+
+		const QStringList lines = text.split(QLatin1Char('\n'));
+		for (int i = 0; i < lines.size(); ++i)
+		{
+			xml_.writeStartElement(QStringLiteral("tspan"));
+			xml_.writeAttribute(QStringLiteral("x"), number(margin));
+			if (i == 0)
+				xml_.writeAttribute(QStringLiteral("y"), number(margin + metrics.ascent()));
+			else
+				xml_.writeAttribute(QStringLiteral("dy"), number(metrics.lineSpacing()));
+			xml_.writeCharacters(lines[i]);
+			xml_.writeEndElement();
+		}
+		xml_.writeEndElement();
+	}
+
+	// Числа в атрибутах SVG: разделители - пробелы и запятые, знак может идти
+	// сразу за числом ("10-5"), флаги дуги - без разделителей ("a1 1 0 01 5 5")
+	class NumberReader
+	{
+	  public:
+		explicit NumberReader(QStringView text) : p_(text.data()), end_(text.data() + text.size()) {}
+
+		bool atEnd()
+		{
+			skipSeparators();
+			return p_ == end_;
+		}
+
+		bool atNumber()
+		{
+			skipSeparators();
+			return p_ != end_ && (isDigit(*p_) || *p_ == QLatin1Char('-') || *p_ == QLatin1Char('+') || *p_ == QLatin1Char('.'));
+		}
+
+		QChar take() { return p_ != end_ ? *p_++ : QChar(); }
+
+		bool skip(QChar c)
+		{
+			skipSeparators();
+			if (p_ == end_ || *p_ != c)
+				return false;
+			++p_;
+			return true;
+		}
+
+		QStringView rest() const { return QStringView(p_, end_ - p_); }
+
+		bool read(qreal& value)
+		{
+			skipSeparators();
+			const QChar* start = p_;
+			bool negative = false;
+			if (p_ != end_ && (*p_ == QLatin1Char('-') || *p_ == QLatin1Char('+')))
+				negative = *p_++ == QLatin1Char('-');
+
+			double mantissa = 0;
+			int exponent = 0;
+			bool hasDigits = false;
+			for (; p_ != end_ && isDigit(*p_); ++p_, hasDigits = true)
+				mantissa = mantissa * 10 + (p_->unicode() - '0');
+			if (p_ != end_ && *p_ == QLatin1Char('.'))
+				for (++p_; p_ != end_ && isDigit(*p_); ++p_, hasDigits = true, --exponent)
+					mantissa = mantissa * 10 + (p_->unicode() - '0');
+			if (!hasDigits)
+			{
+				p_ = start;
+				return false;
+			}
+
+			if (p_ != end_ && (*p_ == QLatin1Char('e') || *p_ == QLatin1Char('E')))
+			{
+				const QChar* mark = p_++;
+				bool negativeExponent = false;
+				if (p_ != end_ && (*p_ == QLatin1Char('-') || *p_ == QLatin1Char('+')))
+					negativeExponent = *p_++ == QLatin1Char('-');
+				if (p_ != end_ && isDigit(*p_))
+				{
+					int power = 0;
+					for (; p_ != end_ && isDigit(*p_); ++p_)
+						power = qMin(power * 10 + (p_->unicode() - '0'), 400);
+					exponent += negativeExponent ? -power : power;
+				}
+				else
+				{
+					p_ = mark; // это не порядок, а единица измерения ("em", "ex")
+				}
+			}
+
+			if (exponent > 0)
+				mantissa *= qPow(10.0, exponent);
+			else if (exponent < 0)
+				mantissa /= qPow(10.0, -exponent);
+			value = negative ? -mantissa : mantissa;
+			return true;
+		}
+
+		bool readFlag(bool& flag)
+		{
+			skipSeparators();
+			if (p_ == end_ || (*p_ != QLatin1Char('0') && *p_ != QLatin1Char('1')))
+				return false;
+			flag = *p_++ == QLatin1Char('1');
+			return true;
+		}
+
+	  private:
+		const QChar* p_;
+		const QChar* end_;
+
+		static bool isDigit(QChar c) { return c.unicode() >= '0' && c.unicode() <= '9'; }
+
+		void skipSeparators()
+		{
+			while (p_ != end_ && (p_->isSpace() || *p_ == QLatin1Char(',')))
+				++p_;
+		}
+	};
+
+	qreal parseLength(QStringView text, qreal fallback = 0)
+	{
+		NumberReader reader(text);
+		qreal value;
+		if (!reader.read(value))
+			return fallback;
+
+		const QStringView unit = reader.rest().trimmed();
+		if (unit.startsWith(u"pt"))
+			value *= 96.0 / 72;
+		else if (unit.startsWith(u"pc"))
+			value *= 16;
+		else if (unit.startsWith(u"mm"))
+			value *= 96 / 25.4;
+		else if (unit.startsWith(u"cm"))
+			value *= 96 / 2.54;
+		else if (unit.startsWith(u"in"))
+			value *= 96;
+		else if (unit.startsWith(u"em"))
+			value *= 16;
+		return value;
+	}
+
+	QColor parseColor(QStringView value)
+	{
+		if (value == u"none" || value == u"transparent")
+			return QColor();
+		if (value == u"currentColor")
+			return QColor(Qt::black);
+		if (value.startsWith(u"url("))
+		{
+			// Градиенты и узоры не поддерживаются - берётся запасной цвет, если он указан
+			const qsizetype close = value.indexOf(QLatin1Char(')'));
+			const QStringView fallback = close < 0 ? QStringView() : value.mid(close + 1).trimmed();
+			return fallback.isEmpty() ? QColor(Qt::gray) : parseColor(fallback);
+		}
+		if (value.startsWith(u"rgb"))
+		{
+			NumberReader reader(value.mid(value.indexOf(QLatin1Char('(')) + 1));
+			qreal channels[4] = {0, 0, 0, 1};
+			for (int i = 0; i < 4; ++i)
+			{
+				if (i == 3)
+					reader.skip(QLatin1Char('/'));
+				if (!reader.read(channels[i]))
+					break;
+				if (reader.skip(QLatin1Char('%')))
+					channels[i] *= i == 3 ? 0.01 : 2.55;
+			}
+			return QColor(qBound(0, qRound(channels[0]), 255), qBound(0, qRound(channels[1]), 255),
+						  qBound(0, qRound(channels[2]), 255), qBound(0, qRound(channels[3] * 255), 255));
+		}
+		const QColor color(value.toString());
+		return color.isValid() ? color : QColor(Qt::black);
+	}
+
+	qreal parseOpacity(QStringView value)
+	{
+		NumberReader reader(value);
+		qreal opacity = 1;
+		reader.read(opacity);
+		if (reader.skip(QLatin1Char('%')))
+			opacity /= 100;
+		return qBound<qreal>(0, opacity, 1);
+	}
+
+	// viewBox корневого <svg> в его width и height с учётом preserveAspectRatio.
+	// Окно просмотра ставится в начало viewBox: файлы, записанные save, читаются
+	// без сдвига, а чужие рисунки переводятся из своих единиц в пиксели
+	QTransform parseViewBox(const QXmlStreamAttributes& attributes)
+	{
+		NumberReader reader(attributes.value(QStringLiteral("viewBox")));
+		qreal x, y, width, height;
+		if (!reader.read(x) || !reader.read(y) || !reader.read(width) || !reader.read(height) || width <= 0
+			|| height <= 0)
+			return QTransform();
+
+		// Проценты и отсутствие размера - окно размером с viewBox
+		auto viewport = [&attributes](const char* name, qreal fallback) {
+			const QStringView value = attributes.value(QLatin1String(name)).trimmed();
+			return value.isEmpty() || value.endsWith(QLatin1Char('%')) ? fallback : parseLength(value, fallback);
+		};
+		const qreal viewportWidth = viewport("width", width);
+		const qreal viewportHeight = viewport("height", height);
+		qreal sx = viewportWidth / width;
+		qreal sy = viewportHeight / height;
+
+		const QStringView aspect = attributes.value(QStringLiteral("preserveAspectRatio")).trimmed();
+		qreal dx = 0;
+		qreal dy = 0;
+		if (!aspect.startsWith(u"none"))
+		{
+			sx = sy = aspect.endsWith(u"slice") ? qMax(sx, sy) : qMin(sx, sy);
+			// По умолчанию xMidYMid
+			const qreal alignX = aspect.contains(u"xMin") ? 0 : aspect.contains(u"xMax") ? 1 : 0.5;
+			const qreal alignY = aspect.contains(u"YMin") ? 0 : aspect.contains(u"YMax") ? 1 : 0.5;
+			dx = (viewportWidth - width * sx) * alignX;
+			dy = (viewportHeight - height * sy) * alignY;
+		}
+		return QTransform::fromTranslate(-x, -y) * QTransform::fromScale(sx, sy) * QTransform::fromTranslate(x + dx, y + dy);
+	}
+
+	QTransform parseTransform(QStringView text)
+	{
+		// Функции применяются справа налево; translate/rotate/scale у QTransform
+		// как раз добавляют преобразование перед уже накопленным
+		QTransform result;
+		qsizetype position = 0;
+		while (true)
+		{
+			const qsizetype open = text.indexOf(QLatin1Char('('), position);
+			const qsizetype close = open < 0 ? -1 : text.indexOf(QLatin1Char(')'), open);
+			if (close < 0)
+				break;
+
+			QStringView name = text.mid(position, open - position).trimmed();
+			while (name.startsWith(QLatin1Char(',')))
+				name = name.mid(1).trimmed();
+			QVarLengthArray<qreal, 6> args;
+			NumberReader reader(text.mid(open + 1, close - open - 1));
+			qreal value;
+			while (reader.read(value))
+				args.append(value);
+			position = close + 1;
+			if (args.isEmpty())
+				continue;
+
+			if (name == u"matrix" && args.size() == 6)
+				result = QTransform(args[0], args[1], args[2], args[3], args[4], args[5]) * result;
+			else if (name == u"translate")
+				result.translate(args[0], args.size() > 1 ? args[1] : 0);
+			else if (name == u"scale")
+				result.scale(args[0], args.size() > 1 ? args[1] : args[0]);
+			else if (name == u"rotate" && args.size() >= 3)
+				result.translate(args[1], args[2]).rotate(args[0]).translate(-args[1], -args[2]);
+			else if (name == u"rotate")
+				result.rotate(args[0]);
+			else if (name == u"skewX")
+				result = QTransform(1, 0, qTan(qDegreesToRadians(args[0])), 1, 0, 0) * result;
+			else if (name == u"skewY")
+				result = QTransform(1, qTan(qDegreesToRadians(args[0])), 0, 1, 0, 0) * result;
+		}
+		return result;
+	}
+
+	// Дуга SVG задана концами; переводим в центр и углы и приближаем кубическими
+	// кривыми не больше четверти оборота (SVG 1.1, приложение F.6.5)
+	void arcTo(QPainterPath& path, const QPointF& from, const QPointF& to, qreal rx, qreal ry, qreal angle,
+			   bool largeArc, bool sweep)
+	{
+		rx = qAbs(rx);
+		ry = qAbs(ry);
+		if (from == to)
+			return;
+		if (rx == 0 || ry == 0)
+		{
+			path.lineTo(to);
+			return;
+		}
+
+		const qreal phi = qDegreesToRadians(angle);
+		const qreal cosPhi = qCos(phi);
+		const qreal sinPhi = qSin(phi);
+		const qreal dx = (from.x() - to.x()) / 2;
+		const qreal dy = (from.y() - to.y()) / 2;
+		const qreal x1 = cosPhi * dx + sinPhi * dy;
+		const qreal y1 = -sinPhi * dx + cosPhi * dy;
+
+		// Радиусы, которых не хватает до второй точки, увеличиваются
+		const qreal lambda = x1 * x1 / (rx * rx) + y1 * y1 / (ry * ry);
+		if (lambda > 1)
+		{
+			rx *= qSqrt(lambda);
+			ry *= qSqrt(lambda);
+		}
+
+		const qreal numerator = rx * rx * ry * ry - rx * rx * y1 * y1 - ry * ry * x1 * x1;
+		const qreal denominator = rx * rx * y1 * y1 + ry * ry * x1 * x1;
+		qreal factor = denominator > 0 ? qSqrt(qMax<qreal>(0, numerator / denominator)) : 0;
+		if (largeArc == sweep)
+			factor = -factor;
+		const qreal cx1 = factor * rx * y1 / ry;
+		const qreal cy1 = -factor * ry * x1 / rx;
+		const qreal cx = cosPhi * cx1 - sinPhi * cy1 + (from.x() + to.x()) / 2;
+		const qreal cy = sinPhi * cx1 + cosPhi * cy1 + (from.y() + to.y()) / 2;
+
+		const qreal theta = qAtan2((y1 - cy1) / ry, (x1 - cx1) / rx);
+		qreal delta = qAtan2((-y1 - cy1) / ry, (-x1 - cx1) / rx) - theta;
+		if (sweep && delta < 0)
+			delta += 2 * M_PI;
+		else if (!sweep && delta > 0)
+			delta -= 2 * M_PI;
+
+		auto map = [&](qreal ux, qreal uy) {
+			return QPointF(cosPhi * rx * ux - sinPhi * ry * uy + cx, sinPhi * rx * ux + cosPhi * ry * uy + cy);
+		};
+		const int segments = qMax(1, qCeil(qAbs(delta) / (M_PI / 2) - 1e-9));
+		const qreal step = delta / segments;
+		const qreal k = 4.0 / 3.0 * qTan(step / 4);
+		for (int i = 0; i < segments; ++i)
+		{
+			const qreal t1 = theta + i * step;
+			const qreal t2 = t1 + step;
+			const QPointF c1 = map(qCos(t1) - k * qSin(t1), qSin(t1) + k * qCos(t1));
+			const QPointF c2 = map(qCos(t2) + k * qSin(t2), qSin(t2) - k * qCos(t2));
+			path.cubicTo(c1, c2, i == segments - 1 ? to : map(qCos(t2), qSin(t2)));
+		}
+	}
+
+	QPainterPath parsePathData(QStringView data)
+	{
+		QPainterPath path;
+		NumberReader reader(data);
+		QChar command;
+		QChar previous;
+		QPointF current;
+		QPointF subpathStart;
+		QPointF lastControl;
+
+		while (!reader.atEnd())
+		{
+			// Без буквы команда повторяется; после M повторяется L
+			if (!reader.atNumber())
+				command = reader.take();
+			else if (command.isNull())
+				break;
+
+			const bool relative = command.isLower();
+			const QPointF origin = relative ? current : QPointF();
+			const char type = char(command.toUpper().unicode());
+			qreal v[7];
+			auto readNumbers = [&](int count) {
+				for (int i = 0; i < count; ++i)
+					if (!reader.read(v[i]))
+						return false;
+				return true;
+			};
+
+			switch (type)
+			{
+			case 'M':
+				if (!readNumbers(2))
+					return path;
+				current = subpathStart = origin + QPointF(v[0], v[1]);
+				path.moveTo(current);
+				command = relative ? QLatin1Char('l') : QLatin1Char('L');
+				break;
+			case 'L':
+				if (!readNumbers(2))
+					return path;
+				current = origin + QPointF(v[0], v[1]);
+				path.lineTo(current);
+				break;
+			case 'H':
+				if (!readNumbers(1))
+					return path;
+				current.setX(origin.x() + v[0]);
+				path.lineTo(current);
+				break;
+			case 'V':
+				if (!readNumbers(1))
+					return path;
+				current.setY(origin.y() + v[0]);
+				path.lineTo(current);
+				break;
+			case 'C':
+			case 'S':
+			{
+				QPointF c1;
+				if (type == 'C')
+				{
+					if (!readNumbers(6))
+						return path;
+					c1 = origin + QPointF(v[0], v[1]);
+				}
+				else
+				{
+					if (!readNumbers(4))
+						return path;
+					v[4] = v[2];
+					v[5] = v[3];
+					v[2] = v[0];
+					v[3] = v[1];
+					c1 = previous == QLatin1Char('C') || previous == QLatin1Char('S') ? 2 * current - lastControl : current;
+				}
+				lastControl = origin + QPointF(v[2], v[3]);
+				current = origin + QPointF(v[4], v[5]);
+				path.cubicTo(c1, lastControl, current);
+				break;
+			}
+			case 'Q':
+			case 'T':
+				if (type == 'Q')
+				{
+					if (!readNumbers(4))
+						return path;
+					lastControl = origin + QPointF(v[0], v[1]);
+					current = origin + QPointF(v[2], v[3]);
+				}
+				else
+				{
+					if (!readNumbers(2))
+						return path;
+					lastControl = previous == QLatin1Char('Q') || previous == QLatin1Char('T') ? 2 * current - lastControl : current;
+					current = origin + QPointF(v[0], v[1]);
+				}
+				path.quadTo(lastControl, current);
+				break;
+			case 'A':
+			{
+				bool largeArc = false;
+				bool sweep = false;
+				if (!reader.read(v[0]) || !reader.read(v[1]) || !reader.read(v[2]) || !reader.readFlag(largeArc)
+					|| !reader.readFlag(sweep) || !reader.read(v[3]) || !reader.read(v[4]))
+					return path;
+				const QPointF end = origin + QPointF(v[3], v[4]);
+				arcTo(path, current, end, v[0], v[1], v[2], largeArc, sweep);
+				current = end;
+				break;
+			}
+			case 'Z':
+				path.closeSubpath();
+				current = subpathStart;
+				command = QChar(); // за Z числа идти не могут
+				break;
+			default:
+				return path;
+			}
+			previous = QChar(QLatin1Char(type));
+		}
+		return path;
+	}
+
+	QPolygonF parsePoints(QStringView text)
+	{
+		QPolygonF points;
+		NumberReader reader(text);
+		qreal x;
+		qreal y;
+		while (reader.read(x) && reader.read(y))
+			points.append(QPointF(x, y));
+		return points;
+	}
+
+	// Наследуемые свойства оформления; значения по умолчанию - из спецификации SVG
+	struct ReadStyle
+	{
+		QColor fill = Qt::black; // недействительный цвет - none
+		QColor stroke;
+		qreal fillOpacity = 1;
+		qreal strokeOpacity = 1;
+		qreal opacity = 1; // у групп не наследуется, а перемножается
+		qreal strokeWidth = 1;
+		Qt::FillRule fillRule = Qt::WindingFill;
+		Qt::PenCapStyle cap = Qt::FlatCap;
+		Qt::PenJoinStyle join = Qt::MiterJoin;
+		qreal miterLimit = 4;
+		QList<qreal> dashes;
+		QString fontFamily;
+		qreal fontSize = 16;
+		bool bold = false;
+		bool italic = false;
+		QString textAnchor;
+		bool visible = true;
+		bool displayed = true;
+	};
+
+	void applyProperty(ReadStyle& style, QStringView name, QStringView value)
+	{
+		value = value.trimmed();
+		if (value.isEmpty() || value == u"inherit")
+			return;
+
+		if (name == u"fill")
+			style.fill = parseColor(value);
+		else if (name == u"stroke")
+			style.stroke = parseColor(value);
+		else if (name == u"fill-opacity")
+			style.fillOpacity = parseOpacity(value);
+		else if (name == u"stroke-opacity")
+			style.strokeOpacity = parseOpacity(value);
+		else if (name == u"opacity")
+			style.opacity *= parseOpacity(value);
+		else if (name == u"stroke-width")
+			style.strokeWidth = parseLength(value, 1);
+		else if (name == u"fill-rule")
+			style.fillRule = value == u"evenodd" ? Qt::OddEvenFill : Qt::WindingFill;
+		else if (name == u"stroke-linecap")
+			style.cap = value == u"round" ? Qt::RoundCap : value == u"square" ? Qt::SquareCap : Qt::FlatCap;
+		else if (name == u"stroke-linejoin")
+			style.join = value == u"round" ? Qt::RoundJoin : value == u"bevel" ? Qt::BevelJoin : Qt::MiterJoin;
+		else if (name == u"stroke-miterlimit")
+			style.miterLimit = parseLength(value, 4);
+		else if (name == u"stroke-dasharray")
+		{
+			style.dashes.clear();
+			NumberReader reader(value);
+			qreal dash;
+			while (reader.read(dash))
+				style.dashes.append(dash);
+		}
+		else if (name == u"font-family")
+		{
+			QStringView family = value.left(qMax<qsizetype>(0, value.indexOf(QLatin1Char(','))));
+			if (family.isEmpty())
+				family = value;
+			style.fontFamily = family.trimmed().toString().remove(QLatin1Char('\'')).remove(QLatin1Char('"'));
+		}
+		else if (name == u"font-size")
+			style.fontSize = parseLength(value, style.fontSize);
+		else if (name == u"font-weight")
+			style.bold = value == u"bold" || value == u"bolder" || value.toInt() >= 600;
+		else if (name == u"font-style")
+			style.italic = value == u"italic" || value == u"oblique";
+		else if (name == u"text-anchor")
+			style.textAnchor = value.toString();
+		else if (name == u"visibility")
+			style.visible = value == u"visible";
+		else if (name == u"display")
+			style.displayed = value != u"none";
+	}
+
+	struct ReadState
+	{
+		QTransform transform;
+		ReadStyle style;
+	};
+
+	class SvgReader
+	{
+	  public:
+		SvgReader(QIODevice* device, const QDir& baseDir) : xml_(device), baseDir_(baseDir) {}
+
+		QList<QGraphicsItem*> read(QString* errorString);
+
+	  private:
+		QXmlStreamReader xml_;
+		QDir baseDir_;
+		QList<ReadState> states_;
+		QList<QGraphicsItem*> items_;
+
+		void readElement();
+		void readText(const ReadState& state, const QXmlStreamAttributes& attributes);
+		void readImage(const ReadState& state, const QXmlStreamAttributes& attributes);
+		void addShape(QAbstractGraphicsShapeItem* item, const ReadState& state);
+		void addItem(QGraphicsItem* item, const ReadState& state, const QPointF& offset = QPointF());
+		QByteArray imageData(QStringView href) const;
+
+		static QPen makePen(const ReadStyle& style);
+	};
+
+	QList<QGraphicsItem*> SvgReader::read(QString* errorString)
+	{
+		states_.append(ReadState());
+		bool rootSeen = false;
+		while (!xml_.atEnd())
+		{
+			xml_.readNext();
+			if (xml_.isStartElement())
+			{
+				if (!rootSeen && xml_.name() != u"svg")
+				{
+					xml_.raiseError(QObject::tr("The file is not an SVG image."));
+					break;
+				}
+				if (!rootSeen)
+					states_.last().transform = parseViewBox(xml_.attributes());
+				rootSeen = true;
+				readElement();
+			}
+			else if (xml_.isEndElement() && states_.size() > 1)
+			{
+				states_.removeLast();
+			}
+		}
+
+		if (xml_.hasError())
+		{
+			if (errorString)
+				*errorString = QObject::tr("%1 (line %2)").arg(xml_.errorString()).arg(xml_.lineNumber());
+			qDeleteAll(items_);
+			items_.clear();
+		}
+		return items_;
+	}
+
+	void SvgReader::readElement()
+	{
+		const QStringView name = xml_.name();
+		// Определения, стили и метаданные сами ничего не рисуют
+		if (name == u"defs" || name == u"symbol" || name == u"clipPath" || name == u"mask" || name == u"pattern"
+			|| name == u"marker" || name == u"style" || name == u"metadata" || name == u"title" || name == u"desc"
+			|| name == u"linearGradient" || name == u"radialGradient" || name == u"filter" || name == u"use")
+		{
+			xml_.skipCurrentElement();
+			return;
+		}
+
+		const QXmlStreamAttributes attributes = xml_.attributes();
+		ReadState state = states_.last();
+		state.style.displayed = true;
+		for (const QXmlStreamAttribute& attribute : attributes)
+			if (attribute.name() != u"style" && attribute.name() != u"transform")
+				applyProperty(state.style, attribute.name(), attribute.value());
+		// style важнее атрибутов оформления
+		const QStringView css = attributes.value(QStringLiteral("style"));
+		for (QStringView declaration : css.tokenize(QLatin1Char(';')))
+		{
+			const qsizetype colon = declaration.indexOf(QLatin1Char(':'));
+			if (colon > 0)
+				applyProperty(state.style, declaration.left(colon).trimmed(), declaration.mid(colon + 1));
+		}
+		if (attributes.hasAttribute(QStringLiteral("transform")))
+			state.transform = parseTransform(attributes.value(QStringLiteral("transform"))) * state.transform;
+
+		if (!state.style.displayed || attributes.value(QStringLiteral("id")) == BackgroundId)
+		{
+			xml_.skipCurrentElement();
+			return;
+		}
+		if (name == u"text")
+		{
+			// Текст со всеми tspan дочитывается сразу, вместе с закрывающим тегом
+			if (state.style.visible)
+				readText(state, attributes);
+			else
+				xml_.skipCurrentElement();
+			return;
+		}
+
+		states_.append(state);
+		if (!state.style.visible)
+			return;
+
+		auto length = [&attributes](const char* attribute) { return parseLength(attributes.value(QLatin1String(attribute))); };
+		if (name == u"path")
+		{
+			QPainterPath path = parsePathData(attributes.value(QStringLiteral("d")));
+			if (path.isEmpty())
+				return;
+			path.setFillRule(state.style.fillRule);
+			addShape(new QGraphicsPathItem(path), state);
+		}
+		else if (name == u"rect")
+		{
+			const QRectF rect(length("x"), length("y"), length("width"), length("height"));
+			if (rect.isEmpty())
+				return;
+			qreal rx = length("rx");
+			qreal ry = length("ry");
+			if (rx <= 0 && ry <= 0)
+			{
+				addShape(new QGraphicsRectItem(rect), state);
+				return;
+			}
+			QPainterPath path;
+			path.addRoundedRect(rect, rx > 0 ? rx : ry, ry > 0 ? ry : rx);
+			addShape(new QGraphicsPathItem(path), state);
+		}
+		else if (name == u"circle" || name == u"ellipse")
+		{
+			const qreal rx = name == u"circle" ? length("r") : length("rx");
+			const qreal ry = name == u"circle" ? rx : length("ry");
+			if (rx > 0 && ry > 0)
+				addShape(new QGraphicsEllipseItem(length("cx") - rx, length("cy") - ry, 2 * rx, 2 * ry), state);
+		}
+		else if (name == u"line")
+		{
+			const QPen pen = makePen(state.style);
+			if (pen.style() == Qt::NoPen)
+				return;
+			auto lineItem = new QGraphicsLineItem(length("x1"), length("y1"), length("x2"), length("y2"));
+			lineItem->setPen(pen);
+			addItem(lineItem, state);
+		}
+		else if (name == u"polyline" || name == u"polygon")
+		{
+			const QPolygonF points = parsePoints(attributes.value(QStringLiteral("points")));
+			if (points.size() < 2)
+				return;
+			if (name == u"polygon")
+			{
+				auto polygonItem = new QGraphicsPolygonItem(points);
+				polygonItem->setFillRule(state.style.fillRule);
+				addShape(polygonItem, state);
+			}
+			else
+			{
+				addShape(new QGraphicsPathItem(PathSimplifier::toPolylinePath(points)), state);
+			}
+		}
+		else if (name == u"image")
+		{
+			readImage(state, attributes);
+		}
+	}
+
+	QPen SvgReader::makePen(const ReadStyle& style)
+	{
+		if (!style.stroke.isValid() || style.strokeWidth <= 0)
+			return Qt::NoPen;
+
+		QColor color = style.stroke;
+		color.setAlphaF(color.alphaF() * style.strokeOpacity);
+		QPen pen(color, style.strokeWidth, Qt::SolidLine, style.cap, style.join);
+		pen.setMiterLimit(style.miterLimit);
+
+		// В SVG штрихи в пикселях и нечётный список повторяется дважды; у QPen - в толщинах пера
+		QList<qreal> dashes = style.dashes;
+		if (dashes.size() % 2 != 0)
+			dashes += style.dashes;
+		qreal total = 0;
+		for (qreal& dash : dashes)
+		{
+			total += dash;
+			dash /= style.strokeWidth;
+		}
+		if (!dashes.isEmpty() && total > 0)
+			pen.setDashPattern(dashes);
+		return pen;
+	}
+
+	void SvgReader::addShape(QAbstractGraphicsShapeItem* item, const ReadState& state)
+	{
+		item->setPen(makePen(state.style));
+		if (state.style.fill.isValid())
+		{
+			QColor color = state.style.fill;
+			color.setAlphaF(color.alphaF() * state.style.fillOpacity);
+			item->setBrush(color);
+		}
+		addItem(item, state);
+	}
+
+	void SvgReader::addItem(QGraphicsItem* item, const ReadState& state, const QPointF& offset)
+	{
+		// Сдвиг становится позицией элемента, остальное - его преобразованием
+		const QTransform transform = QTransform::fromTranslate(offset.x(), offset.y()) * state.transform;
+		if (transform.type() <= QTransform::TxTranslate)
+			item->setPos(transform.dx(), transform.dy());
+		else
+			item->setTransform(transform);
+		if (state.style.opacity < 1)
+			item->setOpacity(state.style.opacity);
+		item->setFlags(QGraphicsItem::ItemIsMovable | QGraphicsItem::ItemIsSelectable | QGraphicsItem::ItemIsFocusable);
+		items_.append(item);
+	}
+
+	void SvgReader::readText(const ReadState& state, const QXmlStreamAttributes& attributes)
+	{
+		const bool preserveSpace = attributes.value(QStringLiteral("xml:space")) == u"preserve";
+		bool positioned = attributes.hasAttribute(QStringLiteral("x")) || attributes.hasAttribute(QStringLiteral("y"));
+		QPointF origin(parseLength(attributes.value(QStringLiteral("x"))), parseLength(attributes.value(QStringLiteral("y"))));
+
+		// tspan с собственной позицией начинает новую строку
+		QString text;
+		bool lineSeen = false;
+		int depth = 1;
+		while (depth > 0 && !xml_.atEnd())
+		{
+			xml_.readNext();
+			if (xml_.isStartElement())
+			{
+				++depth;
+				const QXmlStreamAttributes span = xml_.attributes();
+				if (xml_.name() == u"tspan" && (span.hasAttribute(QStringLiteral("x")) || span.hasAttribute(QStringLiteral("y"))
+												|| span.hasAttribute(QStringLiteral("dy"))))
+				{
+					if (!positioned)
+					{
+						origin = QPointF(parseLength(span.value(QStringLiteral("x")), origin.x()),
+										 parseLength(span.value(QStringLiteral("y")), origin.y()));
+						positioned = true;
+					}
+					else if (lineSeen)
+					{
+						text += QLatin1Char('\n');
+					}
+					lineSeen = true;
+				}
+			}
+			else if (xml_.isEndElement())
+			{
+				--depth;
+			}
+			else if (xml_.isCharacters() && !(depth == 1 && xml_.isWhitespace()))
+			{
+				QString chunk = xml_.text().toString();
+				if (!preserveSpace)
+					chunk.replace(QLatin1Char('\n'), QLatin1Char(' '));
+				text += chunk;
+				lineSeen = true;
+			}
+		}
+		if (text.isEmpty())
+			return;
+
+		const ReadStyle& style = state.style;
+		QFont font;
+		if (!style.fontFamily.isEmpty())
+			font.setFamily(style.fontFamily);
+		font.setPixelSize(qMax(1, qRound(style.fontSize)));
+		font.setBold(style.bold);
+		font.setItalic(style.italic);
+
+		auto textItem = new QGraphicsTextItem(text);
+		textItem->setFont(font);
+		QColor color = style.fill.isValid() ? style.fill : QColor(Qt::black);
+		color.setAlphaF(color.alphaF() * style.fillOpacity);
+		textItem->setDefaultTextColor(color);
+
+		// В SVG задана базовая линия первой строки, у QGraphicsTextItem - левый верхний угол с отступом
+		const QFontMetricsF metrics(font);
+		const qreal margin = textItem->document()->documentMargin();
+		QPointF offset(origin.x() - margin, origin.y() - margin - metrics.ascent());
+		if (style.textAnchor == QLatin1String("middle") || style.textAnchor == QLatin1String("end"))
+		{
+			qreal width = 0;
+			for (const QString& line : text.split(QLatin1Char('\n')))
+				width = qMax(width, metrics.horizontalAdvance(line));
+			offset.rx() -= style.textAnchor == QLatin1String("middle") ? width / 2 : width;
+		}
+		addItem(textItem, state, offset);
+	}
+
+	QByteArray SvgReader::imageData(QStringView href) const
+	{
+		if (href.startsWith(u"data:"))
+		{
+			const qsizetype comma = href.indexOf(QLatin1Char(','));
+			if (comma < 0)
+				return QByteArray();
+			const QByteArray payload = href.mid(comma + 1).toLatin1();
+			return href.left(comma).endsWith(u";base64") ? QByteArray::fromBase64(payload)
+														 : QByteArray::fromPercentEncoding(payload);
+		}
+
+		// Внешний файл - относительно самого SVG
+		QFile file(baseDir_.filePath(href.startsWith(u"file://") ? href.mid(7).toString() : href.toString()));
+		return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+	}
+
+	void SvgReader::readImage(const ReadState& state, const QXmlStreamAttributes& attributes)
+	{
+		QStringView href = attributes.value(QStringLiteral("href"));
+		if (href.isEmpty())
+			href = attributes.value(XlinkNamespace, QStringLiteral("href"));
+		const QByteArray data = imageData(href.trimmed());
+		QSize size;
+		if (!ImageItem::probe(data, &size) || size.isEmpty())
+			return;
+
+		const qreal width = parseLength(attributes.value(QStringLiteral("width")), size.width());
+		const qreal height = parseLength(attributes.value(QStringLiteral("height")), size.height());
+		ReadState placed = state;
+		placed.transform = QTransform::fromScale(width / size.width(), height / size.height())
+						   * QTransform::fromTranslate(parseLength(attributes.value(QStringLiteral("x"))),
+													   parseLength(attributes.value(QStringLiteral("y"))))
+						   * state.transform;
+		addItem(new ImageItem(data), placed);
+	}
+}
+
+bool SceneSvg::isSvgFile(const QString& filePath)
+{
+	return QFileInfo(filePath).suffix().compare(QLatin1String("svg"), Qt::CaseInsensitive) == 0;
+}
+
+bool SceneSvg::save(const QGraphicsScene* scene, QIODevice* device, QString* errorString)
+{
+	if (!device->isWritable())
+	{
+		if (errorString)
+			*errorString = device->errorString();
+		return false;
+	}
+
+	SvgWriter writer(device);
+	if (!writer.write(scene))
+	{
+		if (errorString)
+			*errorString = device->errorString();
+		return false;
+	}
+	return true;
+}
+
+QList<QGraphicsItem*> SceneSvg::load(QIODevice* device, QString* errorString)
+{
+	// Относительные ссылки на картинки ищутся рядом с файлом
+	auto file = qobject_cast<QFile*>(device);
+	SvgReader reader(device, file ? QFileInfo(file->fileName()).absoluteDir() : QDir::current());
+	return reader.read(errorString);
+}
@@ -0,0 +1,24 @@
+#ifndef SCENESVG_H
+#define SCENESVG_H
+
+#include <QGraphicsItem>
+#include <QGraphicsScene>
+#include <QIODevice>
+#include <QList>
+
+// Векторный экспорт и импорт сцены в SVG. Оба направления потоковые: элементы
+// пишутся в файл по одному через QXmlStreamWriter, а при чтении QXmlStreamReader
+// сразу строит элементы сцены - документ целиком в памяти не держится.
+// Соседние по стопке штрихи и контуры с одинаковым стилем сливаются в один <path>.
+class SceneSvg
+{
+  public:
+	static bool isSvgFile(const QString& filePath);
+
+	static bool save(const QGraphicsScene* scene, QIODevice* device, QString* errorString = nullptr);
+	// Пути, фигуры, текст и встроенные картинки; на сцену элементы добавляет вызывающий.
+	// Фон, записанный save, пропускается
+	static QList<QGraphicsItem*> load(QIODevice* device, QString* errorString = nullptr);
+};
+
+#endif // SCENESVG_H
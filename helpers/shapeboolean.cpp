@@ -0,0 +1,120 @@
+#include "shapeboolean.h"
+#include "../items/strokeitem.h"
+
+#include <QGraphicsEllipseItem>
+#include <QGraphicsItemGroup>
+#include <QGraphicsPathItem>
+#include <QGraphicsPolygonItem>
+#include <QGraphicsRectItem>
+#include <QPainterPathStroker>
+#include <QPen>
+#include <QtConcurrent/QtConcurrentMap>
+
+namespace
+{
+	QPainterPath strokeOf(const QPainterPath& path, const QPen& pen)
+	{
+		if (pen.style() == Qt::NoPen || path.isEmpty())
+			return QPainterPath();
+		QPainterPathStroker stroker(pen);
+		// Косметическое перо рисуется в пиксель при любом масштабе
+		if (pen.isCosmetic())
+			stroker.setWidth(qMax<qreal>(1, pen.widthF()));
+		return stroker.createStroke(path);
+	}
+
+	// Геометрия фигуры без пера; пустой путь - у элемента нет заливаемой геометрии
+	QPainterPath geometryOf(const QGraphicsItem* item)
+	{
+		QPainterPath path;
+		if (auto pathItem = qgraphicsitem_cast<const QGraphicsPathItem*>(item))
+			path = pathItem->path();
+		else if (auto rectItem = qgraphicsitem_cast<const QGraphicsRectItem*>(item))
+			path.addRect(rectItem->rect());
+		else if (auto ellipseItem = qgraphicsitem_cast<const QGraphicsEllipseItem*>(item))
+			path.addEllipse(ellipseItem->rect());
+		else if (auto polygonItem = qgraphicsitem_cast<const QGraphicsPolygonItem*>(item))
+		{
+			path.addPolygon(polygonItem->polygon());
+			path.closeSubpath();
+			path.setFillRule(polygonItem->fillRule());
+		}
+		return path;
+	}
+
+	QPainterPath apply(const QPainterPath& a, const QPainterPath& b, ShapeBoolean::Operation operation)
+	{
+		switch (operation)
+		{
+		case ShapeBoolean::Operation::Intersect:
+			return a.intersected(b);
+		case ShapeBoolean::Operation::Subtract:
+			return a.subtracted(b);
+		case ShapeBoolean::Operation::Union:
+			break;
+		}
+		return a.united(b);
+	}
+
+	QPainterPath reduce(QList<QPainterPath> level, ShapeBoolean::Operation operation)
+	{
+		if (level.isEmpty())
+			return QPainterPath();
+
+		while (level.size() > 1)
+		{
+			QList<int> pairs;
+			for (int i = 0; i + 1 < level.size(); i += 2)
+				pairs.append(i);
+			QList<QPainterPath> next = QtConcurrent::blockingMapped<QList<QPainterPath>>(
+				pairs, [&level, operation](int i) { return apply(level[i], level[i + 1], operation); });
+			if (level.size() % 2 != 0)
+				next.append(level.last());
+			level = next;
+		}
+		return level.first();
+	}
+}
+
+QPainterPath ShapeBoolean::outline(const QGraphicsItem* item)
+{
+	QPainterPath local;
+	if (auto stroke = qgraphicsitem_cast<const StrokeItem*>(item))
+	{
+		// Штрих с нажимом уже хранит залитый контур
+		local = stroke->hasVariableWidth() ? stroke->path() : strokeOf(stroke->path(), stroke->pen());
+	}
+	else if (auto group = qgraphicsitem_cast<const QGraphicsItemGroup*>(item))
+	{
+		QList<QPainterPath> children;
+		const QList<QGraphicsItem*> childItems = group->childItems();
+		for (const QGraphicsItem* child : childItems)
+			children.append(outline(child));
+		return reduce(children, Operation::Union);
+	}
+	else if (auto shapeItem = dynamic_cast<const QAbstractGraphicsShapeItem*>(item))
+	{
+		const QPainterPath geometry = geometryOf(item);
+		if (geometry.isEmpty())
+			local = item->shape();
+		else if (shapeItem->brush().style() == Qt::NoBrush)
+			local = strokeOf(geometry, shapeItem->pen());
+		else
+			local = geometry.united(strokeOf(geometry, shapeItem->pen()));
+	}
+	else
+	{
+		// Линия - обводка, картинка - её непрозрачные пиксели или рамка, текст - рамка
+		local = item->shape();
+	}
+	return item->sceneTransform().map(local);
+}
+
+QPainterPath ShapeBoolean::combine(const QList<QPainterPath>& paths, Operation operation)
+{
+	if (operation != Operation::Subtract || paths.size() < 2)
+		return reduce(paths, operation);
+
+	// Вычитать по одному - n операций подряд; объединение остальных сводится деревом
+	return paths.first().subtracted(reduce(paths.mid(1), Operation::Union));
+}
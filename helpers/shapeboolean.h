@@ -0,0 +1,28 @@
+#ifndef SHAPEBOOLEAN_H
+#define SHAPEBOOLEAN_H
+
+#include <QGraphicsItem>
+#include <QList>
+#include <QPainterPath>
+
+// Булевы операции над фигурами сцены. Контуры сводятся попарно, деревом:
+// на каждом уровне пары независимы и считаются в пуле потоков, а глубина
+// дерева - log2 от числа фигур вместо цепочки из n последовательных операций.
+class ShapeBoolean
+{
+  public:
+	enum class Operation
+	{
+		Union,
+		Intersect,
+		Subtract // из первого контура вычитаются все остальные
+	};
+
+	// Всё, что элемент закрашивает, в координатах сцены: заливка вместе с обводкой пера,
+	// у незалитых фигур и штрихов - только обводка
+	static QPainterPath outline(const QGraphicsItem* item);
+
+	static QPainterPath combine(const QList<QPainterPath>& paths, Operation operation);
+};
+
+#endif // SHAPEBOOLEAN_H
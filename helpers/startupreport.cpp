@@ -0,0 +1,139 @@
+#include "startupreport.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QEvent>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QList>
+#include <QTimer>
+#include <QWidget>
+
+namespace
+{
+	struct Stage
+	{
+		QString name;
+		double ms;
+		bool isDuration;
+	};
+
+	struct State
+	{
+		QElapsedTimer clock;
+		QString target;
+		QList<Stage> stages;
+		bool isPainted = false;
+		bool isFinished = false;
+	};
+
+	State& state()
+	{
+		static State instance;
+		return instance;
+	}
+
+	bool contains(const QString& name)
+	{
+		for (const Stage& stage : std::as_const(state().stages))
+			if (stage.name == name)
+				return true;
+		return false;
+	}
+
+	void finish()
+	{
+		State& s = state();
+		if (s.isFinished)
+			return;
+		s.isFinished = true;
+
+		QJsonArray stages;
+		for (const Stage& stage : std::as_const(s.stages))
+		{
+			qInfo().noquote() << QStringLiteral("startup: %1 %2 %3 ms")
+									 .arg(stage.name, stage.isDuration ? QStringLiteral("took") : QStringLiteral("at"))
+									 .arg(stage.ms, 0, 'f', 1);
+			stages.append(QJsonObject{{QStringLiteral("stage"), stage.name},
+									  {QStringLiteral("ms"), stage.ms},
+									  {QStringLiteral("duration"), stage.isDuration}});
+		}
+
+		if (s.target == QLatin1String("1"))
+			return;
+		QFile file(s.target);
+		if (file.open(QIODevice::WriteOnly | QIODevice::Append))
+			file.write(QJsonDocument(QJsonObject{{QStringLiteral("stages"), stages}}).toJson(QJsonDocument::Compact) + '\n');
+		else
+			qWarning().noquote() << QStringLiteral("startup: cannot write %1: %2").arg(s.target, file.errorString());
+	}
+
+	// Первое событие Paint любого виджета окна: до него на экране ничего нет
+	class FirstPaintFilter : public QObject
+	{
+	  public:
+		explicit FirstPaintFilter(QWidget* window) : QObject(window), window_(window) {}
+
+		bool eventFilter(QObject* watched, QEvent* event) override
+		{
+			if (event->type() == QEvent::Paint && watched->isWidgetType()
+				&& static_cast<QWidget*>(watched)->window() == window_)
+			{
+				StartupReport::mark(QStringLiteral("first paint"));
+				state().isPainted = true;
+				QCoreApplication::instance()->removeEventFilter(this);
+				// Вкладки и отложенные вызовы первого цикла событий успевают отработать
+				const bool isTabReady = contains(QLatin1String(StartupReport::FirstTabReady));
+				QTimer::singleShot(isTabReady ? 0 : StartupReport::FirstTabTimeoutMs, QCoreApplication::instance(), finish);
+				deleteLater();
+			}
+			return false;
+		}
+
+	  private:
+		QWidget* window_;
+	};
+}
+
+void StartupReport::start()
+{
+	State& s = state();
+	s.clock.start();
+	s.target = qEnvironmentVariable("STARTUP_REPORT");
+}
+
+bool StartupReport::isEnabled() { return !state().target.isEmpty() && !state().isFinished; }
+
+void StartupReport::mark(const QString& stage)
+{
+	State& s = state();
+	if (s.target.isEmpty() || contains(stage))
+		return;
+	const double ms = s.clock.nsecsElapsed() / 1e6;
+	if (s.isFinished)
+		qInfo().noquote() << QStringLiteral("startup: %1 at %2 ms").arg(stage).arg(ms, 0, 'f', 1);
+	s.stages.append({stage, ms, false});
+
+	// Окно уже нарисовано и ждало только вкладку
+	if (s.isPainted && !s.isFinished && stage == QLatin1String(FirstTabReady))
+		QTimer::singleShot(0, QCoreApplication::instance(), finish);
+}
+
+void StartupReport::record(const QString& stage, double ms)
+{
+	if (state().target.isEmpty() || contains(stage))
+		return;
+	// После отчёта длительности выводятся сразу - первый "New Paint" бывает уже после запуска
+	if (state().isFinished)
+		qInfo().noquote() << QStringLiteral("startup: %1 took %2 ms").arg(stage).arg(ms, 0, 'f', 1);
+	state().stages.append({stage, ms, true});
+}
+
+void StartupReport::finishOnFirstPaint(QWidget* window)
+{
+	if (isEnabled())
+		QCoreApplication::instance()->installEventFilter(new FirstPaintFilter(window));
+}
@@ -0,0 +1,35 @@
+#ifndef STARTUPREPORT_H
+#define STARTUPREPORT_H
+
+#include <QString>
+
+class QWidget;
+
+// Время запуска по этапам, от входа в main до первой отрисовки окна и готовой
+// первой вкладки. Включается переменной окружения STARTUP_REPORT: "1" - отчёт
+// в лог, иначе это путь к JSON-файлу, куда отчёт дописывается одной строкой
+// (удобно сравнивать между сборками). Выключенный отчёт ничего не стоит.
+class StartupReport
+{
+  public:
+	// Этап, которого отчёт ждёт после первой отрисовки
+	static constexpr char FirstTabReady[] = "first tab ready";
+	static constexpr int FirstTabTimeoutMs = 30000;
+
+	// Первой строкой main - отсюда отсчитывается время
+	static void start();
+	static bool isEnabled();
+
+	// Каждый этап запоминается один раз, по первому вызову; после отчёта этапы
+	// выводятся в лог сразу
+	static void mark(const QString& stage);
+	// Длительность отдельной операции, например построения первого редактора сцены
+	static void record(const QString& stage, double ms);
+
+	// Отчёт выводится после первой отрисовки window, когда готова первая вкладка.
+	// При пустой сессии вкладка появляется, только когда её откроют, поэтому
+	// ждём не дольше FirstTabTimeoutMs
+	static void finishOnFirstPaint(QWidget* window);
+};
+
+#endif // STARTUPREPORT_H
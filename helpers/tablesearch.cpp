@@ -0,0 +1,117 @@
+#include "tablesearch.h"
+
+#include <QRegularExpression>
+#include <QThread>
+#include <QtConcurrent/QtConcurrentMap>
+
+namespace
+{
+	struct RowRange
+	{
+		int first;
+		int last;
+	};
+
+	QList<RowRange> splitRows(int rowCount)
+	{
+		QList<RowRange> ranges;
+		const int chunks = qMax(1, QThread::idealThreadCount() * 4);
+		const int chunkSize = qMax(256, (rowCount + chunks - 1) / chunks);
+		for (int first = 0; first < rowCount; first += chunkSize)
+			ranges.append({first, qMin(rowCount, first + chunkSize) - 1});
+		return ranges;
+	}
+}
+
+bool TableSearch::isValid(const TableSearchOptions& options, QString* errorString)
+{
+	if (options.pattern.isEmpty())
+	{
+		if (errorString)
+			*errorString = QObject::tr("Search text is empty.");
+		return false;
+	}
+
+	if (options.isRegex)
+	{
+		QRegularExpression regex(options.pattern);
+		if (!regex.isValid())
+		{
+			if (errorString)
+				*errorString = regex.errorString();
+			return false;
+		}
+	}
+	return true;
+}
+
+QList<TableSearchHit> TableSearch::findAll(const QTableWidget* table, const TableSearchOptions& options)
+{
+	return scan(table, options, nullptr);
+}
+
+QList<TableSearchHit> TableSearch::replaceAll(const QTableWidget* table, const TableSearchOptions& options,
+											  const QString& replacement)
+{
+	return scan(table, options, &replacement);
+}
+
+QList<TableSearchHit> TableSearch::scan(const QTableWidget* table, const TableSearchOptions& options,
+										const QString* replacement)
+{
+	if (!table || !isValid(options))
+		return {};
+
+	QList<int> columns = options.columns;
+	if (columns.isEmpty())
+		for (int col = 0; col < table->columnCount(); ++col)
+			columns.append(col);
+
+	// Пока работают потоки, GUI-поток ждёт, поэтому ячейки только читаются.
+	auto scanRange = [table, &options, &columns, replacement](const RowRange& range)
+	{
+		QRegularExpression::PatternOptions patternOptions = QRegularExpression::NoPatternOption;
+		if (options.caseSensitivity == Qt::CaseInsensitive)
+			patternOptions |= QRegularExpression::CaseInsensitiveOption;
+		const QRegularExpression regex(options.isRegex ? options.pattern : QString(), patternOptions);
+
+		QList<TableSearchHit> hits;
+		for (int row = range.first; row <= range.last; ++row)
+		{
+			for (int col : columns)
+			{
+				const QTableWidgetItem* item = table->item(row, col);
+				if (!item)
+					continue;
+
+				const QString text = item->text();
+				bool matched = options.isRegex ? regex.match(text).hasMatch()
+											   : text.contains(options.pattern, options.caseSensitivity);
+				if (!matched)
+					continue;
+
+				TableSearchHit hit{row, col, text, QString()};
+				if (replacement)
+				{
+					hit.newText = text;
+					if (options.isRegex)
+						hit.newText.replace(regex, *replacement);
+					else
+						hit.newText.replace(options.pattern, *replacement, options.caseSensitivity);
+					if (hit.newText == text)
+						continue;
+				}
+				hits.append(hit);
+			}
+		}
+		return hits;
+	};
+
+	const QList<QList<TableSearchHit>> chunks =
+		QtConcurrent::blockingMapped<QList<QList<TableSearchHit>>>(splitRows(table->rowCount()), scanRange);
+
+	QList<TableSearchHit> result;
+	for (const QList<TableSearchHit>& chunk : chunks)
+		result.append(chunk);
+	return result;
+}
@@ -0,0 +1,40 @@
+#ifndef TABLESEARCH_H
+#define TABLESEARCH_H
+
+#include <QList>
+#include <QString>
+#include <QTableWidget>
+
+struct TableSearchOptions
+{
+	QString pattern;
+	bool isRegex = false;
+	Qt::CaseSensitivity caseSensitivity = Qt::CaseInsensitive;
+	QList<int> columns; // пустой список - вся таблица
+};
+
+struct TableSearchHit
+{
+	int row;
+	int column;
+	QString oldText;
+	QString newText;
+};
+
+// Поиск по ячейкам таблицы. Строки делятся на куски, каждый кусок
+// просматривается в пуле потоков, результаты собираются по порядку.
+class TableSearch
+{
+  public:
+	static QList<TableSearchHit> findAll(const QTableWidget* table, const TableSearchOptions& options);
+	static QList<TableSearchHit> replaceAll(const QTableWidget* table, const TableSearchOptions& options,
+											const QString& replacement);
+
+	static bool isValid(const TableSearchOptions& options, QString* errorString = nullptr);
+
+  private:
+	static QList<TableSearchHit> scan(const QTableWidget* table, const TableSearchOptions& options,
+									  const QString* replacement);
+};
+
+#endif // TABLESEARCH_H
@@ -0,0 +1,187 @@
+#include "trace.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QSaveFile>
+#include <QThread>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace
+{
+	// Поля атомарные: экспорт читает кольцо, пока поток продолжает в него писать
+	struct Event
+	{
+		std::atomic<const char*> name{nullptr};
+		std::atomic<qint64> start{0};
+		std::atomic<qint64> duration{0};
+	};
+
+	struct ThreadBuffer
+	{
+		int tid = 0;
+		QString threadName;
+		std::atomic<quint64> written{0}; // пишет только поток-владелец
+		Event events[Trace::Capacity];
+	};
+
+	struct Registry
+	{
+		Registry() { clock.start(); }
+
+		QElapsedTimer clock;
+		QMutex mutex;
+		int lastTid = 0;
+		std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+		std::vector<ThreadBuffer*> retired; // кольца завершившихся потоков, старые первыми
+	};
+
+	// Не удаляется: потоки пула могут писать и во время выхода из программы
+	Registry& registry()
+	{
+		static Registry* instance = new Registry;
+		return *instance;
+	}
+
+	// Поток при выходе отдаёт кольцо в retired: события остаются в журнале, пока
+	// кольцо не займёт новый поток. Так колец не больше, чем потоков жило
+	// одновременно, сколько бы потоков ни заводил и ни завершал пул
+	struct ThreadSlot
+	{
+		ThreadBuffer* buffer = nullptr;
+
+		~ThreadSlot()
+		{
+			if (!buffer)
+				return;
+			Registry& r = registry();
+			QMutexLocker locker(&r.mutex);
+			r.retired.push_back(buffer);
+			buffer = nullptr;
+		}
+	};
+
+	// Кольцо берётся при первой записи потока - единственное место с блокировкой
+	ThreadBuffer* threadBuffer()
+	{
+		thread_local ThreadSlot slot;
+		if (slot.buffer)
+			return slot.buffer;
+
+		QThread* thread = QThread::currentThread();
+		QString threadName = thread->objectName();
+		if (threadName.isEmpty() && QCoreApplication::instance() && thread == QCoreApplication::instance()->thread())
+			threadName = QStringLiteral("main");
+
+		Registry& r = registry();
+		QMutexLocker locker(&r.mutex);
+		ThreadBuffer* buffer;
+		if (r.retired.empty())
+		{
+			r.buffers.push_back(std::make_unique<ThreadBuffer>());
+			buffer = r.buffers.back().get();
+		}
+		else
+		{
+			// Экспорт читает кольца под той же блокировкой и записей прежнего потока уже не увидит
+			buffer = r.retired.front();
+			r.retired.erase(r.retired.begin());
+			buffer->written.store(0, std::memory_order_relaxed);
+		}
+		buffer->tid = ++r.lastTid;
+		buffer->threadName = threadName.isEmpty() ? QStringLiteral("thread %1").arg(buffer->tid) : threadName;
+		slot.buffer = buffer;
+		return buffer;
+	}
+
+	QJsonObject completeEvent(const ThreadBuffer& buffer, const char* name, qint64 start, qint64 duration)
+	{
+		return {{QStringLiteral("name"), QString::fromUtf8(name)},
+				{QStringLiteral("ph"), QStringLiteral("X")},
+				{QStringLiteral("pid"), 1},
+				{QStringLiteral("tid"), buffer.tid},
+				{QStringLiteral("ts"), start / 1000.0},
+				{QStringLiteral("dur"), duration / 1000.0}};
+	}
+
+	void appendEvents(const ThreadBuffer& buffer, QJsonArray& events)
+	{
+		events.append(QJsonObject{{QStringLiteral("name"), QStringLiteral("thread_name")},
+								  {QStringLiteral("ph"), QStringLiteral("M")},
+								  {QStringLiteral("pid"), 1},
+								  {QStringLiteral("tid"), buffer.tid},
+								  {QStringLiteral("args"), QJsonObject{{QStringLiteral("name"), buffer.threadName}}}});
+
+		struct Copy
+		{
+			const char* name;
+			qint64 start;
+			qint64 duration;
+		};
+		const quint64 end = buffer.written.load(std::memory_order_acquire);
+		const quint64 begin = end > quint64(Trace::Capacity) ? end - Trace::Capacity : 0;
+		std::vector<Copy> copies;
+		copies.reserve(end - begin);
+		for (quint64 index = begin; index < end; ++index)
+		{
+			const Event& event = buffer.events[index % Trace::Capacity];
+			copies.push_back({event.name.load(std::memory_order_relaxed), event.start.load(std::memory_order_relaxed),
+							  event.duration.load(std::memory_order_relaxed)});
+		}
+
+		// Пока копировали, поток мог переписать начало кольца - такие записи отбрасываем
+		std::atomic_thread_fence(std::memory_order_acquire);
+		const quint64 after = buffer.written.load(std::memory_order_relaxed);
+		const quint64 firstIntact = after >= quint64(Trace::Capacity) ? after - Trace::Capacity + 1 : 0;
+		for (quint64 index = qMax(begin, firstIntact); index < end; ++index)
+		{
+			const Copy& copy = copies[index - begin];
+			if (copy.name)
+				events.append(completeEvent(buffer, copy.name, copy.start, copy.duration));
+		}
+	}
+}
+
+qint64 Trace::nowNs() { return registry().clock.nsecsElapsed(); }
+
+void Trace::record(const char* name, qint64 startNs, qint64 durationNs)
+{
+	ThreadBuffer* buffer = threadBuffer();
+	const quint64 index = buffer->written.load(std::memory_order_relaxed);
+	// Затираемая запись не должна стать видна раньше, чем счётчик предыдущей
+	std::atomic_thread_fence(std::memory_order_release);
+	Event& event = buffer->events[index % Capacity];
+	event.name.store(name, std::memory_order_relaxed);
+	event.start.store(startNs, std::memory_order_relaxed);
+	event.duration.store(durationNs, std::memory_order_relaxed);
+	buffer->written.store(index + 1, std::memory_order_release);
+}
+
+bool Trace::exportChromeJson(const QString& filePath, QString* errorString)
+{
+	QJsonArray events;
+	{
+		Registry& r = registry();
+		QMutexLocker locker(&r.mutex);
+		for (const std::unique_ptr<ThreadBuffer>& buffer : r.buffers)
+			appendEvents(*buffer, events);
+	}
+
+	const QJsonObject root{{QStringLiteral("traceEvents"), events},
+						   {QStringLiteral("displayTimeUnit"), QStringLiteral("ms")}};
+	QSaveFile file(filePath);
+	if (!file.open(QIODevice::WriteOnly) || file.write(QJsonDocument(root).toJson(QJsonDocument::Compact)) < 0
+		|| !file.commit())
+	{
+		if (errorString)
+			*errorString = file.errorString();
+		return false;
+	}
+	return true;
+}
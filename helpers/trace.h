@@ -0,0 +1,40 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QString>
+#include <QtGlobal>
+
+// Журнал коротких интервалов для разбора зависаний. Каждый поток пишет в своё
+// кольцо фиксированного размера без блокировок, старые записи затираются -
+// журнал всегда включён и хранит последние события. Кольцо завершившегося
+// потока достаётся следующему новому потоку. Сохраняется в формате
+// Chrome trace: открывается в chrome://tracing и Perfetto.
+class Trace
+{
+  public:
+	static constexpr int Capacity = 8192; // записей на поток
+
+	// Время от первого обращения к журналу, общее для всех потоков
+	static qint64 nowNs();
+	// name - строковый литерал: хранится только указатель
+	static void record(const char* name, qint64 startNs, qint64 durationNs);
+
+	static bool exportChromeJson(const QString& filePath, QString* errorString = nullptr);
+};
+
+// Замер области видимости: TraceSpan span("TableEditWidget::openFile");
+class TraceSpan
+{
+  public:
+	explicit TraceSpan(const char* name) : name_(name), start_(Trace::nowNs()) {}
+	~TraceSpan() { Trace::record(name_, start_, Trace::nowNs() - start_); }
+
+	TraceSpan(const TraceSpan&) = delete;
+	TraceSpan& operator=(const TraceSpan&) = delete;
+
+  private:
+	const char* name_;
+	qint64 start_;
+};
+
+#endif // TRACE_H
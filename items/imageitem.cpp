@@ -0,0 +1,155 @@
+#include "imageitem.h"
+
+#include <QBuffer>
+#include <QImageReader>
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+#include <QtConcurrent/QtConcurrentRun>
+
+namespace
+{
+	// Размер до поворота по EXIF - именно в нём задаётся setScaledSize
+	QSize storedSize(const QSize& size, QImageIOHandler::Transformations transformation)
+	{
+		return transformation & QImageIOHandler::TransformationRotate90 ? size.transposed() : size;
+	}
+}
+
+bool ImageItem::probe(const QByteArray& data, QSize* size)
+{
+	QBuffer buffer;
+	buffer.setData(data);
+	buffer.open(QIODevice::ReadOnly);
+	QImageReader reader(&buffer);
+	reader.setAutoTransform(true);
+	if (!reader.canRead())
+		return false;
+
+	const QSize rawSize = reader.size();
+	if (!rawSize.isValid())
+		return false;
+	if (size)
+		*size = storedSize(rawSize, reader.transformation());
+	return true;
+}
+
+ImageItem::ImageItem(const QByteArray& data, QGraphicsItem* parent)
+	: QGraphicsObject(parent), data_(data)
+{
+	probe(data_, &size_);
+}
+
+QImage ImageItem::decode(const QByteArray& data)
+{
+	QBuffer buffer;
+	buffer.setData(data);
+	buffer.open(QIODevice::ReadOnly);
+	QImageReader reader(&buffer);
+	reader.setAutoTransform(true);
+	return reader.read();
+}
+
+void ImageItem::setRenderMode(RenderMode mode)
+{
+	renderMode_ = mode;
+	if (mode == RenderMode::Preview)
+		fullImage_ = QImage();
+	update();
+}
+
+void ImageItem::setFullImage(const QImage& image)
+{
+	fullImage_ = image;
+	setRenderMode(RenderMode::FullResolution);
+}
+
+qsizetype ImageItem::memoryUsage() const
+{
+	qsizetype bytes = data_.size() + fullImage_.sizeInBytes();
+	for (const QImage& level : levels_)
+		bytes += level.sizeInBytes();
+	return bytes;
+}
+
+QList<QImage> ImageItem::decodeLevels(const QByteArray& data, const QSize& size)
+{
+	QList<QImage> levels;
+	QBuffer buffer;
+	buffer.setData(data);
+	buffer.open(QIODevice::ReadOnly);
+	QImageReader reader(&buffer);
+	reader.setAutoTransform(true);
+
+	// Уменьшаем ещё при декодировании: JPEG при этом даже не распаковывается целиком
+	const QSize previewSize = size.scaled(size.boundedTo(QSize(MaxPreviewSide, MaxPreviewSide)), Qt::KeepAspectRatio);
+	if (previewSize != size)
+		reader.setScaledSize(storedSize(previewSize, reader.transformation()));
+
+	QImage image = reader.read();
+	if (image.isNull())
+		return levels;
+	image = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+	levels.append(image);
+	while (qMax(image.width(), image.height()) / 2 >= MinLevelSide)
+	{
+		image = image.scaled(image.width() / 2, image.height() / 2, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+		levels.append(image);
+	}
+	return levels;
+}
+
+void ImageItem::startLoading()
+{
+	if (loader_ || data_.isEmpty())
+		return;
+
+	loader_ = new QFutureWatcher<QList<QImage>>(this);
+	connect(loader_, &QFutureWatcher<QList<QImage>>::finished, this, [this]() {
+		levels_ = loader_->result();
+		update();
+	});
+	loader_->setFuture(QtConcurrent::run(&ImageItem::decodeLevels, data_, size_));
+}
+
+const QImage& ImageItem::levelFor(qreal pixelWidth) const
+{
+	// Самый маленький уровень, который ещё не меньше нужного размера на экране
+	for (int i = levels_.size() - 1; i > 0; --i)
+		if (levels_[i].width() >= pixelWidth)
+			return levels_[i];
+	return levels_.first();
+}
+
+QRectF ImageItem::boundingRect() const { return QRectF(QPointF(0, 0), size_); }
+
+void ImageItem::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget)
+{
+	Q_UNUSED(widget);
+	const QRectF rect = boundingRect();
+
+	if (renderMode_ == RenderMode::FullResolution)
+	{
+		if (fullImage_.isNull())
+			fullImage_ = fullImage();
+		painter->drawImage(rect, fullImage_);
+		return;
+	}
+
+	if (levels_.isEmpty())
+	{
+		startLoading();
+		// Пока картинка декодируется - рамка на её месте
+		painter->setPen(QPen(Qt::gray, 0, Qt::DashLine));
+		painter->setBrush(QColor(230, 230, 230));
+		painter->drawRect(rect);
+		return;
+	}
+
+	const qreal lod = option->levelOfDetailFromTransform(painter->worldTransform());
+	const QImage& level = levelFor(size_.width() * lod);
+	painter->save();
+	painter->setRenderHint(QPainter::SmoothPixmapTransform);
+	painter->drawImage(rect, level);
+	painter->restore();
+}
@@ -0,0 +1,66 @@
+#ifndef IMAGEITEM_H
+#define IMAGEITEM_H
+
+#include <QByteArray>
+#include <QFutureWatcher>
+#include <QGraphicsObject>
+#include <QImage>
+#include <QList>
+
+// Картинка, которая хранит исходный файл в сжатом виде. Для показа в фоне
+// декодируется уменьшенная копия и пирамида уровней (каждый вдвое меньше);
+// рисуется уровень под текущий масштаб. Полное разрешение декодируется
+// только в режиме FullResolution (экспорт).
+class ImageItem : public QGraphicsObject
+{
+	Q_OBJECT
+
+  public:
+	enum { Type = UserType + 3 };
+	static constexpr int MaxPreviewSide = 2048;
+	static constexpr int MinLevelSide = 32;
+
+	enum class RenderMode
+	{
+		Preview,
+		FullResolution
+	};
+
+	// Подходит ли data для ImageItem и каков размер картинки после поворота по EXIF
+	static bool probe(const QByteArray& data, QSize* size = nullptr);
+
+	explicit ImageItem(const QByteArray& data, QGraphicsItem* parent = nullptr);
+
+	int type() const override { return Type; }
+
+	const QByteArray& sourceData() const { return data_; }
+	QSize imageSize() const { return size_; }
+	QImage fullImage() const { return decode(data_); }
+	static QImage decode(const QByteArray& data);
+
+	void setRenderMode(RenderMode mode);
+	RenderMode renderMode() const { return renderMode_; }
+	// Уже декодированная картинка - чтобы копии сцены для экспорта не декодировали её каждая заново
+	void setFullImage(const QImage& image);
+
+	int levelCount() const { return levels_.size(); }
+	qsizetype memoryUsage() const;
+
+	QRectF boundingRect() const override;
+	void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget = nullptr) override;
+
+  private:
+	QByteArray data_;
+	QSize size_;
+	RenderMode renderMode_ = RenderMode::Preview;
+
+	QList<QImage> levels_;
+	QImage fullImage_;
+	QFutureWatcher<QList<QImage>>* loader_ = nullptr;
+
+	void startLoading();
+	const QImage& levelFor(qreal pixelWidth) const;
+	static QList<QImage> decodeLevels(const QByteArray& data, const QSize& size);
+};
+
+#endif // IMAGEITEM_H
@@ -0,0 +1,184 @@
+#include "instanceitem.h"
+#include "imageitem.h"
+#include "../helpers/sceneserializer.h"
+
+#include <QPainter>
+#include <QRandomGenerator>
+#include <QStyleOptionGraphicsItem>
+#include <QtMath>
+
+#include <cmath>
+#include <memory>
+
+namespace
+{
+	struct Registry
+	{
+		QMutex mutex;
+		QHash<quint64, QWeakPointer<InstanceSource>> sources;
+	};
+
+	Registry& registry()
+	{
+		static Registry instance;
+		return instance;
+	}
+
+	// Превью картинки декодируется в фоне и к моменту записи ещё не готово
+	void useFullResolution(QGraphicsItem* item)
+	{
+		if (auto image = qgraphicsitem_cast<ImageItem*>(item))
+			image->setRenderMode(ImageItem::RenderMode::FullResolution);
+		for (QGraphicsItem* child : item->childItems())
+			useFullResolution(child);
+	}
+
+	void paintTree(QPainter* painter, QGraphicsItem* item)
+	{
+		QStyleOptionGraphicsItem option;
+		option.exposedRect = item->boundingRect();
+		painter->save();
+		item->paint(painter, &option, nullptr);
+		painter->restore();
+
+		const QList<QGraphicsItem*> children = item->childItems();
+		for (QGraphicsItem* child : children)
+		{
+			painter->save();
+			painter->setTransform(child->itemTransform(item), true);
+			painter->setOpacity(painter->opacity() * child->opacity());
+			paintTree(painter, child);
+			painter->restore();
+		}
+	}
+}
+
+QSharedPointer<InstanceSource> InstanceSource::create(const QCborMap& map, quint64 id)
+{
+	if (id != 0)
+		if (QSharedPointer<InstanceSource> existing = find(id))
+			return existing;
+
+	while (id == 0)
+		id = QRandomGenerator::global()->generate64();
+	QSharedPointer<InstanceSource> source(new InstanceSource(map, id));
+
+	// Пока источник собирался, такой же мог появиться в другом потоке
+	QMutexLocker locker(&registry().mutex);
+	QWeakPointer<InstanceSource>& entry = registry().sources[id];
+	if (QSharedPointer<InstanceSource> existing = entry.toStrongRef())
+		return existing;
+	entry = source;
+	return source;
+}
+
+QSharedPointer<InstanceSource> InstanceSource::find(quint64 id)
+{
+	QMutexLocker locker(&registry().mutex);
+	return registry().sources.value(id).toStrongRef();
+}
+
+InstanceSource::InstanceSource(const QCborMap& map, quint64 id)
+	: id_(id), map_(map)
+{
+	// Источник стоит в начале координат копии, всё остальное у копии своё
+	for (const char* key : {"pos", "rotation", "scale", "origin", "z", "opacity", "transform", "flags", "id"})
+		map_.remove(QString::fromLatin1(key));
+
+	std::unique_ptr<QGraphicsItem> item(SceneSerializer::itemFromCbor(map_));
+	if (!item)
+		return;
+	useFullResolution(item.get());
+
+	bounds_ = item->boundingRect() | item->childrenBoundingRect();
+	if (item->childItems().isEmpty())
+		shape_ = item->shape();
+	else
+		shape_.addRect(bounds_);
+
+	QPainter painter(&picture_);
+	paintTree(&painter, item.get());
+}
+
+InstanceSource::~InstanceSource()
+{
+	QMutexLocker locker(&registry().mutex);
+	auto it = registry().sources.find(id_);
+	if (it != registry().sources.end() && it->isNull())
+		registry().sources.erase(it);
+}
+
+void InstanceSource::paint(QPainter* painter)
+{
+	// Масштаб, с которым источник попадёт на устройство
+	const qreal scale = qSqrt(qAbs(painter->worldTransform().determinant()));
+
+	QImage image;
+	int level = 0;
+	{
+		QMutexLocker locker(&mutex_);
+		if (scale > 0 && scale <= std::ldexp(1.0, MaxLevel))
+		{
+			level = qMax(MinLevel, qCeil(std::log2(scale)));
+			image = cached(level);
+		}
+		if (image.isNull())
+		{
+			// Крупнее самого большого уровня - рисуем векторно, без потери качества
+			painter->drawPicture(0, 0, picture_);
+			return;
+		}
+	}
+	painter->drawImage(QRectF(bounds_.topLeft(), QSizeF(image.size()) / std::ldexp(1.0, level)), image);
+}
+
+QImage InstanceSource::cached(int level)
+{
+	auto it = cache_.constFind(level);
+	if (it != cache_.constEnd())
+		return *it;
+
+	const qreal factor = std::ldexp(1.0, level);
+	const QSize size(qCeil(bounds_.width() * factor), qCeil(bounds_.height() * factor));
+	if (size.isEmpty() || size.width() > MaxCacheSide || size.height() > MaxCacheSide)
+		return QImage();
+
+	QImage image(size, QImage::Format_ARGB32_Premultiplied);
+	image.fill(Qt::transparent);
+	QPainter painter(&image);
+	painter.setRenderHints(QPainter::Antialiasing | QPainter::SmoothPixmapTransform | QPainter::TextAntialiasing);
+	painter.scale(factor, factor);
+	painter.translate(-bounds_.topLeft());
+	painter.drawPicture(0, 0, picture_);
+	painter.end();
+
+	cache_.insert(level, image);
+	return image;
+}
+
+qsizetype InstanceSource::memoryUsage() const
+{
+	QMutexLocker locker(&mutex_);
+	qsizetype bytes = picture_.size();
+	for (const QImage& image : cache_)
+		bytes += image.sizeInBytes();
+	return bytes;
+}
+
+InstanceItem::InstanceItem(const QSharedPointer<InstanceSource>& source, QGraphicsItem* parent)
+	: QGraphicsItem(parent), source_(source)
+{
+}
+
+void InstanceItem::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget)
+{
+	Q_UNUSED(widget);
+	source_->paint(painter);
+
+	if (option->state & QStyle::State_Selected)
+	{
+		painter->setPen(QPen(option->palette.windowText(), 0, Qt::DashLine));
+		painter->setBrush(Qt::NoBrush);
+		painter->drawRect(boundingRect());
+	}
+}
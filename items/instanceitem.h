@@ -0,0 +1,75 @@
+#ifndef INSTANCEITEM_H
+#define INSTANCEITEM_H
+
+#include <QCborMap>
+#include <QGraphicsItem>
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QPainterPath>
+#include <QPicture>
+#include <QSharedPointer>
+
+// Общий источник копий: элемент, записанный один раз в QPicture, его форма
+// и растровый кэш по уровням масштаба (каждый вдвое больше предыдущего).
+// Живые источники находятся по id - копии из файла, истории отмены и копий
+// сцены для экспорта получают один и тот же объект. Рисовать можно из любого
+// потока: QPicture и кэш защищены мьютексом.
+class InstanceSource
+{
+  public:
+	static constexpr int MinLevel = -3;
+	static constexpr int MaxLevel = 3;
+	static constexpr int MaxCacheSide = 4096;
+
+	// map - элемент в формате SceneSerializer; положение и преобразования из него отбрасываются
+	static QSharedPointer<InstanceSource> create(const QCborMap& map, quint64 id = 0);
+	// nullptr, если источника с таким id уже нет
+	static QSharedPointer<InstanceSource> find(quint64 id);
+
+	~InstanceSource();
+
+	quint64 id() const { return id_; }
+	const QCborMap& map() const { return map_; }
+	QRectF boundingRect() const { return bounds_; }
+	const QPainterPath& shape() const { return shape_; }
+
+	void paint(QPainter* painter);
+	qsizetype memoryUsage() const;
+
+  private:
+	InstanceSource(const QCborMap& map, quint64 id);
+
+	quint64 id_;
+	QCborMap map_;
+	QRectF bounds_;
+	QPainterPath shape_;
+
+	mutable QMutex mutex_;
+	QPicture picture_;
+	QHash<int, QImage> cache_; // ключ - log2 масштаба
+
+	QImage cached(int level);
+};
+
+// Лёгкая копия: своё у неё только положение и преобразование
+class InstanceItem : public QGraphicsItem
+{
+  public:
+	enum { Type = UserType + 4 };
+
+	explicit InstanceItem(const QSharedPointer<InstanceSource>& source, QGraphicsItem* parent = nullptr);
+
+	int type() const override { return Type; }
+
+	const QSharedPointer<InstanceSource>& source() const { return source_; }
+
+	QRectF boundingRect() const override { return source_->boundingRect(); }
+	QPainterPath shape() const override { return source_->shape(); }
+	void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget = nullptr) override;
+
+  private:
+	QSharedPointer<InstanceSource> source_;
+};
+
+#endif // INSTANCEITEM_H
@@ -0,0 +1,17 @@
+#include "levelofdetail.h"
+
+#include <QVariant>
+
+bool LevelOfDetail::isTiny(const QRectF& bounds, const QStyleOptionGraphicsItem* option, const QPainter* painter,
+						   const QWidget* widget)
+{
+	if (!widget || !widget->property(Property).toBool())
+		return false;
+	const qreal lod = option->levelOfDetailFromTransform(painter->worldTransform());
+	return qMax(bounds.width(), bounds.height()) * lod < TinySize;
+}
+
+void LevelOfDetail::drawSubstitute(QPainter* painter, const QRectF& bounds, const QColor& color)
+{
+	painter->fillRect(bounds, color);
+}
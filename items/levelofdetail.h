@@ -0,0 +1,24 @@
+#ifndef LEVELOFDETAIL_H
+#define LEVELOFDETAIL_H
+
+#include <QColor>
+#include <QPainter>
+#include <QRectF>
+#include <QStyleOptionGraphicsItem>
+#include <QWidget>
+
+// Упрощённая отрисовка элементов, которые на экране меньше пары пикселей.
+// Включается свойством viewport (см. PaintWidget::setPerformanceMode), поэтому
+// при рендере в картинку (widget == nullptr) элементы всегда рисуются полностью.
+// Упрощаются только штрихи - их в рисунке тысячи. Картинки и копии уже рисуются
+// с уровня пирамиды под масштаб, а стандартные фигуры и текст Qt рисует сам.
+namespace LevelOfDetail
+{
+	inline constexpr char Property[] = "levelOfDetail";
+	inline constexpr qreal TinySize = 3;
+
+	bool isTiny(const QRectF& bounds, const QStyleOptionGraphicsItem* option, const QPainter* painter, const QWidget* widget);
+	void drawSubstitute(QPainter* painter, const QRectF& bounds, const QColor& color);
+}
+
+#endif // LEVELOFDETAIL_H
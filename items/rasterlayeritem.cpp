@@ -0,0 +1,262 @@
+#include "rasterlayeritem.h"
+
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+#include <QtMath>
+
+#include <cstring>
+
+RasterLayerItem::RasterLayerItem(QGraphicsItem* parent)
+	: QGraphicsObject(parent)
+{
+	setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
+}
+
+void RasterLayerItem::drawLine(const QLineF& line, const QPen& pen) { paintSegment(line, pen, false); }
+
+void RasterLayerItem::eraseLine(const QLineF& line, qreal width)
+{
+	QPen pen(Qt::transparent, width, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin);
+	paintSegment(line, pen, true);
+}
+
+void RasterLayerItem::paintSegment(const QLineF& line, const QPen& pen, bool erase)
+{
+	const qreal margin = pen.widthF() / 2 + 2;
+	const QRectF dirty = QRectF(line.p1(), line.p2()).normalized().adjusted(-margin, -margin, margin, margin);
+
+	const int left = qFloor(dirty.left() / TileSize);
+	const int right = qFloor(dirty.right() / TileSize);
+	const int top = qFloor(dirty.top() / TileSize);
+	const int bottom = qFloor(dirty.bottom() / TileSize);
+
+	for (int ty = top; ty <= bottom; ++ty)
+	{
+		for (int tx = left; tx <= right; ++tx)
+		{
+			// Стирать там, где ничего не нарисовано, незачем
+			QImage* image = tile(tx, ty, !erase);
+			if (!image)
+				continue;
+
+			QPainter painter(image);
+			painter.setRenderHint(QPainter::Antialiasing);
+			painter.translate(-tx * TileSize, -ty * TileSize);
+			if (erase)
+				painter.setCompositionMode(QPainter::CompositionMode_Clear);
+			painter.setPen(pen);
+			if (line.p1() == line.p2())
+				painter.drawPoint(line.p1());
+			else
+				painter.drawLine(line);
+			if (erase)
+				touchedTiles_.insert(tileKey(tx, ty));
+		}
+	}
+	update(dirty);
+}
+
+QImage* RasterLayerItem::tile(int tx, int ty, bool create)
+{
+	const quint64 key = tileKey(tx, ty);
+	QImage* existing = residentTile(key);
+	if (capturing_ && !captured_.contains(key))
+		captured_.insert(key, existing ? *existing : QImage());
+
+	if (existing)
+		return existing;
+	if (!create)
+		return nullptr;
+
+	QImage image(TileSize, TileSize, QImage::Format_ARGB32_Premultiplied);
+	image.fill(Qt::transparent);
+
+	const QRectF tileRect(tx * TileSize, ty * TileSize, TileSize, TileSize);
+	if (!bounds_.contains(tileRect))
+	{
+		prepareGeometryChange();
+		bounds_ = bounds_.isNull() ? tileRect : bounds_.united(tileRect);
+	}
+	return &tiles_.insert(key, image).value();
+}
+
+void RasterLayerItem::compact()
+{
+	// Полностью стёртые плитки освобождаем, чтобы память следовала за рисунком
+	for (quint64 key : std::as_const(touchedTiles_))
+	{
+		auto it = tiles_.find(key);
+		if (it == tiles_.end())
+			continue;
+
+		const QImage& image = it.value();
+		bool isEmpty = true;
+		for (int y = 0; y < image.height() && isEmpty; ++y)
+		{
+			const QRgb* line = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+			for (int x = 0; x < image.width(); ++x)
+			{
+				if (qAlpha(line[x]) != 0)
+				{
+					isEmpty = false;
+					break;
+				}
+			}
+		}
+		if (isEmpty)
+			tiles_.erase(it);
+	}
+	touchedTiles_.clear();
+}
+
+QImage* RasterLayerItem::residentTile(quint64 key) const
+{
+	auto it = tiles_.find(key);
+	if (it != tiles_.end())
+		return &it.value();
+
+	auto paged = pagedTiles_.find(key);
+	if (paged == pagedTiles_.end())
+		return nullptr;
+	const QImage image = unpack(paged.value());
+	pagedTiles_.erase(paged);
+	return &tiles_.insert(key, image).value();
+}
+
+QRectF RasterLayerItem::tileRect(quint64 key)
+{
+	return QRectF(qint32(key >> 32) * qreal(TileSize), qint32(key & 0xffffffff) * qreal(TileSize), TileSize, TileSize);
+}
+
+QByteArray RasterLayerItem::pack(const QImage& image)
+{
+	// Быстрое сжатие: плитка уходит из памяти при каждой прокрутке
+	return qCompress(image.constBits(), image.sizeInBytes(), 1);
+}
+
+QImage RasterLayerItem::unpack(const QByteArray& data)
+{
+	QImage image(TileSize, TileSize, QImage::Format_ARGB32_Premultiplied);
+	const QByteArray raw = qUncompress(data);
+	if (raw.size() == image.sizeInBytes())
+		std::memcpy(image.bits(), raw.constData(), raw.size());
+	else
+		image.fill(Qt::transparent);
+	return image;
+}
+
+void RasterLayerItem::setResidentRect(const QRectF& rect)
+{
+	residentRect_ = rect;
+	if (rect.isNull())
+		return;
+
+	for (auto it = tiles_.begin(); it != tiles_.end();)
+	{
+		// Плитки, ждущие compact(), и плитки нестандартного вида не трогаем
+		const QImage& image = it.value();
+		if (rect.intersects(tileRect(it.key())) || touchedTiles_.contains(it.key())
+			|| image.size() != QSize(TileSize, TileSize) || image.format() != QImage::Format_ARGB32_Premultiplied)
+		{
+			++it;
+			continue;
+		}
+		pagedTiles_.insert(it.key(), pack(image));
+		it = tiles_.erase(it);
+	}
+}
+
+void RasterLayerItem::clear()
+{
+	prepareGeometryChange();
+	tiles_.clear();
+	pagedTiles_.clear();
+	touchedTiles_.clear();
+	bounds_ = QRectF();
+}
+
+QList<QPoint> RasterLayerItem::tileCoordinates() const
+{
+	QList<QPoint> result;
+	result.reserve(tileCount());
+	for (auto it = tiles_.constBegin(); it != tiles_.constEnd(); ++it)
+		result.append(QPoint(qint32(it.key() >> 32), qint32(it.key() & 0xffffffff)));
+	for (auto it = pagedTiles_.constBegin(); it != pagedTiles_.constEnd(); ++it)
+		result.append(QPoint(qint32(it.key() >> 32), qint32(it.key() & 0xffffffff)));
+	return result;
+}
+
+QImage RasterLayerItem::tileImage(const QPoint& tile) const
+{
+	// Сжатую плитку отдаём копией, не возвращая её в память слоя
+	const quint64 key = tileKey(tile.x(), tile.y());
+	auto it = tiles_.constFind(key);
+	if (it != tiles_.constEnd())
+		return it.value();
+	auto paged = pagedTiles_.constFind(key);
+	return paged != pagedTiles_.constEnd() ? unpack(paged.value()) : QImage();
+}
+
+void RasterLayerItem::setTileImage(const QPoint& tile, const QImage& image)
+{
+	QImage* target = this->tile(tile.x(), tile.y(), true);
+	*target = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+	update(QRectF(tile.x() * TileSize, tile.y() * TileSize, TileSize, TileSize));
+}
+
+void RasterLayerItem::removeTile(const QPoint& tile)
+{
+	const quint64 key = tileKey(tile.x(), tile.y());
+	const bool removed = tiles_.remove(key);
+	if (pagedTiles_.remove(key) || removed)
+		update(QRectF(tile.x() * TileSize, tile.y() * TileSize, TileSize, TileSize));
+}
+
+void RasterLayerItem::beginCapture()
+{
+	capturing_ = true;
+	captured_.clear();
+}
+
+QHash<QPoint, QImage> RasterLayerItem::endCapture()
+{
+	QHash<QPoint, QImage> result;
+	for (auto it = captured_.constBegin(); it != captured_.constEnd(); ++it)
+		result.insert(QPoint(qint32(it.key() >> 32), qint32(it.key() & 0xffffffff)), it.value());
+	capturing_ = false;
+	captured_.clear();
+	return result;
+}
+
+qsizetype RasterLayerItem::memoryUsage() const
+{
+	qsizetype usage = qsizetype(tiles_.size()) * TileSize * TileSize * 4;
+	for (const QByteArray& data : std::as_const(pagedTiles_))
+		usage += data.size();
+	return usage;
+}
+
+QRectF RasterLayerItem::boundingRect() const { return bounds_; }
+
+void RasterLayerItem::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget)
+{
+	Q_UNUSED(widget);
+
+	const QRectF exposed = option->exposedRect.isValid() ? option->exposedRect.intersected(bounds_) : bounds_;
+	if (exposed.isEmpty())
+		return;
+
+	const int left = qFloor(exposed.left() / TileSize);
+	const int right = qFloor(exposed.right() / TileSize);
+	const int top = qFloor(exposed.top() / TileSize);
+	const int bottom = qFloor(exposed.bottom() / TileSize);
+
+	for (int ty = top; ty <= bottom; ++ty)
+	{
+		for (int tx = left; tx <= right; ++tx)
+		{
+			if (const QImage* image = residentTile(tileKey(tx, ty)))
+				painter->drawImage(QPointF(tx * TileSize, ty * TileSize), *image);
+		}
+	}
+}
@@ -0,0 +1,72 @@
+#ifndef RASTERLAYERITEM_H
+#define RASTERLAYERITEM_H
+
+#include <QGraphicsObject>
+#include <QByteArray>
+#include <QHash>
+#include <QImage>
+#include <QPen>
+#include <QSet>
+
+// Растровый слой из плиток TileSize x TileSize. Плитка создаётся при первом
+// касании кистью, перерисовывается только изменённый прямоугольник.
+// Плитки вне residentRect хранятся сжатыми и распаковываются при первом обращении.
+class RasterLayerItem : public QGraphicsObject
+{
+	Q_OBJECT
+
+  public:
+	enum { Type = UserType + 2 };
+	static constexpr int TileSize = 256;
+
+	explicit RasterLayerItem(QGraphicsItem* parent = nullptr);
+
+	int type() const override { return Type; }
+
+	void drawLine(const QLineF& line, const QPen& pen);
+	void eraseLine(const QLineF& line, qreal width);
+	void compact();
+	void clear();
+
+	QList<QPoint> tileCoordinates() const;
+	QImage tileImage(const QPoint& tile) const;
+	void setTileImage(const QPoint& tile, const QImage& image);
+	void removeTile(const QPoint& tile);
+
+	// Исходный вид плиток, которых коснулись после beginCapture (пустой QImage - плитки не было)
+	void beginCapture();
+	QHash<QPoint, QImage> endCapture();
+
+	// Пустой прямоугольник - сжатые плитки распаковываются только по мере отрисовки
+	void setResidentRect(const QRectF& rect);
+	QRectF residentRect() const { return residentRect_; }
+
+	int tileCount() const { return tiles_.size() + pagedTiles_.size(); }
+	int residentTileCount() const { return tiles_.size(); }
+	qsizetype memoryUsage() const;
+
+	QRectF boundingRect() const override;
+	void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget = nullptr) override;
+
+  private:
+	static quint64 tileKey(int tx, int ty) { return (quint64(quint32(tx)) << 32) | quint32(ty); }
+
+	// Распаковка при отрисовке меняет только способ хранения, поэтому mutable
+	mutable QHash<quint64, QImage> tiles_;
+	mutable QHash<quint64, QByteArray> pagedTiles_;
+	QRectF residentRect_;
+	QRectF bounds_;
+	QSet<quint64> touchedTiles_;
+	bool capturing_ = false;
+	QHash<quint64, QImage> captured_;
+
+	void paintSegment(const QLineF& line, const QPen& pen, bool erase);
+	QImage* tile(int tx, int ty, bool create);
+	QImage* residentTile(quint64 key) const;
+
+	static QRectF tileRect(quint64 key);
+	static QByteArray pack(const QImage& image);
+	static QImage unpack(const QByteArray& data);
+};
+
+#endif // RASTERLAYERITEM_H
@@ -0,0 +1,168 @@
+#include "strokeitem.h"
+#include "levelofdetail.h"
+#include "../helpers/pathsimplifier.h"
+
+#include <QPainter>
+
+StrokeItem::StrokeItem(const QPen& pen, const QPointF& startPoint, qreal pressure, QGraphicsItem* parent)
+	: QGraphicsPathItem(parent)
+{
+	setPen(pen);
+	setPos(startPoint);
+	points_.append(QPointF(0, 0));
+	if (pressure >= 0)
+		widths_.append(widthForPressure(pressure));
+	pointsBounds_ = QRectF(0, 0, 0, 0);
+}
+
+qreal StrokeItem::widthForPressure(qreal pressure) const
+{
+	// Совсем лёгкое касание всё равно оставляет след
+	return pen().widthF() * qBound<qreal>(0.1, pressure, 1);
+}
+
+void StrokeItem::addPoint(const QPointF& scenePoint, qreal pressure)
+{
+	addPoints(QPolygonF{scenePoint}, {pressure});
+}
+
+void StrokeItem::addPoints(const QPolygonF& scenePoints, const QList<qreal>& pressures)
+{
+	if (!isDrawing_)
+		return;
+
+	QRectF dirty;
+	QRectF bounds = pointsBounds_;
+	for (int i = 0; i < scenePoints.size(); ++i)
+	{
+		const QPointF point = mapFromScene(scenePoints[i]);
+		const QPointF lastPoint = points_.last();
+		if (point == lastPoint)
+			continue;
+
+		bounds.setLeft(qMin(bounds.left(), point.x()));
+		bounds.setRight(qMax(bounds.right(), point.x()));
+		bounds.setTop(qMin(bounds.top(), point.y()));
+		bounds.setBottom(qMax(bounds.bottom(), point.y()));
+		points_.append(point);
+		if (!widths_.isEmpty())
+		{
+			const qreal pressure = i < pressures.size() ? pressures[i] : -1;
+			widths_.append(pressure >= 0 ? widthForPressure(pressure) : widths_.last());
+		}
+		dirty |= QRectF(lastPoint, point).normalized();
+	}
+	if (dirty.isNull() && bounds == pointsBounds_)
+		return;
+
+	if (bounds != pointsBounds_)
+	{
+		prepareGeometryChange();
+		pointsBounds_ = bounds;
+	}
+
+	// Перерисовываем только новые отрезки
+	const qreal margin = halfPenWidth() + 1;
+	update(dirty.adjusted(-margin, -margin, margin, margin));
+}
+
+void StrokeItem::finish(qreal tolerance, bool smooth)
+{
+	if (!isDrawing_)
+		return;
+
+	const QList<int> indices = PathSimplifier::simplifyIndices(points_, tolerance);
+	QPolygonF points;
+	QList<qreal> widths;
+	points.reserve(indices.size());
+	for (int index : indices)
+	{
+		points.append(points_[index]);
+		if (!widths_.isEmpty())
+			widths.append(widths_[index]);
+	}
+	setPoints(points, smooth, widths);
+}
+
+void StrokeItem::setPoints(const QPolygonF& points, bool smooth, const QList<qreal>& widths)
+{
+	prepareGeometryChange();
+	isDrawing_ = false;
+	points_ = points;
+	widths_ = widths.size() == points.size() ? widths : QList<qreal>();
+	pointsBounds_ = points_.boundingRect();
+
+	if (!widths_.isEmpty())
+	{
+		// Контур переменной толщины не сглаживаем: точки и так идут часто
+		isSmoothed_ = false;
+		setBrush(pen().color());
+		setPath(PathSimplifier::toVariableWidthPath(points_, widths_));
+		return;
+	}
+	isSmoothed_ = smooth;
+	setBrush(Qt::NoBrush);
+	setPath(smooth ? PathSimplifier::toSmoothPath(points_) : PathSimplifier::toPolylinePath(points_));
+}
+
+QRectF StrokeItem::boundingRect() const
+{
+	if (!isDrawing_)
+		return QGraphicsPathItem::boundingRect();
+	const qreal margin = halfPenWidth() + 1;
+	return pointsBounds_.adjusted(-margin, -margin, margin, margin);
+}
+
+QPainterPath StrokeItem::shape() const
+{
+	if (!isDrawing_)
+		return QGraphicsPathItem::shape();
+	QPainterPath path;
+	path.addRect(boundingRect());
+	return path;
+}
+
+void StrokeItem::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget)
+{
+	if (!isDrawing_)
+	{
+		if (LevelOfDetail::isTiny(boundingRect(), option, painter, widget))
+			LevelOfDetail::drawSubstitute(painter, boundingRect(), pen().color());
+		else if (!widths_.isEmpty())
+		{
+			painter->setPen(Qt::NoPen);
+			painter->setBrush(brush());
+			painter->drawPath(path());
+		}
+		else
+			QGraphicsPathItem::paint(painter, option, widget);
+		return;
+	}
+
+	painter->setBrush(Qt::NoBrush);
+	if (!widths_.isEmpty())
+	{
+		// Отрезок рисуется толщиной его конечной точки - до отпускания этого достаточно
+		QPen segmentPen = pen();
+		if (points_.size() == 1)
+		{
+			segmentPen.setWidthF(widths_.first());
+			painter->setPen(segmentPen);
+			painter->drawPoint(points_.first());
+			return;
+		}
+		for (int i = 1; i < points_.size(); ++i)
+		{
+			segmentPen.setWidthF(widths_[i]);
+			painter->setPen(segmentPen);
+			painter->drawLine(points_[i - 1], points_[i]);
+		}
+		return;
+	}
+
+	painter->setPen(pen());
+	if (points_.size() == 1)
+		painter->drawPoint(points_.first());
+	else
+		painter->drawPolyline(points_);
+}
@@ -0,0 +1,48 @@
+#ifndef STROKEITEM_H
+#define STROKEITEM_H
+
+#include <QGraphicsPathItem>
+#include <QPolygonF>
+
+// Один штрих кисти - один элемент сцены. Пока штрих рисуется, точки
+// копятся в полилинии; после отпускания мыши она упрощается в путь.
+// Штрих пером планшета хранит толщину в каждой точке и рисуется залитым контуром.
+class StrokeItem : public QGraphicsPathItem
+{
+  public:
+	enum { Type = UserType + 1 };
+
+	// pressure в [0, 1]; отрицательное значение - нажим неизвестен, толщина постоянная
+	StrokeItem(const QPen& pen, const QPointF& startPoint, qreal pressure = -1, QGraphicsItem* parent = nullptr);
+
+	int type() const override { return Type; }
+
+	void addPoint(const QPointF& scenePoint, qreal pressure = -1);
+	// Пачка точек за кадр: одна перерисовка на всю пачку
+	void addPoints(const QPolygonF& scenePoints, const QList<qreal>& pressures);
+	void finish(qreal tolerance, bool smooth);
+	void setPoints(const QPolygonF& points, bool smooth, const QList<qreal>& widths = {});
+
+	bool isDrawing() const { return isDrawing_; }
+	bool isSmoothed() const { return isSmoothed_; }
+	const QPolygonF& points() const { return points_; }
+	// Пусто, если толщина постоянная
+	const QList<qreal>& widths() const { return widths_; }
+	bool hasVariableWidth() const { return !widths_.isEmpty(); }
+
+	QRectF boundingRect() const override;
+	QPainterPath shape() const override;
+	void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget = nullptr) override;
+
+  private:
+	QPolygonF points_;
+	QList<qreal> widths_;
+	QRectF pointsBounds_;
+	bool isDrawing_ = true;
+	bool isSmoothed_ = false;
+
+	qreal halfPenWidth() const { return qMax<qreal>(0.5, pen().widthF() / 2); }
+	qreal widthForPressure(qreal pressure) const;
+};
+
+#endif // STROKEITEM_H
@@ -1,11 +1,30 @@
 #include "mainwindow.h"
+#include "helpers/batchrunner.h"
+#include "helpers/startupreport.h"
 
 #include <QApplication>
 
 int main(int argc, char *argv[])
 {
+	StartupReport::start();
+	if (BatchRunner::isBatch(argc, argv))
+	{
+		// Окна не создаются, сцены рисуются в QImage - дисплей не нужен
+		if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM"))
+			qputenv("QT_QPA_PLATFORM", "offscreen");
+		QApplication a(argc, argv);
+		return BatchRunner::run(a.arguments());
+	}
+
 	QApplication a(argc, argv);
+	// Для QSettings: там хранится список вкладок прошлой сессии
+	QApplication::setOrganizationName("ertewi");
+	QApplication::setApplicationName("TextEditor-And-Paint");
+	StartupReport::mark("application created");
 	MainWindow w;
+	StartupReport::mark("main window created");
+	StartupReport::finishOnFirstPaint(&w);
 	w.show();
+	StartupReport::mark("window shown");
 	return a.exec();
 }
@@ -1,10 +1,14 @@
 #include "mainwindow.h"
 #include "./ui_mainwindow.h"
 #include "widgets/sceneeditwidget.h"
+#include "widgets/tabplaceholder.h"
 #include "widgets/tableeditwidget.h"
 #include "widgets/texteditwidget.h"
+#include "helpers/startupreport.h"
+#include "helpers/trace.h"
 
 #include <QCloseEvent>
+#include <QDir>
 #include <QInputDialog>
 #include <QClipboard>
 #include <QColorDialog>
@@ -17,10 +21,25 @@
 #include <QTextEdit>
 #include <QTextStream>
 
+namespace
+{
+	// Время последнего открытия вкладки по MainWindow::clock_
+	constexpr char LastActiveProperty[] = "lastActiveMs";
+}
+
 MainWindow::MainWindow(QWidget *parent)
 	: QMainWindow(parent), ui(new Ui::MainWindow)
 {
 	ui->setupUi(this);
+
+	clock_.start();
+	connect(ui->tabWidget, &QTabWidget::currentChanged, this, &MainWindow::onCurrentTabChanged);
+	unloadTimer_ = new QTimer(this);
+	connect(unloadTimer_, &QTimer::timeout, this, &MainWindow::unloadIdleTabs);
+	unloadTimer_->start(IdleCheckIntervalMs);
+	frameOverlay_ = new FrameOverlay(this);
+
+	restoreSession();
 }
 
 MainWindow::~MainWindow() { delete ui; }
@@ -49,8 +68,9 @@ bool MainWindow::maybeSave(IEditableWidget* widget)
 
 void MainWindow::on_tabWidget_tabCloseRequested(int index)
 {
-	IEditableWidget* widget = dynamic_cast<IEditableWidget*>(ui->tabWidget->widget(index));
-	if (widget && maybeSave(widget))
+	QWidget* tab = ui->tabWidget->widget(index);
+	IEditableWidget* widget = dynamic_cast<IEditableWidget*>(tab);
+	if ((widget && maybeSave(widget)) || qobject_cast<TabPlaceholder*>(tab))
 		ui->tabWidget->removeTab(index);
 }
 
@@ -64,7 +84,7 @@ void MainWindow::onFileModified(IEditableWidget* widget)
 void MainWindow::on_actionOpen_triggered()
 {
 	QString filePath = QFileDialog::getOpenFileName(this, tr("Open File"), "",
-	tr("All (*txt *html *csv *json);;Text Files (*.txt *.html);;Table Files (*csv);;Interactive scene (*json)"));
+	tr("All (*txt *html *csv *json *cbor);;Text Files (*.txt *.html);;Table Files (*csv);;Interactive scene (*json *cbor)"));
 
 	if (filePath.isEmpty())
 	{
@@ -80,6 +100,19 @@ void MainWindow::on_actionOpen_triggered()
 
 void MainWindow::on_actionFind_triggered()
 {
+	if (TableEditWidget *tableEdit = qobject_cast<TableEditWidget*>(ui->tabWidget->currentWidget()))
+	{
+		TableSearchOptions options;
+		if (!askTableSearchOptions(tableEdit, options))
+			return;
+		int found = tableEdit->find(options);
+		if (found == 0)
+			QMessageBox::information(this, tr("Find Text"), tr("Text not found."));
+		else
+			ui->statusbar->showMessage(tr("Found in %n cell(s). F3 and Shift+F3 move between them.", nullptr, found), 5000);
+		return;
+	}
+
 	TextEditWidget *textEdit = qobject_cast<TextEditWidget*>(ui->tabWidget->currentWidget());
 	if (!textEdit)
 		return;
@@ -91,6 +124,79 @@ void MainWindow::on_actionFind_triggered()
 		textEdit->find(searchText);
 }
 
+void MainWindow::on_actionFind_Next_triggered()
+{
+	TableEditWidget *tableEdit = qobject_cast<TableEditWidget*>(ui->tabWidget->currentWidget());
+	if (tableEdit && !tableEdit->findNext())
+		on_actionFind_triggered();
+}
+
+void MainWindow::on_actionFind_Previous_triggered()
+{
+	TableEditWidget *tableEdit = qobject_cast<TableEditWidget*>(ui->tabWidget->currentWidget());
+	if (tableEdit && !tableEdit->findPrevious())
+		on_actionFind_triggered();
+}
+
+void MainWindow::on_actionReplace_triggered()
+{
+	TableEditWidget *tableEdit = qobject_cast<TableEditWidget*>(ui->tabWidget->currentWidget());
+	if (!tableEdit)
+		return;
+
+	TableSearchOptions options;
+	if (!askTableSearchOptions(tableEdit, options))
+		return;
+
+	bool ok;
+	QString replacement =
+		QInputDialog::getText(this, tr("Replace"), tr("Replace with:"), QLineEdit::Normal, "", &ok);
+	if (!ok)
+		return;
+
+	int replaced = tableEdit->replaceAll(options, replacement);
+	QMessageBox::information(this, tr("Replace"), tr("Replaced in %n cell(s).", nullptr, replaced));
+}
+
+bool MainWindow::askTableSearchOptions(QWidget* tableWidget, TableSearchOptions& options)
+{
+	TableEditWidget *tableEdit = qobject_cast<TableEditWidget*>(tableWidget);
+	if (!tableEdit)
+		return false;
+
+	bool ok;
+	options.pattern =
+		QInputDialog::getText(this, tr("Find Text"), tr("Enter text to find:"), QLineEdit::Normal, options.pattern, &ok);
+	if (!ok || options.pattern.isEmpty())
+		return false;
+
+	QStringList modes = {tr("Plain text"), tr("Plain text (match case)"), tr("Regular expression")};
+	QString mode = QInputDialog::getItem(this, tr("Find Text"), tr("Search mode:"), modes, 0, false, &ok);
+	if (!ok)
+		return false;
+	options.isRegex = (mode == modes[2]);
+	options.caseSensitivity = (mode == modes[1]) ? Qt::CaseSensitive : Qt::CaseInsensitive;
+
+	QList<int> selectedColumns = tableEdit->selectedColumns();
+	if (!selectedColumns.isEmpty())
+	{
+		QStringList scopes = {tr("Whole table"), tr("Selected columns")};
+		QString scope = QInputDialog::getItem(this, tr("Find Text"), tr("Search in:"), scopes, 0, false, &ok);
+		if (!ok)
+			return false;
+		if (scope == scopes[1])
+			options.columns = selectedColumns;
+	}
+
+	QString errorString;
+	if (!TableSearch::isValid(options, &errorString))
+	{
+		QMessageBox::warning(this, tr("Find Text"), errorString);
+		return false;
+	}
+	return true;
+}
+
 bool MainWindow::on_actionSave_triggered()
 {
 	if(! isTabSelected()) return false;
@@ -129,7 +235,7 @@ bool MainWindow::on_actionSave_as_triggered()
 				filePath = QFileDialog::getSaveFileName(this, tr("Save File"), widget->getFileName(), tr("Table Files (*.csv)"));
 				break;
 			case WorkType::InteractiveScene:
-				filePath = QFileDialog::getSaveFileName(this, tr("Save File"), widget->getFileName(), tr("Interactive Scene (*.json)"));
+				filePath = QFileDialog::getSaveFileName(this, tr("Save File"), widget->getFileName(), tr("Interactive Scene (*.json);;Binary Scene (*.cbor)"));
 				break;
 			default:
 				return false;
@@ -148,39 +254,195 @@ bool MainWindow::on_actionSave_as_triggered()
 
 QWidget* MainWindow::initilizeTab(WorkType worktype)
 {
-	QWidget* editWidget = nullptr;
+	QWidget* editWidget = createEditWidget(worktype);
+	if (editWidget == nullptr)
+		return nullptr;
+
+	int index = ui->tabWidget->addTab(editWidget, parseToEditableWidget(editWidget)->getFileName());
+	ui->tabWidget->setCurrentIndex(index);
+	return editWidget;
+}
+
+QWidget* MainWindow::createEditWidget(WorkType worktype)
+{
+	QElapsedTimer timer;
+	timer.start();
+	QWidget* editWidget = buildEditWidget(worktype);
+	// Первое построение каждого редактора - самое долгое: форма, иконки, подсистемы
+	if (editWidget != nullptr)
+		StartupReport::record(QStringLiteral("first %1 editor").arg(editWidget->metaObject()->className()),
+							  timer.nsecsElapsed() / 1e6);
+	return editWidget;
+}
 
-	int index = -1;
+QWidget* MainWindow::buildEditWidget(WorkType worktype)
+{
 	switch(worktype)
 	{
 	case WorkType::Text :
-		editWidget = new TextEditWidget(ui->tabWidget);
-		connect(qobject_cast<TextEditWidget*>(editWidget), &TextEditWidget::textModified, this, &MainWindow::onFileModified);
-		index = ui->tabWidget->addTab(editWidget, qobject_cast<TextEditWidget*>(editWidget)->getFileName());
-		break;
+	{
+		TextEditWidget* textWidget = new TextEditWidget(ui->tabWidget);
+		connect(textWidget, &TextEditWidget::textModified, this, &MainWindow::onFileModified);
+		return textWidget;
+	}
 	case WorkType::Table :
-		editWidget = new TableEditWidget(ui->tabWidget);
-		connect(qobject_cast<TableEditWidget*>(editWidget), &TableEditWidget::tableModified, this, &MainWindow::onFileModified);
-		index = ui->tabWidget->addTab(editWidget, qobject_cast<TableEditWidget*>(editWidget)->getFileName());
-		break;
+	{
+		TableEditWidget* tableWidget = new TableEditWidget(ui->tabWidget);
+		connect(tableWidget, &TableEditWidget::tableModified, this, &MainWindow::onFileModified);
+		return tableWidget;
+	}
 	case WorkType::InteractiveScene :
-		editWidget = new SceneEditWidget(ui->tabWidget);
-		connect(qobject_cast<SceneEditWidget*>(editWidget), &SceneEditWidget::sceneModified, this, &MainWindow::onFileModified);
-		index = ui->tabWidget->addTab(editWidget, qobject_cast<SceneEditWidget*>(editWidget)->getFileName());
-		break;
+	{
+		SceneEditWidget* sceneWidget = new SceneEditWidget(ui->tabWidget);
+		connect(sceneWidget, &SceneEditWidget::sceneModified, this, &MainWindow::onFileModified);
+		return sceneWidget;
+	}
 	default:
-		break;
+		return nullptr;
 	}
-	ui->tabWidget->setCurrentIndex(index);
+}
+
+void MainWindow::addPlaceholderTab(const QString& filePath)
+{
+	TabPlaceholder* placeholder = new TabPlaceholder(filePath, ui->tabWidget);
+	int index = ui->tabWidget->addTab(placeholder, placeholder->fileName());
+	ui->tabWidget->setTabToolTip(index, filePath);
+}
+
+QWidget* MainWindow::materializeTab(int index)
+{
+	TabPlaceholder* placeholder = qobject_cast<TabPlaceholder*>(ui->tabWidget->widget(index));
+	if (placeholder == nullptr)
+		return ui->tabWidget->widget(index);
+
+	QWidget* editWidget = createEditWidget(placeholder->workType());
+	if (editWidget == nullptr)
+		return nullptr;
+	parseToEditableWidget(editWidget)->openFile(placeholder->filePath());
+	replaceTab(index, editWidget);
 	return editWidget;
 }
 
+void MainWindow::replaceTab(int index, QWidget* widget)
+{
+	QWidget* oldWidget = ui->tabWidget->widget(index);
+	const bool isCurrent = ui->tabWidget->currentIndex() == index;
+
+	// Одна из двух сторон замены - всегда заглушка, путь берётся у неё
+	TabPlaceholder* placeholder = qobject_cast<TabPlaceholder*>(widget);
+	IEditableWidget* editable = parseToEditableWidget(widget);
+	const QString title = editable ? editable->getFileName() : placeholder->fileName();
+	if (placeholder == nullptr)
+		placeholder = qobject_cast<TabPlaceholder*>(oldWidget);
+	const QString toolTip = placeholder ? placeholder->filePath() : ui->tabWidget->tabToolTip(index);
+
+	// Пока вкладка снята, текущей становится соседняя - её загружать не нужно
+	isReplacingTab_ = true;
+	ui->tabWidget->removeTab(index);
+	ui->tabWidget->insertTab(index, widget, title);
+	ui->tabWidget->setTabToolTip(index, toolTip);
+	if (isCurrent)
+		ui->tabWidget->setCurrentIndex(index);
+	isReplacingTab_ = false;
+
+	oldWidget->deleteLater();
+}
+
+void MainWindow::onCurrentTabChanged(int index)
+{
+	if (isReplacingTab_ || index < 0)
+		return;
+
+	// Время простоя вкладки считается с момента, когда с неё ушли
+	if (activeTab_)
+		activeTab_->setProperty(LastActiveProperty, clock_.elapsed());
+	activeTab_ = materializeTab(index);
+	if (activeTab_)
+	{
+		activeTab_->setProperty(LastActiveProperty, clock_.elapsed());
+		StartupReport::mark(StartupReport::FirstTabReady);
+	}
+}
+
+void MainWindow::unloadIdleTabs()
+{
+	for (int i = 0; i < ui->tabWidget->count(); ++i)
+	{
+		QWidget* widget = ui->tabWidget->widget(i);
+		if (widget == activeTab_)
+			continue;
+
+		// Заглушка не хранит правок и истории, поэтому выгружаются только сохранённые документы
+		IEditableWidget* editable = parseToEditableWidget(widget);
+		if (!editable || editable->isModified() || !editable->isFileExist())
+			continue;
+		const QVariant lastActive = widget->property(LastActiveProperty);
+		if (lastActive.isValid() && clock_.elapsed() - lastActive.toLongLong() < IdleUnloadMs)
+			continue;
+
+		replaceTab(i, new TabPlaceholder(editable->getFilePath(), ui->tabWidget));
+	}
+}
+
+void MainWindow::saveSession()
+{
+	QStringList files;
+	int current = -1;
+	for (int i = 0; i < ui->tabWidget->count(); ++i)
+	{
+		QWidget* widget = ui->tabWidget->widget(i);
+		QString filePath;
+		if (TabPlaceholder* placeholder = qobject_cast<TabPlaceholder*>(widget))
+			filePath = placeholder->filePath();
+		else if (IEditableWidget* editable = parseToEditableWidget(widget); editable && editable->isFileExist())
+			filePath = editable->getFilePath();
+		else
+			continue;
+
+		if (i == ui->tabWidget->currentIndex())
+			current = files.size();
+		files.append(filePath);
+	}
+
+	QSettings settings;
+	settings.setValue("session/files", files);
+	settings.setValue("session/current", current);
+}
+
+void MainWindow::restoreSession()
+{
+	QSettings settings;
+	const QStringList files = settings.value("session/files").toStringList();
+	const int current = settings.value("session/current", 0).toInt();
+
+	// Все вкладки - заглушки; редактор строится только у той, что станет текущей
+	int currentIndex = 0;
+	isReplacingTab_ = true;
+	for (int i = 0; i < files.size(); ++i)
+	{
+		const QFileInfo fileInfo(files[i]);
+		if (!fileInfo.exists() || getWorktypeByExtension(fileInfo.suffix().toLower()) == WorkType::Unknown)
+			continue;
+		if (i == current)
+			currentIndex = ui->tabWidget->count();
+		addPlaceholderTab(files[i]);
+	}
+	isReplacingTab_ = false;
+
+	if (ui->tabWidget->count() == 0)
+		return;
+	ui->tabWidget->setCurrentIndex(currentIndex);
+	onCurrentTabChanged(currentIndex);
+}
+
 IEditableWidget* MainWindow::parseToEditableWidget(QWidget* currentWidget)
 {
 	if (TextEditWidget* textWidget = qobject_cast<TextEditWidget*>(currentWidget))
 		return textWidget;
 	else if (TableEditWidget* tableWidget = qobject_cast<TableEditWidget*>(currentWidget))
 		return tableWidget;
+	else if (SceneEditWidget* sceneWidget = qobject_cast<SceneEditWidget*>(currentWidget))
+		return sceneWidget;
 	else
 		return nullptr;
 }
@@ -218,6 +480,7 @@ void MainWindow::closeEvent(QCloseEvent *event)
 			}
 		}
 	}
+	saveSession();
 	event->accept();
 }
 
@@ -228,7 +491,7 @@ void MainWindow::on_actionNew_Paint_triggered() { initilizeTab(WorkType::Interac
 void MainWindow::on_actionClose_triggered()
 {
 	IEditableWidget* widget = dynamic_cast<IEditableWidget*>(ui->tabWidget->currentWidget());
-	if(maybeSave(widget))
+	if(widget && maybeSave(widget))
 		ui->tabWidget->removeTab(ui->tabWidget->indexOf(ui->tabWidget->currentWidget()));
 }
 
@@ -261,6 +524,10 @@ void MainWindow::on_actionUndo_triggered()
 	TextEditWidget *textEdit = qobject_cast<TextEditWidget*>(ui->tabWidget->currentWidget());
 	if(textEdit)
 		textEdit->getTextEdit()->undo();
+	else if (TableEditWidget *tableEdit = qobject_cast<TableEditWidget*>(ui->tabWidget->currentWidget()))
+		tableEdit->undo();
+	else if (SceneEditWidget *sceneEdit = qobject_cast<SceneEditWidget*>(ui->tabWidget->currentWidget()))
+		sceneEdit->undo();
 }
 
 
@@ -269,6 +536,10 @@ void MainWindow::on_actionRedo_triggered()
 	TextEditWidget *textEdit = qobject_cast<TextEditWidget*>(ui->tabWidget->currentWidget());
 	if(textEdit)
 		textEdit->getTextEdit()->redo();
+	else if (TableEditWidget *tableEdit = qobject_cast<TableEditWidget*>(ui->tabWidget->currentWidget()))
+		tableEdit->redo();
+	else if (SceneEditWidget *sceneEdit = qobject_cast<SceneEditWidget*>(ui->tabWidget->currentWidget()))
+		sceneEdit->redo();
 }
 
 
@@ -295,3 +566,34 @@ void MainWindow::on_actionPaste_triggered()
 		textEdit->getTextEdit()->insertPlainText(QApplication::clipboard()->text());
 }
 
+
+
+void MainWindow::on_actionExport_Trace_triggered()
+{
+	// Снимок берётся сразу: пока открыт диалог, старые события в кольцах затираются новыми
+	QString tempPath = QDir::temp().filePath(QStringLiteral("trace-%1.json").arg(QCoreApplication::applicationPid()));
+	QString errorString;
+	if (!Trace::exportChromeJson(tempPath, &errorString))
+	{
+		QMessageBox::critical(this, tr("Export Trace"), tr("Could not write the trace: %1").arg(errorString));
+		return;
+	}
+
+	QString filePath = QFileDialog::getSaveFileName(this, tr("Export Trace"), QStringLiteral("trace.json"),
+													tr("Chrome trace (*.json)"));
+	if (filePath.isEmpty())
+	{
+		QFile::remove(tempPath);
+		return;
+	}
+
+	QFile::remove(filePath);
+	if (!QFile::rename(tempPath, filePath) && !(QFile::copy(tempPath, filePath) && QFile::remove(tempPath)))
+	{
+		QMessageBox::critical(this, tr("Export Trace"), tr("Could not write %1.").arg(filePath));
+		return;
+	}
+	ui->statusbar->showMessage(tr("Trace saved. Open it in chrome://tracing or ui.perfetto.dev."), 5000);
+}
+
+void MainWindow::on_actionFrame_Overlay_toggled(bool checked) { frameOverlay_->setVisible(checked); }
@@ -4,9 +4,14 @@
 #include "widgets/ieditablewidget.h"
 #include <QMainWindow>
 #include "enums/worktype.h"
+#include "helpers/tablesearch.h"
+#include "widgets/frameoverlay.h"
 
+#include <QElapsedTimer>
 #include <QFileDialog>
 #include <QMessageBox>
+#include <QPointer>
+#include <QTimer>
 
 QT_BEGIN_NAMESPACE
 namespace Ui
@@ -34,6 +39,12 @@ class MainWindow : public QMainWindow
 
 	void on_actionFind_triggered();
 
+	void on_actionFind_Next_triggered();
+
+	void on_actionFind_Previous_triggered();
+
+	void on_actionReplace_triggered();
+
 	void on_actionNew_File_triggered();
 
 	bool on_actionSave_triggered();
@@ -63,9 +74,35 @@ class MainWindow : public QMainWindow
 
 	void on_actionPaste_triggered();
 
+	void onCurrentTabChanged(int index);
+
+	void unloadIdleTabs();
+
+	void on_actionExport_Trace_triggered();
+
+	void on_actionFrame_Overlay_toggled(bool checked);
+
   private:
 	Ui::MainWindow *ui;
 
+	// Сохранённый документ, не открывавшийся столько времени, выгружается в заглушку
+	static constexpr qint64 IdleUnloadMs = 10 * 60 * 1000;
+	static constexpr int IdleCheckIntervalMs = 60 * 1000;
+
+	QElapsedTimer clock_;
+	QTimer* unloadTimer_;
+	QPointer<QWidget> activeTab_;
+	bool isReplacingTab_ = false;
+	FrameOverlay* frameOverlay_;
+
 	QWidget* initilizeTab(WorkType worktype);
+	QWidget* createEditWidget(WorkType worktype);
+	QWidget* buildEditWidget(WorkType worktype);
+	QWidget* materializeTab(int index);
+	void addPlaceholderTab(const QString& filePath);
+	void replaceTab(int index, QWidget* widget);
+	void saveSession();
+	void restoreSession();
+	bool askTableSearchOptions(QWidget* tableWidget, TableSearchOptions& options);
 };
 #endif // MAINWINDOW_H
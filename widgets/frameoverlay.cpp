@@ -0,0 +1,127 @@
+#include "frameoverlay.h"
+#include "../helpers/trace.h"
+
+#include <QEvent>
+#include <QPainter>
+#include <QTimer>
+
+#include <algorithm>
+
+namespace
+{
+	template <typename Samples>
+	void dropOlderThan(Samples& samples, qint64 limit)
+	{
+		auto it = std::find_if(samples.begin(), samples.end(), [limit](const auto& sample) { return sample.at >= limit; });
+		samples.erase(samples.begin(), it);
+	}
+
+	template <typename Samples>
+	qint64 maxOf(const Samples& samples)
+	{
+		qint64 result = 0;
+		for (const auto& sample : samples)
+			result = qMax(result, sample.ns);
+		return result;
+	}
+}
+
+FrameOverlay::FrameOverlay(QWidget* window)
+	: QWidget(window), window_(window), probeTimer_(new QTimer(this))
+{
+	setAttribute(Qt::WA_TransparentForMouseEvents);
+	probeTimer_->setTimerType(Qt::PreciseTimer);
+	probeTimer_->setInterval(ProbeIntervalMs);
+	connect(probeTimer_, &QTimer::timeout, this, &FrameOverlay::onProbe);
+	hide();
+}
+
+bool FrameOverlay::eventFilter(QObject* watched, QEvent* event)
+{
+	if (watched == window_ && event->type() == QEvent::Resize)
+	{
+		placeInCorner();
+	}
+	else if (watched == window_ && event->type() == QEvent::UpdateRequest)
+	{
+		// Окно перерисовывает всё сразу по UpdateRequest - доставляем его сами, чтобы замерить кадр целиком
+		const qint64 start = Trace::nowNs();
+		watched->event(event);
+		const qint64 duration = Trace::nowNs() - start;
+		Trace::record("frame", start, duration);
+		frames_.append({start, duration});
+		return true;
+	}
+	return QWidget::eventFilter(watched, event);
+}
+
+void FrameOverlay::paintEvent(QPaintEvent* event)
+{
+	Q_UNUSED(event);
+	QPainter painter(this);
+	painter.setRenderHint(QPainter::Antialiasing);
+	painter.setPen(Qt::NoPen);
+	painter.setBrush(QColor(0, 0, 0, 160));
+	painter.drawRoundedRect(rect(), 4, 4);
+	painter.setPen(Qt::white);
+	painter.drawText(rect().adjusted(Margin, Margin, -Margin, -Margin), Qt::AlignLeft | Qt::AlignTop, text_);
+}
+
+void FrameOverlay::showEvent(QShowEvent* event)
+{
+	QWidget::showEvent(event);
+	frames_.clear();
+	latencies_.clear();
+	window_->installEventFilter(this);
+	expectedProbeNs_ = Trace::nowNs() + qint64(ProbeIntervalMs) * 1'000'000;
+	probeTimer_->start();
+	refreshText(Trace::nowNs());
+	raise();
+}
+
+void FrameOverlay::hideEvent(QHideEvent* event)
+{
+	QWidget::hideEvent(event);
+	probeTimer_->stop();
+	window_->removeEventFilter(this);
+}
+
+void FrameOverlay::onProbe()
+{
+	const qint64 now = Trace::nowNs();
+	const qint64 latency = qMax<qint64>(0, now - expectedProbeNs_);
+	latencies_.append({now, latency});
+	if (latency >= StallNs)
+		Trace::record("event loop stall", expectedProbeNs_, latency);
+	expectedProbeNs_ = now + qint64(ProbeIntervalMs) * 1'000'000;
+
+	if (now - refreshedNs_ >= RefreshNs)
+		refreshText(now);
+}
+
+void FrameOverlay::refreshText(qint64 now)
+{
+	refreshedNs_ = now;
+	dropOlderThan(frames_, now - StatsWindowNs);
+	dropOlderThan(latencies_, now - StatsWindowNs);
+
+	qint64 total = 0;
+	for (const Sample& frame : std::as_const(frames_))
+		total += frame.ns;
+	const double average = frames_.isEmpty() ? 0 : total / 1e6 / frames_.size();
+
+	text_ = tr("frames: %1/s, avg %2 ms, max %3 ms\nevent loop latency: max %4 ms")
+				.arg(frames_.size())
+				.arg(average, 0, 'f', 1)
+				.arg(maxOf(frames_) / 1e6, 0, 'f', 1)
+				.arg(maxOf(latencies_) / 1e6, 0, 'f', 1);
+	resize(fontMetrics().boundingRect(QRect(), Qt::AlignLeft | Qt::AlignTop, text_).size()
+		   + QSize(2 * Margin, 2 * Margin));
+	placeInCorner();
+	update();
+}
+
+void FrameOverlay::placeInCorner()
+{
+	move(window_->width() - width() - Margin, window_->height() - height() - Margin);
+}
@@ -0,0 +1,51 @@
+#ifndef FRAMEOVERLAY_H
+#define FRAMEOVERLAY_H
+
+#include <QList>
+#include <QWidget>
+
+class QTimer;
+
+// Надпись в углу окна: время перерисовки окна и задержка цикла событий за
+// последнюю секунду. Задержку меряет частый таймер - насколько позже срока он
+// сработал; долгие задержки попадают в журнал Trace. Скрытая ничего не замеряет.
+class FrameOverlay : public QWidget
+{
+	Q_OBJECT
+
+  public:
+	explicit FrameOverlay(QWidget* window);
+
+  protected:
+	bool eventFilter(QObject* watched, QEvent* event) override;
+	void paintEvent(QPaintEvent* event) override;
+	void showEvent(QShowEvent* event) override;
+	void hideEvent(QHideEvent* event) override;
+
+  private:
+	static constexpr int ProbeIntervalMs = 50;
+	static constexpr qint64 StatsWindowNs = 1'000'000'000;
+	static constexpr qint64 RefreshNs = 500'000'000;
+	static constexpr qint64 StallNs = 100'000'000;
+	static constexpr int Margin = 6;
+
+	struct Sample
+	{
+		qint64 at;
+		qint64 ns;
+	};
+
+	QWidget* window_;
+	QTimer* probeTimer_;
+	qint64 expectedProbeNs_ = 0;
+	qint64 refreshedNs_ = 0;
+	QList<Sample> frames_;
+	QList<Sample> latencies_;
+	QString text_;
+
+	void onProbe();
+	void refreshText(qint64 now);
+	void placeInCorner();
+};
+
+#endif // FRAMEOVERLAY_H
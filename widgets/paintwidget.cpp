@@ -1,4 +1,27 @@
 #include "paintwidget.h"
+#include "../items/strokeitem.h"
+#include "../items/imageitem.h"
+#include "../items/instanceitem.h"
+#include "../items/levelofdetail.h"
+#include "../helpers/floodfill.h"
+#include "../helpers/geometriceraser.h"
+#include "../helpers/sceneindex.h"
+#include "../helpers/trace.h"
+
+#include <QDebug>
+#include <QGraphicsPixmapItem>
+#include <QPainter>
+#include <QScrollBar>
+#include <QtMath>
+
+#include <cmath>
+
+// Вывод на каждое событие мыши и пера - только в сборке с опцией PAINT_INPUT_DEBUG
+#ifdef PAINT_INPUT_DEBUG
+#define INPUT_DEBUG qDebug
+#else
+#define INPUT_DEBUG QT_NO_QDEBUG_MACRO
+#endif
 
 PaintWidget::PaintWidget(QWidget *parent)
 	: QGraphicsView(parent),
@@ -11,15 +34,25 @@ PaintWidget::PaintWidget(QWidget *parent)
 	  backgroundColor_(Qt::white),
 	  isDragging_(false)
 {
+	inputFlushTimer_.setSingleShot(true);
+	connect(&inputFlushTimer_, &QTimer::timeout, this, &PaintWidget::flushInput);
+
+	// Своя область прокрутки вместо sceneRect сцены: тот охватывает только нарисованное
+	setSceneRect(-CanvasExtent, -CanvasExtent, 2 * CanvasExtent, 2 * CanvasExtent);
+	setTransformationAnchor(QGraphicsView::AnchorUnderMouse);
+	setResizeAnchor(QGraphicsView::AnchorViewCenter);
+
+	idleTimer_.setSingleShot(true);
+	idleTimer_.setInterval(150);
+	connect(&idleTimer_, &QTimer::timeout, this, &PaintWidget::endInteraction);
 }
 
 PaintWidget::~PaintWidget(){}
 
 void PaintWidget::resizeEvent(QResizeEvent *event) {
+	beginInteraction(true);
 	QGraphicsView::resizeEvent(event);
-	if (scene()) {
-		fitInView(scene()->sceneRect(), Qt::KeepAspectRatio);
-	}
+	updateVisibleTiles();
 }
 
 void PaintWidget::setCurrentTool(ToolType tool)
@@ -38,21 +71,37 @@ void PaintWidget::setBackgroundColor(const QColor &color)
 
 void PaintWidget::mousePressEvent(QMouseEvent *event)
 {
+	if (event->button() == Qt::MiddleButton) {
+		isPanning_ = true;
+		panOrigin_ = event->pos();
+		viewport()->setCursor(Qt::ClosedHandCursor);
+		beginInteraction(false);
+		event->accept();
+		return;
+	}
+
 	QPointF scenePos = mapToScene(event->pos());
+	beginInteraction(false);
+
+	QGraphicsItem* item = SceneIndex::itemAt(scene(), scenePos);
 
-	QGraphicsItem* item = scene()->itemAt(scenePos, QTransform());
+	if (event->button() == Qt::LeftButton && currentTool_ == FillTool) {
+		// Заливка не выделяет и не тащит элемент под курсором
+		++gestureId_;
+		fillAt(scenePos);
+		event->accept();
+		return;
+	}
 
 	if (event->button() == Qt::LeftButton) {
-		if (currentTool_ == BrushTool || currentTool_ == EraserTool) {
-			isDrawing_ = true;
-			lastPoint_ = scenePos;
-			qDebug() << "Mouse pressed at:" << lastPoint_ << "with tool:" << currentTool_;
-		}
+		++gestureId_;
+		if (currentTool_ == BrushTool || currentTool_ == EraserTool)
+			startDrawing(scenePos, -1);
 
 		if (item && (item->flags() & QGraphicsItem::ItemIsMovable)) {
 			isDragging_ = true;
 			emit itemDragStarted();
-			qDebug() << "Item drag started.";
+			INPUT_DEBUG() << "Item drag started.";
 		}
 	}
 	QGraphicsView::mousePressEvent(event);
@@ -60,43 +109,466 @@ void PaintWidget::mousePressEvent(QMouseEvent *event)
 
 void PaintWidget::mouseMoveEvent(QMouseEvent *event)
 {
-	QPointF currentPoint = mapToScene(event->pos());
-
-	if ((event->buttons() & Qt::LeftButton) && isDrawing_) {
-		if (currentTool_ == BrushTool)
-		{
-			QPen pen(brushColor_, brushSize_, brushStyle_);
-			scene()->addLine(QLineF(lastPoint_, currentPoint), pen);
-			lastPoint_ = currentPoint;
-		}
-		else if (currentTool_ == EraserTool)
-		{
-			QList<QGraphicsItem *> items = scene()->items(QRectF(currentPoint - QPointF(eraserSize_, eraserSize_),
-																 QSizeF(eraserSize_ * 2, eraserSize_ * 2)));
-			foreach (QGraphicsItem *item, items)
-			{
-				scene()->removeItem(item);
-				delete item;
-			}
-		}
+	TraceSpan span("PaintWidget::mouseMoveEvent");
+	if (isPanning_) {
+		const QPoint delta = event->pos() - panOrigin_;
+		panOrigin_ = event->pos();
+		horizontalScrollBar()->setValue(horizontalScrollBar()->value() - delta.x());
+		verticalScrollBar()->setValue(verticalScrollBar()->value() - delta.y());
+		event->accept();
+		return;
 	}
 
+	if (event->buttons() != Qt::NoButton)
+		beginInteraction(false);
+
+	if ((event->buttons() & Qt::LeftButton) && isDrawing_)
+		queueInput(mapToScene(event->pos()), -1);
+
 	QGraphicsView::mouseMoveEvent(event);
+	// Перетаскиваются выделенные элементы - их и переносим в индексе
+	if (isDragging_ && (event->buttons() & Qt::LeftButton))
+		SceneIndex::update(scene(), scene()->selectedItems());
 }
 
 void PaintWidget::mouseReleaseEvent(QMouseEvent *event)
 {
+	if (event->button() == Qt::MiddleButton && isPanning_) {
+		isPanning_ = false;
+		viewport()->unsetCursor();
+		event->accept();
+		return;
+	}
+
 	if (event->button() == Qt::LeftButton)
 	{
-		if (isDrawing_) {
-			isDrawing_ = false;
-			qDebug() << "Drawing stopped.";
-		}
+		if (isDrawing_)
+			stopDrawing();
 		if (isDragging_)
 		{
 			isDragging_ = false;
-			qDebug() << "Item drag stopped.";
+			INPUT_DEBUG() << "Item drag stopped.";
 		}
 	}
 	QGraphicsView::mouseReleaseEvent(event);
 }
+
+bool PaintWidget::viewportEvent(QEvent *event)
+{
+	// QAbstractScrollArea не передаёт события планшета с viewport в обработчики
+	switch (event->type()) {
+	case QEvent::TabletPress:
+	case QEvent::TabletMove:
+	case QEvent::TabletRelease:
+		tabletEvent(static_cast<QTabletEvent*>(event));
+		return event->isAccepted();
+	default:
+		return QGraphicsView::viewportEvent(event);
+	}
+}
+
+void PaintWidget::tabletEvent(QTabletEvent *event)
+{
+	// Перо само рисует кистью с нажимом; для остальных инструментов Qt
+	// синтезирует из отклонённого события обычные события мыши
+	if (!tabletDrawing_ && currentTool_ != BrushTool) {
+		event->ignore();
+		return;
+	}
+
+	// Без округления до пикселя viewport: перо даёт субпиксельные координаты
+	const QPointF scenePos = viewportTransform().inverted().map(event->position());
+	switch (event->type()) {
+	case QEvent::TabletPress:
+		if (event->button() != Qt::LeftButton) {
+			event->ignore();
+			return;
+		}
+		beginInteraction(false);
+		++gestureId_;
+		tabletDrawing_ = true;
+		startDrawing(scenePos, event->pressure());
+		break;
+	case QEvent::TabletMove:
+		if (!tabletDrawing_) {
+			event->ignore();
+			return;
+		}
+		beginInteraction(false);
+		queueInput(scenePos, event->pressure());
+		break;
+	case QEvent::TabletRelease:
+		if (!tabletDrawing_) {
+			event->ignore();
+			return;
+		}
+		tabletDrawing_ = false;
+		if (isDrawing_)
+			stopDrawing();
+		break;
+	default:
+		event->ignore();
+		return;
+	}
+	event->accept();
+}
+
+QPen PaintWidget::brushPen(qreal pressure) const
+{
+	const qreal width = pressure >= 0 ? brushSize_ * qBound<qreal>(0.1, pressure, 1) : brushSize_;
+	return QPen(brushColor_, width, brushStyle_, Qt::RoundCap, Qt::RoundJoin);
+}
+
+void PaintWidget::startDrawing(const QPointF& scenePos, qreal pressure)
+{
+	isDrawing_ = true;
+	lastPoint_ = scenePos;
+	pendingInput_.clear();
+	INPUT_DEBUG() << "Drawing started at:" << scenePos << "with tool:" << currentTool_ << "pressure:" << pressure;
+
+	if (rasterMode_) {
+		rasterLayer()->beginCapture();
+		if (currentTool_ == BrushTool)
+			rasterLayer()->drawLine(QLineF(scenePos, scenePos), brushPen(pressure));
+		else
+			rasterLayer()->eraseLine(QLineF(scenePos, scenePos), eraserSize_ * 2);
+		SceneIndex::update(scene(), rasterLayer_);
+	} else if (currentTool_ == EraserTool) {
+		pendingEraserPath_.clear();
+		queueInput(scenePos, pressure);
+	} else {
+		// Толщину по нажиму штрих считает сам от полной толщины пера
+		currentStroke_ = new StrokeItem(brushPen(-1), scenePos, pressure);
+		scene()->addItem(currentStroke_);
+		SceneIndex::update(scene(), currentStroke_);
+	}
+}
+
+void PaintWidget::fillAt(const QPointF& scenePos)
+{
+	// Заливается то, что видно: видимая часть сцены растеризуется в разрешении экрана
+	QElapsedTimer timer;
+	timer.start();
+	const QRectF visible = visibleSceneRect();
+	const QSize size = viewport()->size();
+	if (size.isEmpty() || !visible.contains(scenePos))
+		return;
+
+	QImage image(size, QImage::Format_ARGB32_Premultiplied);
+	image.fill(Qt::transparent);
+	QPainter painter(&image);
+	scene()->render(&painter, QRectF(image.rect()), visible, Qt::IgnoreAspectRatio);
+	painter.end();
+
+	const qreal scale = visible.width() / size.width();
+	const QPoint seed = ((scenePos - visible.topLeft()) / scale).toPoint();
+	QPoint offset;
+	const QImage filled = FloodFill::fill(image, seed, brushColor_, fillTolerance_, &offset);
+	if (filled.isNull())
+		return;
+
+	auto fillItem = new QGraphicsPixmapItem(QPixmap::fromImage(filled));
+	fillItem->setTransform(QTransform::fromScale(scale, scale));
+	fillItem->setPos(visible.topLeft() + QPointF(offset) * scale);
+	fillItem->setFlags(QGraphicsItem::ItemIsMovable | QGraphicsItem::ItemIsSelectable | QGraphicsItem::ItemIsFocusable);
+	scene()->addItem(fillItem);
+	SceneIndex::update(scene(), fillItem);
+	INPUT_DEBUG() << "Fill of" << filled.size() << "took" << timer.elapsed() << "ms";
+	emit fillFinished(fillItem);
+}
+
+void PaintWidget::stopDrawing()
+{
+	// Хвост движений применяем сразу: штрих завершается с последней точкой
+	flushInput();
+	isDrawing_ = false;
+	finishStroke();
+	flushEraser();
+	pendingEraserPath_.clear();
+	if (rasterMode_ && currentTool_ == EraserTool && rasterLayer_)
+		rasterLayer_->compact();
+	if (rasterMode_ && rasterLayer_)
+		emit rasterStrokeFinished(rasterLayer_, rasterLayer_->endCapture());
+	INPUT_DEBUG() << "Drawing stopped.";
+}
+
+void PaintWidget::queueInput(const QPointF& scenePos, qreal pressure)
+{
+	pendingInput_.append({scenePos, pressure});
+
+	// Первое движение после паузы применяется сразу, остальные - пачкой в конце кадра,
+	// так что задержка штриха не больше одного кадра
+	const qint64 sinceFlush = lastInputFlush_.isValid() ? lastInputFlush_.elapsed() : FrameIntervalMs;
+	if (sinceFlush >= FrameIntervalMs)
+		flushInput();
+	else if (!inputFlushTimer_.isActive())
+		inputFlushTimer_.start(int(FrameIntervalMs - sinceFlush));
+}
+
+void PaintWidget::flushInput()
+{
+	inputFlushTimer_.stop();
+	lastInputFlush_.start();
+	if (pendingInput_.isEmpty())
+		return;
+
+	const QList<InputPoint> input = pendingInput_;
+	pendingInput_.clear();
+	if (!isDrawing_ || !scene())
+		return;
+	INPUT_DEBUG() << "Applying" << input.size() << "input points";
+
+	if (rasterMode_) {
+		RasterLayerItem* layer = rasterLayer();
+		for (const InputPoint& point : input) {
+			const QLineF segment(lastPoint_, point.scenePos);
+			if (currentTool_ == BrushTool)
+				layer->drawLine(segment, brushPen(point.pressure));
+			else
+				layer->eraseLine(segment, eraserSize_ * 2);
+			lastPoint_ = point.scenePos;
+		}
+		SceneIndex::update(scene(), layer);
+	} else if (currentTool_ == EraserTool) {
+		for (const InputPoint& point : input)
+			pendingEraserPath_.append(point.scenePos);
+		flushEraser();
+	} else if (currentStroke_) {
+		QPolygonF points;
+		QList<qreal> pressures;
+		points.reserve(input.size());
+		pressures.reserve(input.size());
+		for (const InputPoint& point : input) {
+			points.append(point.scenePos);
+			pressures.append(point.pressure);
+		}
+		currentStroke_->addPoints(points, pressures);
+		SceneIndex::update(scene(), currentStroke_);
+	}
+	lastPoint_ = input.last().scenePos;
+}
+
+void PaintWidget::finishStroke()
+{
+	if (!currentStroke_)
+		return;
+
+	// Допуск задан в пикселях экрана, переводим в координаты сцены
+	qreal scale = qMax<qreal>(0.01, transform().m11());
+	currentStroke_->finish(strokeTolerance_ / scale, smoothStrokes_);
+	emit strokeFinished(currentStroke_);
+	currentStroke_ = nullptr;
+}
+
+RasterLayerItem* PaintWidget::findRasterLayer()
+{
+	if (!rasterLayer_ || rasterLayer_->scene() != scene())
+	{
+		// После загрузки файла слой уже может быть на сцене
+		rasterLayer_ = nullptr;
+		const QList<QGraphicsItem*> items = scene()->items();
+		for (QGraphicsItem* item : items)
+			if (RasterLayerItem* layer = qgraphicsitem_cast<RasterLayerItem*>(item))
+				rasterLayer_ = layer;
+	}
+	return rasterLayer_;
+}
+
+RasterLayerItem* PaintWidget::rasterLayer()
+{
+	// Слой создаётся при первом мазке и пропадает вместе со сценой (например, при очистке)
+	if (!findRasterLayer())
+	{
+		rasterLayer_ = new RasterLayerItem();
+		rasterLayer_->setResidentRect(visibleTiles_);
+		scene()->addItem(rasterLayer_);
+		SceneIndex::update(scene(), rasterLayer_);
+	}
+	return rasterLayer_;
+}
+
+void PaintWidget::flushEraser()
+{
+	if (pendingEraserPath_.isEmpty() || !scene())
+		return;
+
+	GeometricEraser::Result result = GeometricEraser::erase(scene(), pendingEraserPath_, eraserSize_);
+	if (!result.removed.isEmpty())
+		emit itemsErased(result.removed, result.added);
+	qDeleteAll(result.removed);
+
+	// Последняя точка остаётся началом следующей пачки, чтобы след был непрерывным
+	QPointF lastPoint = pendingEraserPath_.last();
+	pendingEraserPath_.clear();
+	pendingEraserPath_.append(lastPoint);
+}
+
+void PaintWidget::wheelEvent(QWheelEvent *event)
+{
+	beginInteraction(false);
+	if (event->modifiers() & Qt::ControlModifier) {
+		// Один щелчок колеса (120) - примерно 20%
+		zoomBy(qPow(1.0015, event->angleDelta().y()));
+		event->accept();
+		return;
+	}
+	QGraphicsView::wheelEvent(event);
+}
+
+void PaintWidget::scrollContentsBy(int dx, int dy)
+{
+	beginInteraction(false);
+	QGraphicsView::scrollContentsBy(dx, dy);
+	updateVisibleTiles();
+}
+
+void PaintWidget::zoomBy(qreal factor)
+{
+	const qreal zoom = transform().m11();
+	const qreal target = qBound(MinZoom, zoom * factor, MaxZoom);
+	if (qFuzzyCompare(target, zoom))
+		return;
+	scale(target / zoom, target / zoom);
+	updateVisibleTiles();
+}
+
+QRectF PaintWidget::visibleSceneRect() const
+{
+	return mapToScene(viewport()->rect()).boundingRect();
+}
+
+void PaintWidget::refreshVisibleTiles()
+{
+	visibleTiles_ = QRectF();
+	if (scene())
+		findRasterLayer();
+	updateVisibleTiles();
+}
+
+void PaintWidget::updateVisibleTiles()
+{
+	if (!scene())
+		return;
+
+	// Плитка - около TilePixels пикселей экрана, сторона в сцене - степень двойки,
+	// поэтому прокрутка внутри плитки и мелкий масштаб ничего не пересчитывают
+	const qreal zoom = qMax<qreal>(MinZoom, transform().m11());
+	const qreal tile = qPow(2, qCeil(std::log2(TilePixels / zoom)));
+	const QRectF visible = visibleSceneRect();
+	const QRectF tiles(QPointF((qFloor(visible.left() / tile) - 1) * tile, (qFloor(visible.top() / tile) - 1) * tile),
+					   QPointF((qFloor(visible.right() / tile) + 2) * tile, (qFloor(visible.bottom() / tile) + 2) * tile));
+	if (tiles == visibleTiles_)
+		return;
+
+	visibleTiles_ = tiles;
+	// Поиск слоя обходит всю сцену - при прокрутке берём только уже известный
+	if (rasterLayer_ && rasterLayer_->scene() == scene())
+		rasterLayer_->setResidentRect(tiles);
+}
+
+void PaintWidget::setPerformanceMode(bool enabled)
+{
+	performanceMode_ = enabled;
+	idleTimer_.stop();
+	interacting_ = false;
+	cachesDegraded_ = false;
+	interactionRect_ = QRectF();
+
+	setViewportUpdateMode(enabled ? QGraphicsView::SmartViewportUpdate : QGraphicsView::MinimalViewportUpdate);
+	setOptimizationFlag(QGraphicsView::DontSavePainterState, enabled);
+	// Без сглаживания поля под него не нужны; со сглаживанием без полей остаются следы
+	setOptimizationFlag(QGraphicsView::DontAdjustForAntialiasing, false);
+	setRenderHint(QPainter::Antialiasing, enabled);
+	setRenderHint(QPainter::SmoothPixmapTransform, enabled);
+	viewport()->setProperty(LevelOfDetail::Property, enabled);
+
+	updateItemCacheModes();
+	viewport()->update();
+}
+
+bool PaintWidget::shouldCache(const QGraphicsItem* item)
+{
+	// Слой и картинки сами рисуют только нужное, у копий кэш общий; свой кэш для них - лишняя копия пикселей
+	if (item->type() == RasterLayerItem::Type || item->type() == ImageItem::Type
+		|| item->type() == InstanceItem::Type || item->type() == QGraphicsItemGroup::Type)
+		return false;
+	if (auto stroke = qgraphicsitem_cast<const StrokeItem*>(item))
+		return !stroke->isDrawing();
+	return true;
+}
+
+QList<QGraphicsItem*> PaintWidget::itemsIn(const QRectF& rect) const
+{
+	if (rect.isNull())
+		return scene()->items();
+
+	// Индекс хранит только верхнеуровневые элементы - дочерние добираем сами
+	QList<QGraphicsItem*> items = SceneIndex::items(scene(), rect, Qt::IntersectsItemBoundingRect);
+	for (int i = 0; i < items.size(); ++i)
+		items += items[i]->childItems();
+	return items;
+}
+
+void PaintWidget::updateItemCacheModes(const QRectF& rect)
+{
+	if (!scene())
+		return;
+
+	const QList<QGraphicsItem*> items = itemsIn(rect);
+	for (QGraphicsItem* item : items) {
+		QGraphicsItem::CacheMode mode = performanceMode_ && shouldCache(item) ? QGraphicsItem::DeviceCoordinateCache
+																			 : QGraphicsItem::NoCache;
+		if (item->cacheMode() != mode) {
+			item->setCacheMode(mode);
+			if (interacting_)
+				cachesDegraded_ = true;
+		}
+	}
+}
+
+void PaintWidget::beginInteraction(bool invalidatesCaches)
+{
+	if (!performanceMode_)
+		return;
+
+	if (!interacting_) {
+		interacting_ = true;
+		setOptimizationFlag(QGraphicsView::DontAdjustForAntialiasing, true);
+		setRenderHint(QPainter::Antialiasing, false);
+		setRenderHint(QPainter::SmoothPixmapTransform, false);
+	}
+	if (invalidatesCaches)
+		cachesDegraded_ = true;
+	interactionRect_ = interactionRect_.united(visibleSceneRect());
+	idleTimer_.start();
+}
+
+void PaintWidget::endInteraction()
+{
+	if (!performanceMode_ || isDrawing_) {
+		// Пока кисть рисует, качество не возвращаем - дождёмся отпускания мыши
+		if (performanceMode_)
+			idleTimer_.start();
+		return;
+	}
+
+	interacting_ = false;
+	setOptimizationFlag(QGraphicsView::DontAdjustForAntialiasing, false);
+	setRenderHint(QPainter::Antialiasing, true);
+	setRenderHint(QPainter::SmoothPixmapTransform, true);
+
+	// Кэши могли собраться только у того, что побывало на экране, - остальную сцену не обходим
+	const QRectF touched = interactionRect_.united(visibleSceneRect());
+	interactionRect_ = QRectF();
+	updateItemCacheModes(touched);
+
+	// Кэши, собранные без сглаживания, пересобираем в полном качестве
+	if (cachesDegraded_ && scene()) {
+		cachesDegraded_ = false;
+		const QList<QGraphicsItem*> items = itemsIn(touched);
+		for (QGraphicsItem* item : items)
+			if (item->cacheMode() != QGraphicsItem::NoCache)
+				item->update();
+	}
+	viewport()->update();
+}
@@ -6,6 +6,13 @@
 #include <QMouseEvent>
 #include "../enums/tooltype.h"
 #include <QGraphicsItem>
+#include <QElapsedTimer>
+#include <QPointer>
+#include <QTabletEvent>
+#include <QTimer>
+#include "../items/rasterlayeritem.h"
+
+class StrokeItem;
 
 
 class PaintWidget : public QGraphicsView
@@ -23,17 +30,54 @@ class PaintWidget : public QGraphicsView
 	void setBrushColor(const QColor &color) { brushColor_ = color; }
 	void setBrushStyle(Qt::PenStyle style) { brushStyle_ = style; }
 	void setEraserSize(int size) { eraserSize_ = size; }
+	// Допуск заливки: насколько каждый канал может отличаться от цвета под курсором (0..255)
+	void setFillTolerance(int tolerance) { fillTolerance_ = tolerance; }
+	int fillTolerance() const { return fillTolerance_; }
 	void setBackgroundColor(const QColor &color);
+	void setStrokeSmoothing(bool smooth) { smoothStrokes_ = smooth; }
+	void setStrokeTolerance(qreal tolerance) { strokeTolerance_ = tolerance; }
+	void setRasterMode(bool enabled) { rasterMode_ = enabled; }
+	bool isRasterMode() const { return rasterMode_; }
+	RasterLayerItem* rasterLayer();
+
+	// Режим производительности: кэш элементов, умное обновление viewport,
+	// упрощение мелких элементов и сглаживание только в покое
+	void setPerformanceMode(bool enabled);
+	bool isPerformanceMode() const { return performanceMode_; }
+
+	// Номер текущего (последнего) нажатия мыши - по нему история сливает шаги одного жеста
+	int gestureId() const { return gestureId_; }
+
+	// Холст не ограничен: колесо с Ctrl - масштаб, средняя кнопка - перемещение.
+	// Рисуется только то, что попадает в видимые плитки (с запасом в плитку)
+	static constexpr qreal CanvasExtent = 1 << 20;
+	static constexpr qreal MinZoom = 1.0 / 32;
+	static constexpr qreal MaxZoom = 32;
+	static constexpr int TilePixels = 512; // плитки растрового слоя в памяти
+
+	QRectF visibleSceneRect() const;
+	// Пересчитать видимые плитки после замены содержимого сцены
+	void refreshVisibleTiles();
 
   signals:
 	void toolChanged(ToolType newTool);
 	void itemDragStarted();
+	// Испускается до удаления removed: после возврата указатели недействительны
+	void itemsErased(const QList<QGraphicsItem*>& removed, const QList<QGraphicsItem*>& added);
+	void strokeFinished(QGraphicsItem* stroke);
+	void fillFinished(QGraphicsItem* fill);
+	// before - плитки слоя до мазка
+	void rasterStrokeFinished(RasterLayerItem* layer, const QHash<QPoint, QImage>& before);
 
   protected:
 	void mousePressEvent(QMouseEvent *event) override;
 	void mouseMoveEvent(QMouseEvent *event) override;
 	void mouseReleaseEvent(QMouseEvent *event) override;
+	void tabletEvent(QTabletEvent *event) override;
+	bool viewportEvent(QEvent *event) override;
 	void resizeEvent(QResizeEvent *event) override;
+	void wheelEvent(QWheelEvent *event) override;
+	void scrollContentsBy(int dx, int dy) override;
 
   private:
 	ToolType currentTool_;
@@ -41,11 +85,65 @@ class PaintWidget : public QGraphicsView
 	bool isDrawing_;
 	int brushSize_;
 	int eraserSize_;
+	int fillTolerance_ = 32;
 	QColor brushColor_;
 	QColor backgroundColor_;
 	Qt::PenStyle brushStyle_;
 
 	bool isDragging_;
+	int gestureId_ = 0;
+
+	StrokeItem* currentStroke_ = nullptr;
+	bool smoothStrokes_ = true;
+	qreal strokeTolerance_ = 0.75; // в пикселях экрана
+
+	bool rasterMode_ = false;
+	QPointer<RasterLayerItem> rasterLayer_;
+	RasterLayerItem* findRasterLayer();
+
+	bool isPanning_ = false;
+	QPoint panOrigin_;
+	QRectF visibleTiles_;
+
+	void zoomBy(qreal factor);
+	void updateVisibleTiles();
+
+	// Движения мыши и пера копятся и применяются не чаще раза в кадр
+	static constexpr int FrameIntervalMs = 16;
+	struct InputPoint
+	{
+		QPointF scenePos;
+		qreal pressure; // < 0 - без нажима (мышь)
+	};
+	QList<InputPoint> pendingInput_;
+	QTimer inputFlushTimer_;
+	QElapsedTimer lastInputFlush_;
+	bool tabletDrawing_ = false;
+
+	void queueInput(const QPointF& scenePos, qreal pressure);
+	void flushInput();
+
+	QPolygonF pendingEraserPath_;
+	void flushEraser();
+
+	QPen brushPen(qreal pressure) const;
+	void startDrawing(const QPointF& scenePos, qreal pressure);
+	void stopDrawing();
+	void finishStroke();
+	void fillAt(const QPointF& scenePos);
+
+	bool performanceMode_ = false;
+	bool interacting_ = false;
+	bool cachesDegraded_ = false; // кэши перерисованы без сглаживания
+	QRectF interactionRect_;      // всё, что было на экране за время взаимодействия
+	QTimer idleTimer_;
+
+	void beginInteraction(bool invalidatesCaches);
+	void endInteraction();
+	// Пустой rect - все элементы сцены
+	void updateItemCacheModes(const QRectF& rect = QRectF());
+	QList<QGraphicsItem*> itemsIn(const QRectF& rect) const;
+	static bool shouldCache(const QGraphicsItem* item);
 };
 
 #endif // PAINTWIDGET_H
@@ -2,23 +2,41 @@
 // #include "ui_sceneeditwidget.h"
 #include "paintwidget.h"
 #include "widgets/ui_sceneeditwidget.h"
+#include "../helpers/sceneserializer.h"
+#include "../helpers/sceneexporter.h"
+#include "../helpers/scenecommands.h"
+#include "../helpers/sceneindex.h"
+#include "../helpers/scenesvg.h"
+#include "../helpers/shapeboolean.h"
+#include "../helpers/pathsimplifier.h"
+#include "../helpers/trace.h"
+#include "../items/imageitem.h"
+#include "../items/instanceitem.h"
+#include "../items/strokeitem.h"
 #include <qgraphicsscene.h>
 
 #include <QInputDialog>
+#include <QMetaEnum>
 #include <QColorDialog>
 #include <QFileDialog>
 #include <QFontDialog>
+#include <QProgressDialog>
 #include <QTimer>
 #include <QGraphicsView>
+#include <QRandomGenerator>
+#include <QtMath>
 
 SceneEditWidget::SceneEditWidget(QWidget *parent)
-	: QWidget(parent), ui(new Ui::SceneEditWidget), dx(5), dy(5), movementDuration(5000),
-	  selectedGroup(nullptr), selectedItem(nullptr)
+	: QWidget(parent), ui(new Ui::SceneEditWidget)
 {
 	ui->setupUi(this);
-	scene_ = new QGraphicsScene(0, 0, 565, 500, this);
+	// sceneRect не задаётся: он растёт вместе с элементами, лист хранится отдельно
+	scene_ = new QGraphicsScene(this);
+	SceneExporter::setPage(scene_, QRectF(0, 0, 565, 500));
+	SceneIndex::install(scene_);
 	paintWidget_ = new PaintWidget(ui->widget);
 	paintWidget_->setScene(scene_);
+	paintWidget_->centerOn(SceneExporter::page(scene_).center());
 	scene_->setBackgroundBrush(QColorConstants::White);
 	paintWidget_->setBrushColor(QColorConstants::Black);
 
@@ -26,20 +44,42 @@ SceneEditWidget::SceneEditWidget(QWidget *parent)
 	ui->brushButton->setCheckable(true);
 	ui->eraserButton->setCheckable(true);
 	ui->selectButton->setCheckable(true);
+	ui->fillButton->setCheckable(true);
 	ui->selectButton->setChecked(true);
 
-	collisionSound.setSource(QUrl(QString::fromUtf8(":/sounds/sounds/collision.wav3")));
-	collisionSound.setLoopCount(5);
-	collisionSound.setVolume(0.5f);
+	collisionSounds_ = new CollisionSoundPool(QUrl(QStringLiteral("qrc:/sounds/sounds/collision.wav")), this);
+	collisionSounds_->setVolume(0.5f);
 
+	motionThread_ = new MotionThread(this);
 	movementTimer = new QTimer(this);
+	movementTimer->setTimerType(Qt::PreciseTimer);
 	connect(movementTimer, &QTimer::timeout, this, &SceneEditWidget::updateItemPosition);
+	playbackTimer_ = new QTimer(this);
+	playbackTimer_->setTimerType(Qt::PreciseTimer);
+	connect(playbackTimer_, &QTimer::timeout, this, &SceneEditWidget::updatePlayback);
+
+	history_ = new SceneHistory(this);
+	connect(history_, &SceneHistory::changed, this, [this]() {
+		isModified_ = !history_->isClean();
+		emit sceneModified(this);
+	});
+	connect(ui->scaleSlider, &QSlider::sliderPressed, this, [this]() { ++sliderGesture_; });
+	connect(ui->rotateSlider, &QSlider::sliderPressed, this, [this]() { ++sliderGesture_; });
+	connect(paintWidget_, &PaintWidget::itemsErased, this, [this](const QList<QGraphicsItem*>& removed, const QList<QGraphicsItem*>& added) {
+		forgetItems(removed);
+		history_->push(new ReplaceItemsCommand(scene_, ItemSnapshot::take(removed), ItemSnapshot::take(added), tr("Erase"),
+											   paintWidget_->gestureId()));
+	});
+	connect(paintWidget_, &PaintWidget::strokeFinished, this, [this](QGraphicsItem* stroke) { recordAdded(stroke, tr("Brush stroke")); });
+	connect(paintWidget_, &PaintWidget::fillFinished, this, [this](QGraphicsItem* fill) { recordAdded(fill, tr("Fill")); });
+	connect(paintWidget_, &PaintWidget::rasterStrokeFinished, this, &SceneEditWidget::recordRasterStroke);
 }
 
 SceneEditWidget::~SceneEditWidget() { delete ui; }
 
 void SceneEditWidget::openFile(const QString& filePath)
 {
+	TraceSpan span("SceneEditWidget::openFile");
 	fileinfo_ = new QFileInfo(filePath);
 	QFile file(filePath);
 
@@ -49,19 +89,34 @@ void SceneEditWidget::openFile(const QString& filePath)
 		return;
 	}
 
-	if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+	if (!file.open(QIODevice::ReadOnly))
 	{
 		QMessageBox::critical(this, tr("File Open Error"), tr("Could not open the file for reading."));
 		return;
 	}
 
-	QTextStream in(&file);
-	originalText_ = in.readAll();
+	stopMovingItem();
+	playbackTimer_->stop();
+	timeline_.clear();
+	history_->clear();
+	QString errorString;
+	const bool loaded = SceneSerializer::load(scene_, &file, &errorString);
+	SceneIndex::rebuild(scene_);
+	paintWidget_->refreshVisibleTiles();
+	if (!loaded)
+	{
+		QMessageBox::critical(this, tr("File Open Error"), tr("Could not read the scene: %1").arg(errorString));
+		return;
+	}
 	file.close();
+
+	isModified_ = false;
+	emit sceneModified(this);
 }
 
 bool SceneEditWidget::saveFile(const QString& filePath)
 {
+	TraceSpan span("SceneEditWidget::saveFile");
 	if (filePath.isEmpty())
 	{
 		QMessageBox::information(this, tr("No File Selected"), tr("No file was selected."));
@@ -69,17 +124,22 @@ bool SceneEditWidget::saveFile(const QString& filePath)
 	}
 
 	QFile file(filePath);
-	if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+	if (!file.open(QIODevice::WriteOnly))
 	{
 		QMessageBox::critical(this, tr("File Save Error"), tr("Could not open the file for writing."));
 		return false;
 	}
 
-	QTextStream out(&file);
-	out << originalText_;
-	isModified_ = false;
+	QString errorString;
+	if (!SceneSerializer::save(scene_, &file, SceneSerializer::formatForFile(filePath), &errorString))
+	{
+		QMessageBox::critical(this, tr("File Save Error"), tr("Could not write the scene: %1").arg(errorString));
+		return false;
+	}
+	file.close();
+
 	fileinfo_ = new QFileInfo(filePath);
-	emit sceneModified(this);
+	history_->setClean();
 	return true;
 }
 
@@ -96,6 +156,7 @@ void SceneEditWidget::on_brushButton_clicked()
 	ui->brushButton->setChecked(true);
 	ui->eraserButton->setChecked(false);
 	ui->selectButton->setChecked(false);
+	ui->fillButton->setChecked(false);
 }
 
 void SceneEditWidget::on_eraserButton_clicked()
@@ -104,14 +165,23 @@ void SceneEditWidget::on_eraserButton_clicked()
 	ui->eraserButton->setChecked(true);
 	ui->brushButton->setChecked(false);
 	ui->selectButton->setChecked(false);
+	ui->fillButton->setChecked(false);
 }
 
 void SceneEditWidget::on_eraserSizeSlider_valueChanged(int value){paintWidget_->setEraserSize(value); }
 
 void SceneEditWidget::on_clearCanvas_clicked()
 {
+	QUndoCommand* command = new QUndoCommand(tr("Clear canvas"));
+	new ReplaceItemsCommand(scene_, ItemSnapshot::take(SceneSerializer::topLevelItems(scene_)), {}, tr("Clear canvas"), -1, command);
+	new BackgroundCommand(scene_, scene_->backgroundBrush(), QBrush(QColorConstants::White), command);
+
+	stopMovingItem();
 	scene_->clear();
+	SceneIndex::rebuild(scene_);
+	paintWidget_->refreshVisibleTiles();
 	scene_->setBackgroundBrush(QColorConstants::White);
+	history_->push(command);
 }
 
 void SceneEditWidget::on_colorButton_clicked()
@@ -161,6 +231,7 @@ void SceneEditWidget::on_addShapeButton_clicked()
 			item->setFlag(QGraphicsItem::ItemIsMovable);
 			item->setFlag(QGraphicsItem::ItemIsSelectable);
 			item->setFlag(QGraphicsItem::ItemIsFocusable);
+			recordAdded(item, tr("Add shape"));
 		}
 	}
 }
@@ -168,12 +239,23 @@ void SceneEditWidget::on_addShapeButton_clicked()
 void SceneEditWidget::on_addImageButton_clicked()
 {
 	paintWidget_->setCurrentTool(ToolType::NoTool);
-	QString fileName = QFileDialog::getOpenFileName(this, tr("Upload image"), "", tr("Images (*.png *.jpg *.bmp)"));
+	QString fileName = QFileDialog::getOpenFileName(this, tr("Upload image"), "", tr("Images (*.png *.jpg *.jpeg *.bmp *.svg)"));
+	if (SceneSvg::isSvgFile(fileName)) {
+		importSvg(fileName);
+		return;
+	}
 	if (!fileName.isEmpty()) {
-		QPixmap pixmap(fileName);
-		if (!pixmap.isNull()) {
-			QGraphicsPixmapItem *pixmapItem = scene_->addPixmap(pixmap);
-			pixmapItem->setFlags(QGraphicsItem::ItemIsMovable | QGraphicsItem::ItemIsSelectable | QGraphicsItem::ItemIsFocusable);
+		// Декодирование идёт в фоне внутри ImageItem; здесь только читаем файл и заголовок
+		QFile file(fileName);
+		QByteArray data;
+		if (file.open(QIODevice::ReadOnly))
+			data = file.readAll();
+
+		if (ImageItem::probe(data)) {
+			ImageItem* imageItem = new ImageItem(data);
+			imageItem->setFlags(QGraphicsItem::ItemIsMovable | QGraphicsItem::ItemIsSelectable | QGraphicsItem::ItemIsFocusable);
+			scene_->addItem(imageItem);
+			recordAdded(imageItem, tr("Add image"));
 		} else {
 			QMessageBox::warning(this, tr("Error"), tr("Can upload image"));
 		}
@@ -193,6 +275,7 @@ void SceneEditWidget::on_addTextButton_clicked()
 			textItem->setDefaultTextColor(QColorConstants::Black);
 			textItem->setFlag(QGraphicsItem::ItemIsMovable);
 			textItem->setFlag(QGraphicsItem::ItemIsSelectable);
+			recordAdded(textItem, tr("Add text"));
 		}
 	}
 }
@@ -204,9 +287,15 @@ void SceneEditWidget::on_scaleSlider_valueChanged(int value)
 	if (selectedItems.isEmpty()) return;
 
 	double scaleFactor = value / 100.0;
+	QList<TransformCommand::State> states;
 	foreach (QGraphicsItem *item, selectedItems) {
+		states.append({SceneCommand::ensureId(item), item->scale(), scaleFactor, item->transformOriginPoint(), item->transformOriginPoint()});
 		item->setScale(scaleFactor);
 	}
+	SceneIndex::update(scene_, selectedItems);
+	// Шаги с клавиатуры и щелчки по дорожке - отдельные команды
+	const int gesture = ui->scaleSlider->isSliderDown() ? sliderGesture_ : -1;
+	history_->push(new TransformCommand(scene_, TransformCommand::Scale, states, gesture));
 }
 
 
@@ -215,28 +304,67 @@ void SceneEditWidget::on_rotateSlider_valueChanged(int value)
 	QList<QGraphicsItem *> selectedItems = scene_->selectedItems();
 	if (selectedItems.isEmpty()) return;
 
+	QList<TransformCommand::State> states;
 	foreach (QGraphicsItem *item, selectedItems) {
 		QRectF boundingRect = item->boundingRect();
 		QPointF center = boundingRect.center();
+		states.append({SceneCommand::ensureId(item), item->rotation(), static_cast<qreal>(value), item->transformOriginPoint(), center});
 
 		item->setTransformOriginPoint(center);
 
 		item->setRotation(static_cast<qreal>(value));
 	}
+	SceneIndex::update(scene_, selectedItems);
+	const int gesture = ui->rotateSlider->isSliderDown() ? sliderGesture_ : -1;
+	history_->push(new TransformCommand(scene_, TransformCommand::Rotation, states, gesture));
 }
 
 
 void SceneEditWidget::on_saveImageButton_clicked()
 {
-	QString fileName = QFileDialog::getSaveFileName(this, "Save image", "", "PNG Image (*.png);;JPEG Image (*.jpg);;BMP Image (*.bmp)");
-	if (!fileName.isEmpty()) {
-		QImage image(scene_->sceneRect().size().toSize(), QImage::Format_ARGB32);
+	QString fileName = QFileDialog::getSaveFileName(this, "Save image", "", "PNG Image (*.png);;JPEG Image (*.jpg);;BMP Image (*.bmp);;SVG Image (*.svg)");
+	if (fileName.isEmpty())
+		return;
+
+	if (SceneSvg::isSvgFile(fileName)) {
+		QFile file(fileName);
+		QString errorString;
+		if (!file.open(QIODevice::WriteOnly) || !SceneSvg::save(scene_, &file, &errorString))
+			QMessageBox::critical(this, tr("Export Error"),
+								  tr("Could not export the image: %1").arg(errorString.isEmpty() ? file.errorString() : errorString));
+		return;
+	}
+
+	if (!SceneExporter::canExport(fileName)) {
+		const QRectF area = SceneExporter::exportRect(scene_);
+		QImage image(area.size().toSize().expandedTo(QSize(1, 1)), QImage::Format_ARGB32);
 		image.fill(Qt::transparent);
 
 		QPainter painter(&image);
-		scene_->render(&painter);
+		scene_->render(&painter, QRectF(), area);
+		painter.end();
 		image.save(fileName);
+		return;
 	}
+
+	bool ok;
+	int dpi = QInputDialog::getInt(this, "Export resolution", "Resolution (DPI):", SceneExporter::ScreenDpi, 24, 2400, 24, &ok);
+	if (!ok)
+		return;
+
+	const QSize size = SceneExporter::outputSize(scene_, dpi);
+	QProgressDialog progressDialog(tr("Exporting %1 x %2...").arg(size.width()).arg(size.height()), tr("Cancel"), 0, 100, this);
+	progressDialog.setWindowModality(Qt::WindowModal);
+	progressDialog.setMinimumDuration(500);
+
+	QString errorString;
+	bool exported = SceneExporter::exportScene(scene_, fileName, dpi, &errorString, [&progressDialog](int done, int total) {
+		progressDialog.setMaximum(total);
+		progressDialog.setValue(done);
+		return !progressDialog.wasCanceled();
+	});
+	if (!exported && !errorString.isEmpty())
+		QMessageBox::critical(this, tr("Export Error"), tr("Could not export the image: %1").arg(errorString));
 }
 
 void SceneEditWidget::on_mergeShapesButton_clicked()
@@ -248,6 +376,24 @@ void SceneEditWidget::on_mergeShapesButton_clicked()
 		return;
 	}
 
+	QStringList operations = {"Union", "Intersect", "Subtract", "Group"};
+	bool ok;
+	QString operation = QInputDialog::getItem(this, "Merge shapes", "Operation:", operations, 0, false, &ok);
+	if (!ok)
+		return;
+	if (operation == "Union")
+		combineShapes(ShapeBoolean::Operation::Union, tr("Union shapes"));
+	else if (operation == "Intersect")
+		combineShapes(ShapeBoolean::Operation::Intersect, tr("Intersect shapes"));
+	else if (operation == "Subtract")
+		combineShapes(ShapeBoolean::Operation::Subtract, tr("Subtract shapes"));
+	else
+		groupShapes(selectedItems);
+}
+
+void SceneEditWidget::groupShapes(const QList<QGraphicsItem*>& selectedItems)
+{
+	const QList<ItemSnapshot> removed = ItemSnapshot::take(selectedItems);
 	QGraphicsItemGroup* group = new QGraphicsItemGroup();
 
 	qreal maxZValue = 0;
@@ -257,6 +403,8 @@ void SceneEditWidget::on_mergeShapesButton_clicked()
 		}
 	}
 
+	forgetItems(selectedItems);
+	SceneIndex::remove(scene_, selectedItems);
 	for (QGraphicsItem* item : selectedItems) {
 		item->setZValue(maxZValue + 1);
 		group->addToGroup(item);
@@ -270,39 +418,248 @@ void SceneEditWidget::on_mergeShapesButton_clicked()
 		scene_->removeItem(item);
 	}
 	scene_->addItem(group);
+	SceneIndex::update(scene_, group);
 	group->setSelected(true);
+	history_->push(new ReplaceItemsCommand(scene_, removed, {ItemSnapshot::take(group)}, tr("Merge shapes")));
+}
+
+void SceneEditWidget::combineShapes(ShapeBoolean::Operation operation, const QString& text)
+{
+	// Порядок стопки снизу вверх: вычитание идёт из самого нижнего, его цвет получает результат
+	QList<QGraphicsItem*> items;
+	for (QGraphicsItem* item : SceneSerializer::topLevelItems(scene_))
+		if (item->isSelected())
+			items.append(item);
+	// Выделены могли быть дочерние элементы групп - их здесь не считаем
+	if (items.size() < 2) {
+		QMessageBox::information(this, tr("Merging shapes"), tr("Select at least two objects"));
+		return;
+	}
+
+	QList<QPainterPath> outlines;
+	qreal maxZValue = items.first()->zValue();
+	for (QGraphicsItem* item : std::as_const(items)) {
+		outlines.append(ShapeBoolean::outline(item));
+		maxZValue = qMax(maxZValue, item->zValue());
+	}
+
+	QPainterPath result = ShapeBoolean::combine(outlines, operation);
+	if (result.isEmpty()) {
+		QMessageBox::information(this, tr("Merging shapes"), tr("The result is empty"));
+		return;
+	}
+
+	QColor color = QColorConstants::Black;
+	if (auto shapeItem = dynamic_cast<QAbstractGraphicsShapeItem*>(items.first()))
+		color = shapeItem->brush().style() != Qt::NoBrush ? shapeItem->brush().color() : shapeItem->pen().color();
+	else if (auto textItem = qgraphicsitem_cast<QGraphicsTextItem*>(items.first()))
+		color = textItem->defaultTextColor();
+
+	// Контур уже включает обводки, поэтому пера у результата нет
+	const QPointF origin = result.boundingRect().topLeft();
+	QGraphicsPathItem* merged = new QGraphicsPathItem(result.translated(-origin));
+	merged->setPos(origin);
+	merged->setPen(Qt::NoPen);
+	merged->setBrush(color);
+	merged->setZValue(maxZValue);
+	merged->setFlags(QGraphicsItem::ItemIsMovable | QGraphicsItem::ItemIsSelectable | QGraphicsItem::ItemIsFocusable);
+
+	const QList<ItemSnapshot> removed = ItemSnapshot::take(items);
+	forgetItems(items);
+	SceneIndex::remove(scene_, items);
+	qDeleteAll(items);
+
+	scene_->addItem(merged);
+	SceneIndex::update(scene_, merged);
+	merged->setSelected(true);
+	history_->push(new ReplaceItemsCommand(scene_, removed, {ItemSnapshot::take(merged)}, text));
+}
+
+
+void SceneEditWidget::on_duplicateButton_clicked()
+{
+	QList<QGraphicsItem*> items;
+	for (QGraphicsItem* item : SceneSerializer::topLevelItems(scene_))
+		if (item->isSelected())
+			items.append(item);
+
+	if (items.isEmpty()) {
+		QMessageBox::information(this, tr("Duplicate"), tr("Select objects to duplicate"));
+		return;
+	}
+
+	QStringList layouts = {"Grid", "Along path"};
+	bool ok;
+	QString layout = QInputDialog::getItem(this, "Duplicate", "Layout:", layouts, 0, false, &ok);
+	if (!ok)
+		return;
+	if (layout == "Grid")
+		duplicateInGrid(items);
+	else
+		duplicateAlongPath(items);
+}
+
+void SceneEditWidget::duplicateInGrid(const QList<QGraphicsItem*>& items)
+{
+	bool ok;
+	int columns = QInputDialog::getInt(this, "Duplicate", "Columns:", 5, 1, 1000, 1, &ok);
+	if (!ok)
+		return;
+	int rows = QInputDialog::getInt(this, "Duplicate", "Rows:", 5, 1, 1000, 1, &ok);
+	if (!ok)
+		return;
+	int spacing = QInputDialog::getInt(this, "Duplicate", "Spacing (pixels):", 10, 0, 1000, 1, &ok);
+	if (!ok || columns * rows < 2)
+		return;
+
+	// Выделение - одна ячейка сетки, оригиналы остаются в первой
+	QRectF bounds;
+	for (QGraphicsItem* item : items)
+		bounds |= item->sceneBoundingRect();
+
+	QList<QTransform> placements;
+	placements.reserve(columns * rows - 1);
+	for (int row = 0; row < rows; ++row)
+		for (int column = 0; column < columns; ++column)
+			if (row != 0 || column != 0)
+				placements.append(QTransform::fromTranslate(column * (bounds.width() + spacing), row * (bounds.height() + spacing)));
+	addInstances(items, placements);
+}
+
+void SceneEditWidget::duplicateAlongPath(QList<QGraphicsItem*> items)
+{
+	// Направляющая - верхний из выделенных контуров
+	QGraphicsPathItem* guide = nullptr;
+	for (int i = items.size() - 1; i >= 0 && !guide; --i)
+		if ((guide = dynamic_cast<QGraphicsPathItem*>(items[i])))
+			items.removeAt(i);
+
+	if (!guide || items.isEmpty()) {
+		QMessageBox::information(this, tr("Duplicate"), tr("Select objects and a path or stroke to place them along"));
+		return;
+	}
+
+	QPainterPath path = guide->path();
+	// У штриха с нажимом путь - залитый контур, направляющая - его средняя линия
+	if (auto stroke = qgraphicsitem_cast<StrokeItem*>(guide); stroke && (stroke->hasVariableWidth() || path.isEmpty()))
+		path = PathSimplifier::toPolylinePath(stroke->points());
+	path = guide->sceneTransform().map(path);
+	if (path.length() <= 0) {
+		QMessageBox::information(this, tr("Duplicate"), tr("The path is empty"));
+		return;
+	}
+
+	bool ok;
+	int count = QInputDialog::getInt(this, "Duplicate", "Number of copies:", 10, 1, 10000, 1, &ok);
+	if (!ok)
+		return;
+
+	QRectF bounds;
+	for (QGraphicsItem* item : std::as_const(items))
+		bounds |= item->sceneBoundingRect();
+
+	// На замкнутом пути последняя копия не должна лечь на первую
+	const bool closed = path.elementCount() > 1 && QPointF(path.elementAt(0)) == path.currentPosition();
+	const int steps = closed ? count : qMax(1, count - 1);
+
+	QList<QTransform> placements;
+	placements.reserve(count);
+	for (int i = 0; i < count; ++i) {
+		const qreal percent = count == 1 ? 0 : qreal(i) / steps;
+		const QPointF point = path.pointAtPercent(percent);
+		// Угол пути против часовой стрелки, а ось y сцены направлена вниз
+		placements.append(QTransform::fromTranslate(-bounds.center().x(), -bounds.center().y())
+						  * QTransform().rotate(-path.angleAtPercent(percent))
+						  * QTransform::fromTranslate(point.x(), point.y()));
+	}
+	addInstances(items, placements);
+}
+
+void SceneEditWidget::addInstances(const QList<QGraphicsItem*>& items, const QList<QTransform>& placements)
+{
+	QList<QGraphicsItem*> instances;
+	instances.reserve(items.size() * placements.size());
+	for (QGraphicsItem* item : items) {
+		// Все копии одного элемента рисуют один источник; у копии копии он тот же
+		QSharedPointer<InstanceSource> source;
+		if (auto instance = qgraphicsitem_cast<InstanceItem*>(item))
+			source = instance->source();
+		else
+			source = InstanceSource::create(SceneSerializer::itemToCbor(item));
+
+		for (const QTransform& placement : placements) {
+			const QTransform transform = item->sceneTransform() * placement;
+			InstanceItem* copy = new InstanceItem(source);
+			copy->setPos(transform.dx(), transform.dy());
+			copy->setTransform(transform * QTransform::fromTranslate(-transform.dx(), -transform.dy()));
+			copy->setZValue(item->zValue());
+			copy->setOpacity(item->opacity());
+			copy->setFlags(QGraphicsItem::ItemIsMovable | QGraphicsItem::ItemIsSelectable | QGraphicsItem::ItemIsFocusable);
+			scene_->addItem(copy);
+			instances.append(copy);
+		}
+	}
 
-	selectedGroup = group;
+	SceneIndex::update(scene_, instances);
+	history_->push(new ReplaceItemsCommand(scene_, {}, ItemSnapshot::take(instances), tr("Duplicate")));
 }
 
 
 void SceneEditWidget::on_startMotionButton_clicked()
 {
-	if (selectedItem || selectedGroup) {
-		QStringList directions = {"Up", "Down", "Left", "Right"};
+	QList<QGraphicsItem*> selectedItems;
+	for (QGraphicsItem* item : scene_->selectedItems())
+		if (!item->parentItem())
+			selectedItems.append(item);
+
+	if (!selectedItems.isEmpty()) {
+		QStringList directions = {"Up", "Down", "Left", "Right", "Random"};
 		bool ok;
 		QString direction = QInputDialog::getItem(this, "Select Direction", "Select Direction:", directions, 0, false, &ok);
 
 		if (ok && !direction.isEmpty()) {
 			int duration = QInputDialog::getInt(this, "Select Time", "Select Time (milliseconds):", 5000, 1000, 60000, 1000, &ok);
 			if (ok) {
-				if (direction == "Up") {
-					dx = 0;
-					dy = -5;
-				} else if (direction == "Down") {
-					dx = 0;
-					dy = 5;
-				} else if (direction == "Left") {
-					dx = -5;
-					dy = 0;
-				} else if (direction == "Right") {
-					dx = 5;
-					dy = 0;
+				collisionSounds_->prepare();
+				// Прежняя скорость: 5 пикселей за 30 мс
+				const double speed = 5 / 0.030;
+
+				if (!movementTimer->isActive()) {
+					stopMovingItem();
+					// Холст бесконечен - тела отскакивают от краёв видимой области
+					motionThread_->setWorldBounds(paintWidget_->visibleSceneRect());
+
+					// Неподвижные картинки и прямоугольники - препятствия, как и раньше
+					for (QGraphicsItem* item : scene_->items()) {
+						if (item->parentItem() || selectedItems.contains(item))
+							continue;
+						if (item->type() == QGraphicsPixmapItem::Type || item->type() == ImageItem::Type || item->type() == QGraphicsRectItem::Type)
+							addMotionBody(item, QPointF(), -1);
+					}
+				}
+
+				for (QGraphicsItem* item : selectedItems) {
+					QPointF velocity;
+					if (direction == "Up") {
+						velocity = QPointF(0, -speed);
+					} else if (direction == "Down") {
+						velocity = QPointF(0, speed);
+					} else if (direction == "Left") {
+						velocity = QPointF(-speed, 0);
+					} else if (direction == "Right") {
+						velocity = QPointF(speed, 0);
+					} else {
+						double angle = QRandomGenerator::global()->bounded(2 * M_PI);
+						velocity = QPointF(qCos(angle), qSin(angle)) * speed;
+					}
+
+					forgetItems({item});
+					addMotionBody(item, velocity, duration / 1000.0);
 				}
 
-				movementDuration = duration;
-				movementTimer->start(30);
-				QTimer::singleShot(movementDuration, this, &SceneEditWidget::stopMovingItem);
+				if (!motionThread_->isRunning())
+					motionThread_->start();
+				movementTimer->start(16);
 			}
 		}
 	} else {
@@ -310,51 +667,224 @@ void SceneEditWidget::on_startMotionButton_clicked()
 	}
 }
 
+void SceneEditWidget::addMotionBody(QGraphicsItem* item, const QPointF& velocity, double lifetime)
+{
+	MotionBody body;
+	body.id = ++nextBodyId_;
+	body.bounds = item->sceneBoundingRect();
+	body.velocity = velocity;
+	body.lifetime = lifetime;
+	body.isStatic = velocity.isNull();
+	body.isSolid = item->type() == QGraphicsPixmapItem::Type || item->type() == ImageItem::Type
+				   || item->type() == QGraphicsRectItem::Type;
+	if (auto ellipse = qgraphicsitem_cast<QGraphicsEllipseItem*>(item))
+		body.isCircle = qFuzzyCompare(ellipse->rect().width(), ellipse->rect().height());
+
+	motionThread_->addBody(body);
+	motionTargets_.insert(body.id, {item, item->pos() - body.bounds.topLeft(), body.bounds, body.isStatic});
+}
+
+void SceneEditWidget::forgetItems(const QList<QGraphicsItem*>& items)
+{
+	for (auto it = motionTargets_.begin(); it != motionTargets_.end();) {
+		if (items.contains(it->item)) {
+			motionThread_->removeBody(it.key());
+			it = motionTargets_.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
 void SceneEditWidget::updateItemPosition()
 {
-	QGraphicsItem* item = (selectedGroup) ? static_cast<QGraphicsItem*>(selectedGroup) : selectedItem;
+	TraceSpan span("SceneEditWidget::motionTick");
+	// Препятствия могли передвинуть мышью - отправляем потоку только изменения
+	for (auto it = motionTargets_.begin(); it != motionTargets_.end(); ++it) {
+		if (!it->isObstacle)
+			continue;
+		const QRectF bounds = it->item->sceneBoundingRect();
+		if (bounds != it->bounds) {
+			it->bounds = bounds;
+			motionThread_->setBodyBounds(it.key(), bounds);
+		}
+	}
 
-	if (!item) return;
+	if (motionThread_->takeFrame(motionFrame_)) {
+		for (int i = 0; i < motionFrame_.ids.size(); ++i) {
+			// Тело могли удалить уже после того, как поток опубликовал кадр
+			auto it = motionTargets_.constFind(motionFrame_.ids[i]);
+			if (it == motionTargets_.constEnd())
+				continue;
+			const QPointF pos = motionFrame_.bounds[i].topLeft() + it->offset;
+			if (it->item->pos() != pos) {
+				it->item->setPos(pos);
+				SceneIndex::update(scene_, it->item);
+			}
+		}
+	}
 
-	QRectF itemBounds = item->sceneBoundingRect();
-	QRectF sceneBounds = scene_->sceneRect();
+	collisionSounds_->hit(motionThread_->takeCollisions());
+	// Останавливаемся, только если кадр учитывает все отправленные тела
+	if (motionFrame_.movingCount == 0 && motionFrame_.appliedCommand == motionThread_->lastCommand())
+		stopMovingItem();
+}
 
-	bool collided = false;
+void SceneEditWidget::on_timelineButton_clicked()
+{
+	QStringList actions = {"Add keyframe for selection", "Play", "Stop", "Clear keyframes", "Export PNG sequence"};
+	bool ok;
+	QString action = QInputDialog::getItem(this, "Timeline", "Action:", actions, 0, false, &ok);
+	if (!ok)
+		return;
 
-		   // Проверка на столкновение с границами сцены
-	if (itemBounds.right() >= sceneBounds.right() || itemBounds.left() <= sceneBounds.left()) {
-		dx = -dx;
-		collided = true;
+	if (action == actions[0]) {
+		addKeyframe();
+	} else if (action == actions[1]) {
+		if (timeline_.isEmpty()) {
+			QMessageBox::information(this, tr("Timeline"), tr("Add keyframes first"));
+			return;
+		}
+		stopMovingItem();
+		playbackClock_.start();
+		playbackTimer_->start(16);
+	} else if (action == actions[2]) {
+		playbackTimer_->stop();
+	} else if (action == actions[3]) {
+		playbackTimer_->stop();
+		timeline_.clear();
+	} else {
+		exportFrames();
 	}
-	if (itemBounds.bottom() >= sceneBounds.bottom() || itemBounds.top() <= sceneBounds.top()) {
-		dy = -dy;
-		collided = true;
+}
+
+void SceneEditWidget::addKeyframe()
+{
+	QList<QGraphicsItem*> selectedItems;
+	for (QGraphicsItem* item : scene_->selectedItems())
+		if (!item->parentItem())
+			selectedItems.append(item);
+	if (selectedItems.isEmpty()) {
+		QMessageBox::warning(this, "Error", "Select something!");
+		return;
 	}
 
-	QList<QGraphicsItem *> collidingItems = item->collidingItems();
-	foreach (QGraphicsItem* collidingItem, collidingItems) {
-		if (selectedGroup && selectedGroup->isAncestorOf(collidingItem)) {
-			continue;
-		}
+	bool ok;
+	double time = QInputDialog::getDouble(this, "Keyframe", "Time (seconds):", timeline_.isEmpty() ? 0 : timeline_.duration() + 1,
+										  0, 3600, 2, &ok);
+	if (!ok)
+		return;
 
-		if (dynamic_cast<QGraphicsPixmapItem*>(collidingItem) ||
-			collidingItem->type() == QGraphicsRectItem::Type) {
-			dx = -dx;
-			dy = -dy;
-			collided = true;
-			break;
-		}
+	QStringList easings = {"Linear", "InOutQuad", "InOutCubic", "InOutSine", "OutBounce", "OutElastic", "OutBack"};
+	QString easing = QInputDialog::getItem(this, "Keyframe", "Easing to this keyframe:", easings, 0, false, &ok);
+	if (!ok)
+		return;
+
+	Keyframe keyframe;
+	keyframe.time = time;
+	keyframe.easing = QEasingCurve::Type(QMetaEnum::fromType<QEasingCurve::Type>().keyToValue(easing.toLatin1().constData()));
+	for (QGraphicsItem* item : selectedItems) {
+		keyframe.state = KeyframeState::of(item);
+		timeline_.setKeyframe(SceneCommand::ensureId(item), keyframe);
 	}
+}
 
-	if (collided) {
-		collisionSound.play();
+void SceneEditWidget::updatePlayback()
+{
+	const qreal duration = timeline_.duration();
+	const qreal time = playbackClock_.nsecsElapsed() / 1e9;
+	timeline_.apply(scene_, qMin(time, duration));
+	if (time >= duration)
+		playbackTimer_->stop();
+}
+
+void SceneEditWidget::exportFrames()
+{
+	if (timeline_.isEmpty()) {
+		QMessageBox::information(this, tr("Timeline"), tr("Add keyframes first"));
+		return;
+	}
+
+	QString directory = QFileDialog::getExistingDirectory(this, tr("Export frames to"));
+	if (directory.isEmpty())
+		return;
+	bool ok;
+	int fps = QInputDialog::getInt(this, "Export frames", "Frames per second:", 30, 1, 120, 1, &ok);
+	if (!ok)
+		return;
+
+	playbackTimer_->stop();
+	QProgressDialog progressDialog(tr("Rendering frames..."), tr("Cancel"), 0, 100, this);
+	progressDialog.setWindowModality(Qt::WindowModal);
+	progressDialog.setMinimumDuration(500);
+
+	QString errorString;
+	bool exported = SceneExporter::exportFrames(scene_, timeline_, directory, fps, &errorString, [&progressDialog](int done, int total) {
+		progressDialog.setMaximum(total);
+		progressDialog.setValue(done);
+		return !progressDialog.wasCanceled();
+	});
+	if (!exported && !errorString.isEmpty())
+		QMessageBox::critical(this, tr("Export Error"), tr("Could not export the frames: %1").arg(errorString));
+}
+
+void SceneEditWidget::importSvg(const QString& fileName)
+{
+	QFile file(fileName);
+	QString errorString;
+	QList<QGraphicsItem*> items;
+	if (file.open(QIODevice::ReadOnly))
+		items = SceneSvg::load(&file, &errorString);
+	else
+		errorString = file.errorString();
+
+	if (items.isEmpty()) {
+		QMessageBox::warning(this, tr("Error"), errorString.isEmpty() ? tr("The SVG file has no shapes") : errorString);
+		return;
 	}
-	item->moveBy(dx, dy);
+
+	for (QGraphicsItem* item : std::as_const(items))
+		scene_->addItem(item);
+	SceneIndex::update(scene_, items);
+	history_->push(new ReplaceItemsCommand(scene_, {}, ItemSnapshot::take(items), tr("Import SVG")));
+}
+
+void SceneEditWidget::recordAdded(QGraphicsItem* item, const QString& text)
+{
+	SceneIndex::update(scene_, item);
+	history_->push(new ReplaceItemsCommand(scene_, {}, {ItemSnapshot::take(item)}, text));
+}
+
+void SceneEditWidget::recordRasterStroke(RasterLayerItem* layer, const QHash<QPoint, QImage>& before)
+{
+	if (before.isEmpty())
+		return;
+
+	QHash<QPoint, QImage> after;
+	for (auto it = before.constBegin(); it != before.constEnd(); ++it)
+		after.insert(it.key(), layer->tileImage(it.key()));
+	history_->push(new RasterTilesCommand(scene_, SceneCommand::ensureId(layer), before, after));
+}
+
+void SceneEditWidget::undo()
+{
+	// Элементы пересоздаются - движение по старым указателям продолжать нельзя
+	stopMovingItem();
+	history_->undo();
+}
+
+void SceneEditWidget::redo()
+{
+	stopMovingItem();
+	history_->redo();
 }
 
 void SceneEditWidget::stopMovingItem()
 {
 	movementTimer->stop();
+	motionThread_->reset();
+	motionFrame_ = MotionThread::Frame();
+	motionTargets_.clear();
 }
 
 void SceneEditWidget::on_selectButton_clicked()
@@ -363,6 +893,21 @@ void SceneEditWidget::on_selectButton_clicked()
 	ui->eraserButton->setChecked(false);
 	ui->brushButton->setChecked(false);
 	ui->selectButton->setChecked(true);
+	ui->fillButton->setChecked(false);
+}
+
+void SceneEditWidget::on_fillButton_clicked()
+{
+	paintWidget_->setCurrentTool(ToolType::FillTool);
+	ui->fillButton->setChecked(true);
+	ui->brushButton->setChecked(false);
+	ui->eraserButton->setChecked(false);
+	ui->selectButton->setChecked(false);
+
+	bool ok;
+	int tolerance = QInputDialog::getInt(this, "Fill tolerance", "Color tolerance (0-255):", paintWidget_->fillTolerance(), 0, 255, 1, &ok);
+	if (ok)
+		paintWidget_->setFillTolerance(tolerance);
 }
 
 
@@ -370,7 +915,15 @@ void SceneEditWidget::on_changeBackground_clicked()
 {
 	QColor color = QColorDialog::getColor(QColorConstants::Svg::white, this, "Background color");
 	if (color.isValid()) {
+		QBrush oldBrush = scene_->backgroundBrush();
 		scene_->setBackgroundBrush(color);
+		history_->push(new BackgroundCommand(scene_, oldBrush, QBrush(color)));
 	}
 }
 
+
+void SceneEditWidget::on_smoothStrokesCheckBox_toggled(bool checked) { paintWidget_->setStrokeSmoothing(checked); }
+
+void SceneEditWidget::on_rasterBrushCheckBox_toggled(bool checked) { paintWidget_->setRasterMode(checked); }
+
+void SceneEditWidget::on_performanceModeCheckBox_toggled(bool checked) { paintWidget_->setPerformanceMode(checked); }
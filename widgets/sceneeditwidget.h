@@ -3,9 +3,15 @@
 
 #include "ieditablewidget.h"
 #include "paintwidget.h"
+#include "../helpers/motionthread.h"
+#include <QHash>
 #include <QWidget>
 #include <qgraphicsscene.h>
-#include <QSoundEffect>
+#include "../helpers/collisionsoundpool.h"
+#include "../helpers/scenehistory.h"
+#include "../helpers/keyframetimeline.h"
+#include "../helpers/shapeboolean.h"
+#include <QElapsedTimer>
 
 namespace Ui
 {
@@ -35,6 +41,9 @@ class SceneEditWidget : public QWidget, public IEditableWidget
 	}
 	WorkType getWorkType() override {return WorkType::InteractiveScene; }
 
+	void undo();
+	void redo();
+
   signals:
 	void sceneModified(SceneEditWidget* widget);
 
@@ -65,34 +74,75 @@ class SceneEditWidget : public QWidget, public IEditableWidget
 
 	void on_mergeShapesButton_clicked();
 
+	void on_duplicateButton_clicked();
+
 	void on_startMotionButton_clicked();
 
 	void on_selectButton_clicked();
 
+	void on_fillButton_clicked();
+
 	void on_changeBackground_clicked();
 
+	void on_smoothStrokesCheckBox_toggled(bool checked);
+
+	void on_rasterBrushCheckBox_toggled(bool checked);
+
+	void on_performanceModeCheckBox_toggled(bool checked);
+
+	void on_timelineButton_clicked();
+
   private:
+	// benchmarks/corebenchmark.cpp гоняет шаг движения напрямую, без таймера и диалогов
+	friend struct BenchmarkAccess;
+
 	Ui::SceneEditWidget *ui;
 
-	QString originalText_;
 	QFileInfo* fileinfo_ = nullptr;
 	bool isModified_ = false;
 
 	QGraphicsScene* scene_;
 	PaintWidget* paintWidget_;
+	SceneHistory* history_;
+	int sliderGesture_ = 0; // растёт при каждом нажатии на ползунок масштаба или поворота
 
-	// Для движения
-	QGraphicsItem* selectedItem;
-	QGraphicsItemGroup* selectedGroup;
+	// Для движения: шаги считает motionThread_, таймер раз в кадр переносит положения на элементы
+	struct MotionTarget
+	{
+		QGraphicsItem* item;
+		QPointF offset;
+		QRectF bounds;
+		bool isObstacle;
+	};
+	MotionThread* motionThread_;
+	MotionThread::Frame motionFrame_;
+	QHash<quint32, MotionTarget> motionTargets_;
+	quint32 nextBodyId_ = 0;
 	QTimer* movementTimer;
-	int dx, dy;
-	int movementDuration;
 
-	// Звуковой эффект для столкновений
-	QSoundEffect collisionSound;
+	// Анимация по ключевым кадрам: время берётся из монотонных часов, а не из числа тиков
+	KeyframeTimeline timeline_;
+	QElapsedTimer playbackClock_;
+	QTimer* playbackTimer_;
+
+	// Звуки столкновений
+	CollisionSoundPool* collisionSounds_;
 
 	void stopMovingItem();
 	void updateItemPosition();
+	void addMotionBody(QGraphicsItem* item, const QPointF& velocity, double lifetime);
+	void forgetItems(const QList<QGraphicsItem*>& items);
+	void addKeyframe();
+	void updatePlayback();
+	void exportFrames();
+	void importSvg(const QString& fileName);
+	void groupShapes(const QList<QGraphicsItem*>& selectedItems);
+	void combineShapes(ShapeBoolean::Operation operation, const QString& text);
+	void duplicateInGrid(const QList<QGraphicsItem*>& items);
+	void duplicateAlongPath(QList<QGraphicsItem*> items);
+	void addInstances(const QList<QGraphicsItem*>& items, const QList<QTransform>& placements);
+	void recordAdded(QGraphicsItem* item, const QString& text);
+	void recordRasterStroke(RasterLayerItem* layer, const QHash<QPoint, QImage>& before);
 };
 
 #endif // SCENEEDITWIDGET_H
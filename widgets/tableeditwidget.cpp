@@ -1,10 +1,33 @@
 #include "tableeditwidget.h"
 #include "ui_tableeditwidget.h"
+#include "../helpers/csvtable.h"
+#include "../helpers/trace.h"
 #include <qmenu.h>
 #include <qtimer.h>
 
+#include <algorithm>
+#include <QItemSelection>
+#include <QUndoCommand>
+
+// Замена в нескольких ячейках - одна запись в истории
+class ReplaceCellsCommand : public QUndoCommand
+{
+  public:
+	ReplaceCellsCommand(TableEditWidget* widget, const QList<TableSearchHit>& hits)
+		: QUndoCommand(QObject::tr("Replace %n cell(s)", nullptr, hits.size())), widget_(widget), hits_(hits)
+	{
+	}
+
+	void undo() override { widget_->setCellTexts(hits_, false); }
+	void redo() override { widget_->setCellTexts(hits_, true); }
+
+  private:
+	TableEditWidget* widget_;
+	QList<TableSearchHit> hits_;
+};
+
 TableEditWidget::TableEditWidget(QWidget *parent)
-	: QWidget(parent), ui(new Ui::TableEditWidget)
+	: QWidget(parent), ui(new Ui::TableEditWidget), undoStack_(new QUndoStack(this))
 {
 	ui->setupUi(this);
 	ui->tableWidget->setColumnCount(2);
@@ -41,6 +64,7 @@ void TableEditWidget::showContextMenu(const QPoint &pos)
 
 void TableEditWidget::openFile(const QString& filePath)
 {
+	TraceSpan span("TableEditWidget::openFile");
 	fileinfo_ = new QFileInfo(filePath);
 	QFile file(filePath);
 
@@ -61,28 +85,29 @@ void TableEditWidget::openFile(const QString& filePath)
 	file.close();
 
 	setTable(originalText_);
+	// Исходник мог быть записан с лишними кавычками - сравниваем с тем, что таблица сохранит сама
+	originalText_ = getQStringFromTable();
+	isModified_ = false;
+	emit tableModified(this);
 }
 
 void TableEditWidget::setTable(QString& input)
 {
-	QStringList rows = input.split('\n');
-	rows.removeLast();
+	TraceSpan span("TableEditWidget::setTable");
+	const QList<QStringList> rows = CsvTable::parse(input);
 	int numRows = rows.size();
-	int numCols = 0;
+	int numCols = CsvTable::columnCount(rows);
 
-	for (const QString& row : rows) {
-		int cols = row.split(',').size();
-		if (cols > numCols) {
-			numCols = cols;
-		}
-	}
+	undoStack_->clear();
+	searchHits_.clear();
+	currentHit_ = -1;
 
 	ui->tableWidget->setRowCount(numRows);
 	ui->tableWidget->setColumnCount(numCols);
 
 	for (int row = 0; row < numRows; ++row)
 	{
-		QStringList columns = rows[row].split(',');
+		const QStringList& columns = rows[row];
 		for (int col = 0; col < columns.size(); ++col)
 			ui->tableWidget->setItem(row, col, new QTableWidgetItem(columns[col]));
 	}
@@ -90,7 +115,7 @@ void TableEditWidget::setTable(QString& input)
 
 QString TableEditWidget::getQStringFromTable() const
 {
-	QString result;
+	QList<QStringList> rows;
 	int rowCount = ui->tableWidget->rowCount();
 	int colCount = ui->tableWidget->columnCount();
 
@@ -104,13 +129,14 @@ QString TableEditWidget::getQStringFromTable() const
 				rowContents << "";
 			}
 		}
-		result += rowContents.join(',') + '\n';
+		rows.append(rowContents);
 	}
-	return result;
+	return CsvTable::write(rows);
 }
 
 bool TableEditWidget::saveFile(const QString& filePath)
 {
+	TraceSpan span("TableEditWidget::saveFile");
 	if (filePath.isEmpty())
 	{
 		QMessageBox::information(this, tr("No File Selected"), tr("No file was selected."));
@@ -140,6 +166,14 @@ void TableEditWidget::resetChanges()
 }
 
 void TableEditWidget::on_tableWidget_cellChanged(int row, int column)
+{
+	TraceSpan span("TableEditWidget::cellChanged");
+	// Ручная правка в историю не попадает: отмена замены поверх неё затёрла бы её старым текстом
+	undoStack_->clear();
+	updateModifiedState();
+}
+
+void TableEditWidget::updateModifiedState()
 {
 	if (getQStringFromTable() == originalText_)
 	{
@@ -152,8 +186,100 @@ void TableEditWidget::on_tableWidget_cellChanged(int row, int column)
 	emit tableModified(this);
 }
 
-void TableEditWidget::on_actionAdd_Column_triggered() { ui->tableWidget->insertColumn(ui->tableWidget->currentColumn() + 1); }
-void TableEditWidget::on_actionAdd_Row_triggered() { ui->tableWidget->insertRow(ui->tableWidget->currentRow() + 1);}
-void TableEditWidget::on_actionRemove_Column_triggered() { ui->tableWidget->removeColumn(ui->tableWidget->currentColumn());}
-void TableEditWidget::on_actionRemove_Row_triggered() { ui->tableWidget->removeRow(ui->tableWidget->currentRow());}
+int TableEditWidget::find(const TableSearchOptions& options)
+{
+	searchHits_ = TableSearch::findAll(ui->tableWidget, options);
+	currentHit_ = -1;
+	highlightHits();
+	if (!searchHits_.isEmpty())
+		goToHit(0);
+	return searchHits_.size();
+}
+
+bool TableEditWidget::findNext()
+{
+	if (searchHits_.isEmpty())
+		return false;
+	goToHit((currentHit_ + 1) % searchHits_.size());
+	return true;
+}
+
+bool TableEditWidget::findPrevious()
+{
+	if (searchHits_.isEmpty())
+		return false;
+	goToHit((currentHit_ - 1 + searchHits_.size()) % searchHits_.size());
+	return true;
+}
+
+int TableEditWidget::replaceAll(const TableSearchOptions& options, const QString& replacement)
+{
+	QList<TableSearchHit> hits = TableSearch::replaceAll(ui->tableWidget, options, replacement);
+	if (hits.isEmpty())
+		return 0;
+
+	undoStack_->push(new ReplaceCellsCommand(this, hits));
+	searchHits_ = hits;
+	currentHit_ = -1;
+	highlightHits();
+	goToHit(0);
+	return hits.size();
+}
+
+QList<int> TableEditWidget::selectedColumns() const
+{
+	QList<int> columns;
+	const QList<QTableWidgetSelectionRange> ranges = ui->tableWidget->selectedRanges();
+	for (const QTableWidgetSelectionRange& range : ranges)
+		for (int col = range.leftColumn(); col <= range.rightColumn(); ++col)
+			if (!columns.contains(col))
+				columns.append(col);
+	std::sort(columns.begin(), columns.end());
+	return columns;
+}
+
+void TableEditWidget::highlightHits()
+{
+	QItemSelection selection;
+	QAbstractItemModel* model = ui->tableWidget->model();
+	for (const TableSearchHit& hit : searchHits_)
+	{
+		QModelIndex index = model->index(hit.row, hit.column);
+		selection.select(index, index);
+	}
+	ui->tableWidget->selectionModel()->select(selection, QItemSelectionModel::ClearAndSelect);
+}
+
+void TableEditWidget::goToHit(int index)
+{
+	if (index < 0 || index >= searchHits_.size())
+		return;
+
+	currentHit_ = index;
+	const TableSearchHit& hit = searchHits_[index];
+	ui->tableWidget->setCurrentCell(hit.row, hit.column, QItemSelectionModel::NoUpdate);
+	ui->tableWidget->scrollTo(ui->tableWidget->model()->index(hit.row, hit.column));
+}
+
+void TableEditWidget::setCellTexts(const QList<TableSearchHit>& hits, bool applyNew)
+{
+	// cellChanged на каждую ячейку не нужен: состояние пересчитываем один раз
+	ui->tableWidget->blockSignals(true);
+	for (const TableSearchHit& hit : hits)
+	{
+		const QString& text = applyNew ? hit.newText : hit.oldText;
+		if (QTableWidgetItem* item = ui->tableWidget->item(hit.row, hit.column))
+			item->setText(text);
+		else
+			ui->tableWidget->setItem(hit.row, hit.column, new QTableWidgetItem(text));
+	}
+	ui->tableWidget->blockSignals(false);
+	updateModifiedState();
+}
+
+// Записи истории хранят координаты ячеек, после изменения структуры они недействительны
+void TableEditWidget::on_actionAdd_Column_triggered() { undoStack_->clear(); ui->tableWidget->insertColumn(ui->tableWidget->currentColumn() + 1); }
+void TableEditWidget::on_actionAdd_Row_triggered() { undoStack_->clear(); ui->tableWidget->insertRow(ui->tableWidget->currentRow() + 1);}
+void TableEditWidget::on_actionRemove_Column_triggered() { undoStack_->clear(); ui->tableWidget->removeColumn(ui->tableWidget->currentColumn());}
+void TableEditWidget::on_actionRemove_Row_triggered() { undoStack_->clear(); ui->tableWidget->removeRow(ui->tableWidget->currentRow());}
 
@@ -2,6 +2,9 @@
 #define TABLEEDITWIDGET_H
 
 #include "ieditablewidget.h"
+#include "../helpers/tablesearch.h"
+
+#include <QUndoStack>
 
 namespace Ui
 {
@@ -33,6 +36,15 @@ class TableEditWidget : public QWidget, public IEditableWidget
 
 	void showContextMenu(const QPoint &pos);
 
+	int find(const TableSearchOptions& options);
+	bool findNext();
+	bool findPrevious();
+	int replaceAll(const TableSearchOptions& options, const QString& replacement);
+	QList<int> selectedColumns() const;
+
+	void undo() { undoStack_->undo(); }
+	void redo() { undoStack_->redo(); }
+
   signals:
 	void tableModified(TableEditWidget* widget);
 
@@ -48,13 +60,23 @@ class TableEditWidget : public QWidget, public IEditableWidget
 	void on_actionRemove_Column_triggered();
 
   private:
+	friend class ReplaceCellsCommand;
+
 	Ui::TableEditWidget *ui;
 	QString originalText_;
 	QFileInfo* fileinfo_ = nullptr;
 	bool isModified_ = false;
 
+	QUndoStack* undoStack_;
+	QList<TableSearchHit> searchHits_;
+	int currentHit_ = -1;
+
 	QString getQStringFromTable() const;
 	void setTable(QString& input);
+	void updateModifiedState();
+	void highlightHits();
+	void goToHit(int index);
+	void setCellTexts(const QList<TableSearchHit>& hits, bool applyNew);
 };
 
 #endif // TABLEEDITWIDGET_H
@@ -0,0 +1,12 @@
+#include "tabplaceholder.h"
+
+#include <QFileInfo>
+
+TabPlaceholder::TabPlaceholder(const QString& filePath, QWidget* parent)
+	: QWidget(parent), filePath_(filePath)
+{
+}
+
+QString TabPlaceholder::fileName() const { return QFileInfo(filePath_).fileName(); }
+
+WorkType TabPlaceholder::workType() const { return getWorktypeByExtension(QFileInfo(filePath_).suffix().toLower()); }
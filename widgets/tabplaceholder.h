@@ -0,0 +1,26 @@
+#ifndef TABPLACEHOLDER_H
+#define TABPLACEHOLDER_H
+
+#include "../enums/worktype.h"
+
+#include <QWidget>
+
+// Вкладка, у которой ещё нет редактора: хранится только путь к файлу.
+// Редактор со своей формой строится и загружает файл при первом открытии вкладки
+// (MainWindow::materializeTab); долго не открывавшаяся вкладка снова становится заглушкой.
+class TabPlaceholder : public QWidget
+{
+	Q_OBJECT
+
+  public:
+	explicit TabPlaceholder(const QString& filePath, QWidget* parent = nullptr);
+
+	const QString& filePath() const { return filePath_; }
+	QString fileName() const;
+	WorkType workType() const;
+
+  private:
+	QString filePath_;
+};
+
+#endif // TABPLACEHOLDER_H
@@ -1,5 +1,6 @@
 #include "texteditwidget.h"
 #include "ui_texteditwidget.h"
+#include "../helpers/trace.h"
 
 #include <QColorDialog>
 #include <QFontDialog>
@@ -27,6 +28,7 @@ void TextEditWidget::on_textEdit_textChanged()
 
 void TextEditWidget::openFile(const QString& filePath)
 {
+	TraceSpan span("TextEditWidget::openFile");
 	fileinfo_ = new QFileInfo(filePath);
 	QFile file(filePath);
 
@@ -49,6 +51,7 @@ void TextEditWidget::openFile(const QString& filePath)
 
 bool TextEditWidget::saveFile(const QString& filePath)
 {
+	TraceSpan span("TextEditWidget::saveFile");
 	if (filePath.isEmpty())
 	{
 		QMessageBox::information(this, tr("No File Selected"), tr("No file was selected."));